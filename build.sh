@@ -1 +1,5 @@
-gcc -Wall -Wextra -Werror -Iinclude -o license src/licenses.c src/cwalk.c
+gcc -Wall -Wextra -Werror -Iinclude -o gen_builtin src/gen_builtin.c
+./gen_builtin licenses/builtin.config include/licenses_builtin.h
+gcc -Wall -Wextra -Werror -Iinclude -DLICENSES_BUILTIN -o license src/licenses.c src/cwalk.c -pthread
+gcc -Wall -Wextra -Werror -O2 -Iinclude -o bench_conp src/bench_conp.c
+gcc -Wall -Wextra -Werror -O2 -Iinclude -o bench_cwalk src/bench_cwalk.c src/cwalk.c
@@ -23,6 +23,15 @@
     SOFTWARE.
 */
 
+/*
+    The parser itself only needs the C standard library. The parts that need
+    the operating system are opt-in, define these before including conp.h:
+    CONP_WITH_THREADS: conp_parse_all_parallel, conp_parse_sources and the
+                       snapshots of ConpShared (POSIX threads)
+    CONP_WITH_CACHE:   the compiled ConpCache (POSIX mmap)
+    CONP_WITH_WATCH:   ConpWatch (Linux inotify)
+*/
+
 #ifndef _CONP_H
 #define _CONP_H
 
@@ -32,19 +41,64 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <ctype.h>
-#include <sys/stat.h>
 #include <assert.h>
+#include <stdarg.h>
+#include <math.h>
+#include <errno.h>
+
+#if defined(CONP_WITH_THREADS) || defined(CONP_WITH_CACHE) || defined(CONP_WITH_WATCH)
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef CONP_WITH_THREADS
+#include <pthread.h>
+#endif
+#ifdef CONP_WITH_CACHE
+#include <sys/mman.h>
+#endif
+#if defined(CONP_WITH_WATCH) && defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define conp_is_whitespace(c) ((c == ' ' || c == '\t' || c == '\n'))
-#define conp_check_line(lexer, c) do{if (c == '\n'){(lexer)->loc.row++; (lexer)->loc.column=1;}else{lexer->loc.column++;}}while(0)
-#define conp_inc(lexer) do{lexer->index++; lexer->loc.column++;}while(0)
+#define conp_inc(lexer) do{lexer->index++;}while(0)
 #define conp_get_char(lexer) (lexer->buffer[lexer->index])
 #define conp_get_pointer(lexer) (lexer->buffer + lexer->index)
 #define conp_loc_expand(loc) (loc).filename, (loc).row, (loc).column
+#define conp__fold(c) (((c) >= 'A' && (c) <= 'Z')? ((c) | 0x20):(c))
+#define conp_span_ptr(entries, entry, span) ((entries)->sources[(entry)->source].buffer + (span).offset)
 #define conp_token_args_len(...) sizeof(ConpTokenType[]){__VA_ARGS__}/sizeof(ConpTokenType)
 #define conp_token_args_array(...) (ConpTokenType[]){__VA_ARGS__}, conp_token_args_len(__VA_ARGS__)
 
 #define CONP_LOC_FMT "%s:%zu:%zu:"
+#define CONP_ARENA_BLOCK_SIZE (64*1024)
+#define CONP_ARENA_BLOCK_MAX (16*1024*1024)
+#ifndef CONP_MAX_SOURCES
+#define CONP_MAX_SOURCES UINT16_MAX // the source of an entry is 16 bits
+#endif
+#ifndef CONP_MAX_SECTIONS
+#define CONP_MAX_SECTIONS UINT16_MAX // the section of an entry is 16 bits
+#endif
+#ifdef CONP_WITH_THREADS
+#ifndef CONP_PARALLEL_MIN_CHUNK
+#define CONP_PARALLEL_MIN_CHUNK (1024*1024) // smaller chunks are not worth a thread
+#endif
+#ifndef CONP_SHARED_READERS
+#define CONP_SHARED_READERS 64 // threads that can read a ConpShared at the same time
+#endif
+#endif
+#ifdef CONP_WITH_CACHE
+#define CONP_CACHE_MAGIC "CONPCACH"
+#define CONP_CACHE_VERSION 3
+#endif
 #define conp_arr_len(arr) ((arr)!= NULL ? sizeof((arr))/sizeof((arr)[0]):0)
 
 #define CONP_VALUES ConpToken_Field, ConpToken_Int, ConpToken_Float, ConpToken_String, ConpToken_True, ConpToken_False
@@ -62,17 +116,20 @@ typedef enum{
     ConpToken_Float,
     ConpToken_True,
     ConpToken_False,
+    ConpToken_Section,
     ConpToken__Count
 } ConpTokenType;
 
 const char* const ConpTokenTypeNames[] = {
     [ConpToken_Field] = "Field",
     [ConpToken_Sep] = "Sep",
+    [ConpToken_End] = "End",
     [ConpToken_String] = "String",
     [ConpToken_Int] = "Int",
     [ConpToken_Float] = "Float",
     [ConpToken_True] = "Bool",
     [ConpToken_False] = "Bool",
+    [ConpToken_Section] = "Section",
 };
 
 _Static_assert(ConpToken__Count == conp_arr_len(ConpTokenTypeNames), "ConpTokenType count has changed!");
@@ -83,325 +140,2905 @@ typedef struct{
     size_t column;
 } ConpLoc;
 
+typedef struct{
+    size_t offset; // offset of the error into the buffer
+    ConpLoc loc;
+    char *message;
+} ConpDiagnostic;
+
+typedef struct{
+    ConpDiagnostic *items;
+    size_t count;
+    size_t capacity;
+} ConpDiagnostics;
+
 typedef struct{
     ConpTokenType type;
     char *start;
     char *end;
     size_t len;
-    ConpLoc loc;
+    bool escaped; // the string contains backslash escapes
 } ConpToken;
 
+// a string that is either borrowed from the input or written to a caller-provided buffer
+typedef struct{
+    const char *data;
+    size_t len;
+} ConpView;
+
+// a compact reference to a token inside the buffer of a source
+typedef struct{
+    uint32_t offset;
+    uint32_t len;
+} ConpSpan;
+
 typedef struct{
-    ConpToken key;
-    ConpToken value;
+    ConpSpan key;
+    ConpSpan value;
+    uint64_t number; // the parsed value of an Int (int64_t) or a Float (bits of the double), valid once number_state is set
+    uint8_t type; // the ConpTokenType of the value
+    bool escaped; // the value contains backslash escapes
+    uint8_t number_state; // one of CONP__NUMBER_*, the number is parsed by the first accessor that needs it
+    uint16_t source; // index into the sources of the entries
+    uint16_t section; // index into the sections of the entries, 0 is the root section
 } ConpEntry;
 
+enum{
+    CONP__NUMBER_UNPARSED,
+    CONP__NUMBER_OK,
+    CONP__NUMBER_RANGE, // the number is clamped to the largest value of its type
+};
+
+// an arbitrary precision decimal for the numbers the fast path of conp__parse_double cannot convert exactly
+#define CONP__DECIMAL_DIGITS 800
+typedef struct{
+    uint8_t digits[CONP__DECIMAL_DIGITS]; // digit values, most significant first, without trailing zeros
+    int count;
+    int point; // position of the decimal point relative to the first digit
+    bool truncated; // nonzero digits were dropped behind the last one
+} ConpDecimal;
+
+typedef struct{
+    char *buffer;
+    size_t buffer_size;
+    char *name;
+    uint32_t *lines; // offsets of the line starts, only built once a location is requested
+    size_t line_count;
+    bool failed; // parsing the source stopped at an error
+} ConpSource;
+
 typedef struct{
     char *buffer;
     size_t buffer_size;
     size_t index;
-    ConpLoc loc;
+    ConpLoc origin; // location of the first character of the buffer
+    bool partial; // more input may follow the buffer, running into its end pauses the lexer
+    bool paused; // the last token ran into the end of a partial buffer, conp_next resumes it
+    ConpTokenType pending; // type of the paused token, ConpToken_End if there was none
+    size_t pending_start;
+    bool escaped; // the string that is being lexed contains backslash escapes
+    uint8_t literal; // state of the literal classification when a literal was paused
+    bool quiet; // do not report errors, used while parsing speculatively
+    ConpDiagnostics *diagnostics; // if set, errors are collected here instead of printed
+    size_t error_count; // number of errors that were found, even if they were not reported
 } ConpLexer;
 
+typedef struct ConpArenaBlock{
+    struct ConpArenaBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+} ConpArenaBlock;
+
+// bump allocator, everything allocated from it is released at once by conp_arena_free
+typedef struct{
+    ConpArenaBlock *head;
+    size_t block_size; // minimum size of a block, CONP_ARENA_BLOCK_SIZE if 0
+    size_t block_count;
+} ConpArena;
+
+// a slot of the case-insensitive name index of a section
+typedef struct{
+    uint32_t name; // index (+1) of the entry whose key is the name, 0 marks an empty slot
+    uint32_t entry; // index (+1) of the entry the name resolves to, differs from name for aliases and is 0 for an alias of no key
+} ConpName;
+
+// the entries behind a [name] header, those in front of the first header belong to the root section
+typedef struct{
+    char *name; // null-terminated copy owned by the entries, NULL for the root section
+    size_t name_len;
+    size_t count; // number of entries in the section
+    uint32_t *index; // open-addressing table of item indices (+1), 0 marks an empty slot
+    size_t index_capacity;
+    ConpName *names; // case-insensitive index of the keys and aliases, only built by conp_section_names
+    size_t names_capacity;
+    size_t aliases; // id (+1) of the section whose entries were indexed as aliases, 0 if there are none
+} ConpSection;
+
 typedef struct{
     ConpEntry *items;
     size_t count;
     size_t capacity;
+    ConpSection *sections; // sections with the same name are merged, every section is indexed on its own
+    size_t section_count;
+    ConpSource *sources;
+    size_t source_count;
+    ConpArena *arena; // if set, the entries are allocated from the arena, except for the indexes and line tables, which are rebuilt by updates and stay on the heap
 } ConpEntries;
 
+#ifdef CONP_WITH_CACHE
+/*
+    Compiled cache of parsed entries: the header is followed by the hash table
+    (table_size slots of entry indices + 1, 0 marks an empty slot), the entries,
+    the names of the sections and the string pool that holds the raw text of
+    all keys, values and section names. All sections share the table, the
+    section is mixed into the hash of a key. Keys are hashed case-insensitively,
+    so keys that only differ in case are found on the same probe sequence.
+*/
+typedef struct{
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t source_hash;
+    uint32_t table_size;
+    uint32_t pool_size;
+    uint32_t section_count;
+} ConpCacheHeader;
+
+typedef struct{
+    ConpSpan key; // offsets into the string pool
+    ConpSpan value;
+    uint8_t type;
+    bool escaped;
+    uint16_t section;
+} ConpCacheEntry;
+
+typedef struct{
+    char *data; // the mapped cache file
+    size_t size;
+    ConpCacheHeader *header;
+    uint32_t *table;
+    ConpCacheEntry *entries;
+    ConpSpan *sections; // the name of the root section is empty
+    char *pool;
+} ConpCache;
+#endif
+
+// a part of a buffer that is parsed on its own by conp_parse_all_parallel
+typedef struct{
+    char *buffer;
+    size_t buffer_size;
+    char *buffer_name;
+    size_t start; // the chunk covers the entries that start in [start, end)
+    size_t end;
+    size_t first; // start of the first entry, the parse is only valid if the previous chunk stopped right there
+    size_t stop; // start of the first entry behind the chunk
+    bool ended; // the input ended or was invalid inside the chunk
+    bool failed; // the chunk contains an error
+    ConpEntry *items;
+    size_t count;
+    size_t capacity;
+} ConpChunk;
+
+#ifdef CONP_WITH_THREADS
+// the sources of conp_parse_sources, every worker takes the next chunk that has not been parsed yet
+typedef struct{
+    ConpChunk *chunks;
+    size_t count;
+    size_t next;
+} ConpChunkQueue;
+#endif
+
+typedef struct{
+    ConpLexer lexer; // lexes the input that has not been consumed yet, the buffer is owned by the stream
+    size_t capacity;
+    size_t entry; // start of the entry that is currently being parsed
+    size_t state; // number of tokens of the current entry that have been lexed
+    ConpSpan key;
+    bool failed;
+} ConpStream;
+
+#if defined(CONP_WITH_WATCH) && defined(__linux__)
+// a file that is parsed as a source of some entries and re-parsed incrementally whenever it is written
+typedef struct{
+    int fd; // inotify instance, can be polled by an event loop
+    int wd;
+    char *path;
+    char *name; // the file name part of the path, events are reported for the directory
+    ConpEntries *entries;
+    size_t source;
+    char *buffer; // the content of the file, owned by the watch
+    size_t buffer_size;
+} ConpWatch;
+#endif
+
+#ifdef CONP_WITH_THREADS
+// parsed entries that are not changed anymore, so any number of threads can read them,
+// only conp_entries_loc must not be called, it builds the line table of a source on demand
+typedef struct ConpSnapshot{
+    ConpEntries entries; // allocated from the arena of the snapshot
+    ConpArena arena;
+    char *buffer;
+    size_t buffer_size;
+    void (*release)(char *buffer, size_t buffer_size); // releases the buffer with the snapshot, NULL if it is not owned
+    uint64_t retired; // the epoch in which the snapshot was replaced
+    struct ConpSnapshot *next; // the next snapshot that was replaced
+} ConpSnapshot;
+
+typedef struct{
+    uint64_t epoch; // the epoch in which the reader entered, 0 while it is outside
+    bool used;
+} __attribute__((aligned(64))) ConpReader;
+
+/*
+    Read-copy-update of snapshots with epoch based reclamation: readers pin
+    the current snapshot without locks by announcing the epoch they entered
+    in, the writer swaps in a new snapshot and increments the epoch. A
+    replaced snapshot is freed once no reader is inside an epoch that is not
+    newer than the one it was replaced in.
+*/
+typedef struct{
+    ConpSnapshot *current;
+    uint64_t epoch;
+    ConpReader readers[CONP_SHARED_READERS];
+    ConpSnapshot *retired; // replaced snapshots that may still be read, only used by the writer
+    pthread_mutex_t writer; // serializes the writers
+} ConpShared;
+#endif
+
 #define conp_expect(lexer, token, ...) conp__expect(lexer, token, conp_token_args_array(__VA_ARGS__)) // fetch the next token and expect one of the given token types
 ConpLexer conp_init(char *buffer, size_t buffer_size, char *buffer_name); // initilize the lexer
 bool conp_next(ConpLexer *lexer, ConpToken *token); // fetch the next token
 bool conp_extract(ConpToken *token, char *buffer, size_t buffer_size); // extract the content of a token into a buffer
-void conp_print(ConpToken token); // print a token
+ConpView conp_view(ConpToken *token, char *buffer, size_t buffer_size); // borrow the content of a token, only strings with escapes are unescaped into the buffer
+void conp_print(ConpLexer *lexer, ConpToken token); // print a token with its location
 void conp_print_token(ConpToken token);
+ConpLoc conp_lexer_loc(ConpLexer *lexer, char *p); // resolve the location of a pointer into the buffer of the lexer
 
-bool conp_parse(ConpLexer *lexer, ConpEntry *entry);
-bool conp_parse_all(ConpEntries *entries, char *buffer, size_t buffer_size, char *buffer_name);
+bool conp_parse(ConpLexer *lexer, ConpEntry *entry); // parse the next entry, a section header is returned as an entry of type ConpToken_Section
+bool conp_parse_all(ConpEntries *entries, char *buffer, size_t buffer_size, char *buffer_name); // parse all entries up to the first error, which is reported and marks the source as failed, the entries in front of it are kept, false if the buffer is larger than 4 GiB or has too many sections
+bool conp_validate(char *buffer, size_t buffer_size, char *buffer_name, ConpDiagnostics *diagnostics); // collect all errors, parsing continues at the next line after each of them
+void conp_diagnostics_print(ConpDiagnostics *diagnostics, FILE *file);
+void conp_diagnostics_free(ConpDiagnostics *diagnostics);
+bool conp_find(char *buffer, size_t buffer_size, char *buffer_name, char *section, char *key, ConpToken *token); // look up the first entry with the given key without parsing the whole buffer or allocating, errors are not reported, parse or validate the buffer for them
+bool conp_find_nocase(char *buffer, size_t buffer_size, char *buffer_name, char *section, char *key, ConpToken *token); // same as conp_find, but keys are compared ignoring case
+#ifdef CONP_WITH_THREADS
+bool conp_parse_all_parallel(ConpEntries *entries, char *buffer, size_t buffer_size, char *buffer_name, size_t thread_count); // same result as conp_parse_all, thread_count 0 uses all cores
+bool conp_parse_sources(ConpEntries *entries, ConpSource *sources, size_t source_count, size_t thread_count); // parse several buffers concurrently, the entries are merged in the order of the sources, so the first source with a key wins
+#endif
 void conp_entries_add(ConpEntries *entries, ConpEntry entry);
 bool conp_entries_get(ConpEntries *entries, char *key, ConpToken *token);
 bool conp_entries_iskey(ConpEntries *entries, char *key);
+ConpEntry* conp_entries_find(ConpEntries *entries, char *key); // look up the first entry with the given key in the root section, NULL if there is none
+ConpSection* conp_entries_section(ConpEntries *entries, char *section); // look up a section by name, NULL is the root section
+ConpEntry* conp_section_find(ConpEntries *entries, char *section, char *key); // look up the first entry with the given key in a section, NULL is the root section
+bool conp_section_get(ConpEntries *entries, char *section, char *key, ConpToken *token);
+bool conp_section_names(ConpEntries *entries, char *section, char *alias_section); // build the case-insensitive index of the keys of a section, the entries of alias_section (NULL for none) name keys of the section they stand for
+ConpEntry* conp_section_resolve(ConpEntries *entries, char *section, char *name); // look up a key or an alias of a section ignoring case with the index of conp_section_names, NULL if there is none
+void conp_entries_free(ConpEntries *entries);
+bool conp_entries_update(ConpEntries *entries, size_t source, char *buffer, size_t buffer_size, size_t edit_start, size_t edit_old_len, size_t edit_new_len); // switch a source to its edited buffer and re-parse only the entries around the edit, the old buffer has to stay valid during the call
+bool conp_entries_reload(ConpEntries *entries, size_t source, char *buffer, size_t buffer_size); // same as conp_entries_update, the edit is found by comparing the new buffer with the old one
+bool conp_entries_add_source(ConpEntries *entries, char *buffer, size_t buffer_size, char *buffer_name, size_t *source); // add a source without entries, false if the buffer is larger than 4 GiB or there are CONP_MAX_SOURCES already
+ConpToken conp_entry_key(ConpEntries *entries, ConpEntry *entry);
+ConpToken conp_entry_value(ConpEntries *entries, ConpEntry *entry);
+bool conp_entry_int(ConpEntries *entries, ConpEntry *entry, int64_t *value); // read an Int, false if the entry is none or does not fit (errno is ERANGE then), the number is parsed once and cached on the entry
+bool conp_entry_double(ConpEntries *entries, ConpEntry *entry, double *value); // read a Float or an Int correctly rounded and independent of the locale, false if the entry is none or overflows (errno is ERANGE then)
+bool conp_entry_bool(ConpEntries *entries, ConpEntry *entry, bool *value);
+bool conp_get_int(ConpEntries *entries, char *section, char *key, int64_t *value); // look up a key with conp_section_find and read it with conp_entry_int, NULL is the root section
+bool conp_get_double(ConpEntries *entries, char *section, char *key, double *value);
+bool conp_get_bool(ConpEntries *entries, char *section, char *key, bool *value);
+ConpLoc conp_entries_loc(ConpEntries *entries, size_t source, size_t offset); // resolve the location of an offset into a source
+
+void* conp_arena_alloc(ConpArena *arena, size_t size);
+void* conp_arena_realloc(ConpArena *arena, void *ptr, size_t old_size, size_t new_size); // grows in place if ptr is the last allocation
+char* conp_arena_extract(ConpArena *arena, ConpToken *token); // extract the content of a token into a null-terminated arena string
+void conp_arena_free(ConpArena *arena);
+
+#ifdef CONP_WITH_CACHE
+bool conp_cache_write(ConpEntries *entries, char *cache_path, char *source, size_t source_size, int64_t source_mtime); // compile the entries parsed from source into a cache file
+bool conp_cache_open(ConpCache *cache, char *cache_path, char *source, size_t source_size, int64_t source_mtime); // map a cache file, fails if it was not compiled from this source
+bool conp_cache_get(ConpCache *cache, char *key, ConpToken *token);
+bool conp_cache_section_get(ConpCache *cache, char *section, char *key, ConpToken *token); // NULL is the root section
+bool conp_cache_section_resolve(ConpCache *cache, char *section, char *alias_section, char *name, ConpToken *token); // same rules as conp_section_resolve
+ConpToken conp_cache_key(ConpCache *cache, size_t i);
+ConpToken conp_cache_value(ConpCache *cache, size_t i);
+ConpToken conp_cache_section(ConpCache *cache, size_t i); // name of the section of the i-th entry, empty for the root section
+void conp_cache_close(ConpCache *cache);
+#endif
+
+ConpStream conp_stream_init(char *stream_name);
+void conp_stream_feed(ConpStream *stream, char *chunk, size_t chunk_size); // append the next chunk of input, invalidates all tokens returned so far
+void conp_stream_finish(ConpStream *stream); // mark the end of the input
+bool conp_stream_next(ConpStream *stream, ConpToken *key, ConpToken *value); // fetch the next complete entry or section header, false if more input is needed, the input ended or is invalid
+void conp_stream_free(ConpStream *stream);
+
+#ifdef CONP_WITH_THREADS
+ConpSnapshot* conp_snapshot_parse(char *buffer, size_t buffer_size, char *buffer_name, void (*release)(char *buffer, size_t buffer_size)); // parse a buffer into a new snapshot, NULL if it contains an error, the buffer is only owned by a snapshot that was created
+void conp_snapshot_free(ConpSnapshot *snapshot);
+void conp_shared_init(ConpShared *shared);
+ConpReader* conp_shared_join(ConpShared *shared); // claim a reader slot for the calling thread, NULL if all CONP_SHARED_READERS slots are taken
+void conp_shared_part(ConpShared *shared, ConpReader *reader); // give the slot of a reader back
+ConpSnapshot* conp_shared_enter(ConpShared *shared, ConpReader *reader); // pin the current snapshot until conp_shared_leave, entering is not nested
+void conp_shared_leave(ConpShared *shared, ConpReader *reader);
+bool conp_shared_get(ConpShared *shared, ConpReader *reader, char *section, char *key, char *buffer, size_t buffer_size); // look up a key in the current snapshot and extract its value into the buffer
+void conp_shared_publish(ConpShared *shared, ConpSnapshot *snapshot); // replace the current snapshot, the old one is freed once no reader can see it anymore
+size_t conp_shared_reclaim(ConpShared *shared); // free the replaced snapshots that no reader can see anymore, returns the number of those left
+void conp_shared_free(ConpShared *shared); // free all snapshots, no reader may be inside anymore
+#endif
+
+#if defined(CONP_WITH_WATCH) && defined(__linux__)
+bool conp_watch_open(ConpWatch *watch, ConpEntries *entries, char *path); // parse a file as a new source of the entries and watch it, errors of the file are reported but do not stop the watch
+int conp_watch_poll(ConpWatch *watch, int timeout); // wait up to timeout ms (-1 forever) for the file to change and apply the change, 1 if the entries were updated, 0 if not and -1 on errors
+void conp_watch_close(ConpWatch *watch); // the buffer of the source is released, so close the watch after the entries are freed
+#endif
 
 // these functions are used internally, there should be no reason to call them yourself
 void conp__trim_left(ConpLexer *lexer);
-bool conp__find(ConpLexer *lexer, char c);
-void conp__set_token(ConpToken *token, ConpTokenType type, char *start, char *end, ConpLoc loc);
+bool conp__find_string_end(ConpLexer *lexer);
+void conp__find_delimeter(ConpLexer *lexer);
+void conp__set_token(ConpToken *token, ConpTokenType type, char *start, char *end);
 bool conp__is_delimeter(char c);
-bool conp__is_int(char *s, char *e);
-bool conp__is_float(char *s, char *e);
 bool conp__expect(ConpLexer *lexer, ConpToken *token, ConpTokenType types[], size_t count);
+bool conp__pause(ConpLexer *lexer, ConpTokenType type, char *start);
+void conp__report(ConpLexer *lexer, char *p, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+void conp__diagnostics_locate(ConpDiagnostics *diagnostics, ConpLexer *lexer);
+uint64_t conp__hash(const char *s, size_t len);
+#ifdef CONP_WITH_CACHE
+uint64_t conp__hash_content(const char *s, size_t len);
+#endif
+uint64_t conp__hash_folded(const char *s, size_t len);
+bool conp__equal_folded(const char *a, const char *b, size_t len);
+ConpView conp__view_alloc(ConpToken *token, char *buffer, size_t buffer_size, char **allocated); // same as conp_view, but a token that does not fit is unescaped into an allocation the caller frees
+void conp__names_build(ConpEntries *entries, size_t section);
+ConpName* conp__names_slot(ConpEntries *entries, size_t section, const char *name, size_t name_len, bool keys_only);
+void conp__names_rebuild(ConpEntries *entries);
+#ifdef CONP_WITH_CACHE
+bool conp__cache_section_id(ConpCache *cache, char *section, size_t *id);
+ConpCacheEntry* conp__cache_find(ConpCache *cache, size_t section, const char *key, size_t key_len, bool fold);
+#endif
+void conp__index_insert(ConpEntries *entries, size_t item);
+void conp__index_grow(ConpEntries *entries, size_t section);
+void conp__index_rebuild(ConpEntries *entries);
+uint32_t* conp__index_slot(ConpEntries *entries, size_t section, const char *key, size_t key_len);
+void conp__index_remove(ConpEntries *entries, size_t section, uint32_t *slot);
+void conp__splice(ConpEntries *entries, size_t at, size_t removed, ConpEntry *items, size_t count);
+bool conp__update_next(ConpLexer *lexer, ConpEntry *entry, size_t *start);
+void conp__update_full(ConpEntries *entries, size_t source, size_t first, size_t last, char *buffer, size_t buffer_size);
+size_t conp__source_first(ConpEntries *entries, size_t source);
+#ifdef CONP_WITH_THREADS
+size_t conp__shared_reclaim(ConpShared *shared);
+#endif
+#ifdef CONP_WITH_WATCH
+char* conp__read_file(char *path, size_t *size);
+#endif
+bool conp__section_id(ConpEntries *entries, char *name, size_t name_len, size_t *section);
+#ifdef CONP_WITH_CACHE
+uint64_t conp__cache_hash(const char *key, size_t len, size_t section);
+#endif
+void conp__source_lines(ConpSource *source);
+void* conp__realloc(ConpEntries *entries, void *ptr, size_t old_size, size_t new_size);
+void conp__free(ConpEntries *entries, void *ptr);
+#ifdef CONP_WITH_CACHE
+bool conp__cache_token(ConpCache *cache, ConpSpan span, ConpToken *token);
+#endif
+void conp__parse_chunk(ConpChunk *chunk, bool quiet);
+size_t conp__find_key(const char *buffer, size_t from, size_t buffer_size, const char *key, size_t key_len, bool fold);
+bool conp__find(char *buffer, size_t buffer_size, char *buffer_name, char *section, char *key, bool fold, ConpToken *token);
+#ifdef CONP_WITH_THREADS
+void* conp__parse_chunk_worker(void *arg);
+void* conp__parse_queue_worker(void *arg);
+bool conp__merge_chunk(ConpEntries *entries, ConpChunk *chunk, size_t source, size_t *section);
+#endif
+uint8_t conp__entry_number(ConpEntries *entries, ConpEntry *entry, uint64_t *number);
+bool conp__parse_int(const char *s, size_t len, int64_t *value);
+double conp__parse_double(const char *s, size_t len, bool *overflow);
+void conp__decimal_shift(ConpDecimal *decimal, int shift);
+void conp__decimal_left(ConpDecimal *decimal, int shift);
+void conp__decimal_right(ConpDecimal *decimal, int shift);
+uint64_t conp__decimal_round(ConpDecimal *decimal);
 
 #endif // _CONP_H
 
 #ifdef CONP_IMPLEMENTATION
 
+/*
+    Literal classification: a DFA over character classes that runs while the
+    end of a literal is searched. Every transition that is not listed leads to
+    CONP__LIT_FIELD, which is the only state that cannot be left again.
+*/
+enum{
+    CONP__CHAR_OTHER,
+    CONP__CHAR_DELIM,
+    CONP__CHAR_DIGIT,
+    CONP__CHAR_SIGN,
+    CONP__CHAR_DOT,
+    CONP__CHAR_EXP,
+    CONP__CHAR_E,
+    CONP__CHAR_T,
+    CONP__CHAR_R,
+    CONP__CHAR_U,
+    CONP__CHAR_F,
+    CONP__CHAR_A,
+    CONP__CHAR_L,
+    CONP__CHAR_S,
+    CONP__CHAR__COUNT
+};
+
+enum{
+    CONP__LIT_FIELD,
+    CONP__LIT_START,
+    CONP__LIT_SIGN,
+    CONP__LIT_INT,
+    CONP__LIT_DOT,
+    CONP__LIT_FRAC,
+    CONP__LIT_EXP,
+    CONP__LIT_EXP_SIGN,
+    CONP__LIT_EXP_INT,
+    CONP__LIT_T,
+    CONP__LIT_TR,
+    CONP__LIT_TRU,
+    CONP__LIT_TRUE,
+    CONP__LIT_F,
+    CONP__LIT_FA,
+    CONP__LIT_FAL,
+    CONP__LIT_FALS,
+    CONP__LIT_FALSE,
+    CONP__LIT__COUNT
+};
+
+static const uint8_t conp__char_classes[256] = {
+    ['='] = CONP__CHAR_DELIM, [' '] = CONP__CHAR_DELIM, ['\n'] = CONP__CHAR_DELIM, ['\t'] = CONP__CHAR_DELIM,
+    ['0' ... '9'] = CONP__CHAR_DIGIT,
+    ['+'] = CONP__CHAR_SIGN, ['-'] = CONP__CHAR_SIGN,
+    ['.'] = CONP__CHAR_DOT,
+    ['E'] = CONP__CHAR_EXP, ['e'] = CONP__CHAR_E,
+    ['t'] = CONP__CHAR_T, ['r'] = CONP__CHAR_R, ['u'] = CONP__CHAR_U,
+    ['f'] = CONP__CHAR_F, ['a'] = CONP__CHAR_A, ['l'] = CONP__CHAR_L, ['s'] = CONP__CHAR_S,
+};
+
+static const uint8_t conp__literal_dfa[CONP__LIT__COUNT][CONP__CHAR__COUNT] = {
+    [CONP__LIT_START] = {[CONP__CHAR_DIGIT] = CONP__LIT_INT, [CONP__CHAR_SIGN] = CONP__LIT_SIGN, [CONP__CHAR_DOT] = CONP__LIT_DOT, [CONP__CHAR_T] = CONP__LIT_T, [CONP__CHAR_F] = CONP__LIT_F},
+    [CONP__LIT_SIGN] = {[CONP__CHAR_DIGIT] = CONP__LIT_INT, [CONP__CHAR_DOT] = CONP__LIT_DOT},
+    [CONP__LIT_INT] = {[CONP__CHAR_DIGIT] = CONP__LIT_INT, [CONP__CHAR_DOT] = CONP__LIT_FRAC, [CONP__CHAR_EXP] = CONP__LIT_EXP, [CONP__CHAR_E] = CONP__LIT_EXP},
+    [CONP__LIT_DOT] = {[CONP__CHAR_DIGIT] = CONP__LIT_FRAC},
+    [CONP__LIT_FRAC] = {[CONP__CHAR_DIGIT] = CONP__LIT_FRAC, [CONP__CHAR_EXP] = CONP__LIT_EXP, [CONP__CHAR_E] = CONP__LIT_EXP},
+    [CONP__LIT_EXP] = {[CONP__CHAR_DIGIT] = CONP__LIT_EXP_INT, [CONP__CHAR_SIGN] = CONP__LIT_EXP_SIGN},
+    [CONP__LIT_EXP_SIGN] = {[CONP__CHAR_DIGIT] = CONP__LIT_EXP_INT},
+    [CONP__LIT_EXP_INT] = {[CONP__CHAR_DIGIT] = CONP__LIT_EXP_INT},
+    [CONP__LIT_T] = {[CONP__CHAR_R] = CONP__LIT_TR},
+    [CONP__LIT_TR] = {[CONP__CHAR_U] = CONP__LIT_TRU},
+    [CONP__LIT_TRU] = {[CONP__CHAR_E] = CONP__LIT_TRUE},
+    [CONP__LIT_F] = {[CONP__CHAR_A] = CONP__LIT_FA},
+    [CONP__LIT_FA] = {[CONP__CHAR_L] = CONP__LIT_FAL},
+    [CONP__LIT_FAL] = {[CONP__CHAR_S] = CONP__LIT_FALS},
+    [CONP__LIT_FALS] = {[CONP__CHAR_E] = CONP__LIT_FALSE},
+};
+
+static const ConpTokenType conp__literal_types[CONP__LIT__COUNT] = {
+    [CONP__LIT_INT] = ConpToken_Int,
+    [CONP__LIT_FRAC] = ConpToken_Float,
+    [CONP__LIT_EXP_INT] = ConpToken_Float,
+    [CONP__LIT_TRUE] = ConpToken_True,
+    [CONP__LIT_FALSE] = ConpToken_False,
+    // all other states are fields, which is not the first enumerator
+    [CONP__LIT_FIELD] = ConpToken_Field, [CONP__LIT_START] = ConpToken_Field, [CONP__LIT_SIGN] = ConpToken_Field,
+    [CONP__LIT_DOT] = ConpToken_Field, [CONP__LIT_EXP] = ConpToken_Field, [CONP__LIT_EXP_SIGN] = ConpToken_Field,
+    [CONP__LIT_T] = ConpToken_Field, [CONP__LIT_TR] = ConpToken_Field, [CONP__LIT_TRU] = ConpToken_Field,
+    [CONP__LIT_F] = ConpToken_Field, [CONP__LIT_FA] = ConpToken_Field, [CONP__LIT_FAL] = ConpToken_Field, [CONP__LIT_FALS] = ConpToken_Field,
+};
+
 bool conp_parse(ConpLexer *lexer, ConpEntry *entry)
 {
     if (lexer == NULL || entry == NULL) return false;
     ConpToken token;
-    conp_next(lexer, &token);
-    if (token.type == ConpToken_End) return false;
-    entry->key = token;
+    if (!conp_next(lexer, &token)) return false;
+    if ((size_t) (token.start-lexer->buffer) > UINT32_MAX){
+        // the spans of an entry are 32 bits
+        conp__report(lexer, token.start, "Entries behind the first %u bytes are not supported!", UINT32_MAX);
+        return false;
+    }
+    entry->key = (ConpSpan) {.offset=token.start-lexer->buffer, .len=token.len};
+    entry->number = 0;
+    entry->number_state = CONP__NUMBER_UNPARSED;
+    entry->source = 0;
+    entry->section = 0;
+    if (token.type == ConpToken_Section){
+        // a header is returned as an entry of its own, the key is the name of the section
+        entry->value = (ConpSpan) {.offset=token.end-lexer->buffer, .len=0};
+        entry->type = ConpToken_Section;
+        entry->escaped = false;
+        return true;
+    }
     if (!conp_expect(lexer, &token, ConpToken_Sep)) return false;
     if (!conp_expect(lexer, &token, CONP_VALUES)) return false;
-    entry->value = token;
+    entry->value = (ConpSpan) {.offset=token.start-lexer->buffer, .len=token.len};
+    entry->type = token.type;
+    entry->escaped = token.escaped;
     return true;
 }
 
 bool conp_parse_all(ConpEntries *entries, char *buffer, size_t buffer_size, char *buffer_name)
 {
     if (entries == NULL || buffer == NULL) return false;
+    size_t source, section;
+    if (!conp_entries_add_source(entries, buffer, buffer_size, buffer_name, &source)) return false;
     ConpLexer lexer = conp_init(buffer, buffer_size, buffer_name);
     ConpEntry entry;
+    (void) conp__section_id(entries, NULL, 0, &section);
     while (conp_parse(&lexer, &entry)){
+        if (entry.type == ConpToken_Section){
+            if (!conp__section_id(entries, buffer+entry.key.offset, entry.key.len, &section)){
+                entries->sources[source].failed = true;
+                return false;
+            }
+            continue;
+        }
+        entry.source = source;
+        entry.section = section;
         conp_entries_add(entries, entry);
     }
+    entries->sources[source].failed = lexer.error_count > 0;
     return true;
 }
 
-bool conp_entries_get(ConpEntries *entries, char *key, ConpToken *token)
+bool conp_validate(char *buffer, size_t buffer_size, char *buffer_name, ConpDiagnostics *diagnostics)
 {
-    if (entries == NULL || key == NULL || token == NULL) return false;
-    size_t key_len = strlen(key);
-    for (size_t i=0; i<entries->count; ++i){
-        ConpEntry entry = entries->items[i];
-        if (key_len != entry.key.len) continue;
-        if (memcmp(entry.key.start, key, key_len) == 0){
-            *token = entry.value;
-            return true;
-        }
+    if (buffer == NULL || diagnostics == NULL) return false;
+    size_t first = diagnostics->count;
+    ConpLexer lexer = conp_init(buffer, buffer_size, buffer_name);
+    lexer.diagnostics = diagnostics;
+    ConpEntry entry;
+    while (lexer.index < lexer.buffer_size){
+        size_t errors = lexer.error_count;
+        if (conp_parse(&lexer, &entry)) continue;
+        if (lexer.error_count == errors) break; // the input ended
+        // skip the rest of the line the error was found in, an unterminated string is only skipped up to its line end
+        size_t from = lexer.index;
+        if (from >= lexer.buffer_size && diagnostics->count > first) from = diagnostics->items[diagnostics->count-1].offset;
+        char *nl = memchr(buffer+from, '\n', lexer.buffer_size-from);
+        lexer.index = (nl != NULL)? (size_t) (nl-buffer)+1:lexer.buffer_size;
     }
-    return false;
+    // the errors were found in order, so they are all located in one pass
+    ConpDiagnostics added = {.items=diagnostics->items+first, .count=diagnostics->count-first};
+    conp__diagnostics_locate(&added, &lexer);
+    return lexer.error_count == 0;
 }
 
-void conp_entries_add(ConpEntries *entries, ConpEntry entry)
+void conp_diagnostics_print(ConpDiagnostics *diagnostics, FILE *file)
 {
-    if (entries == NULL) return;
-    if (entries->count >= entries->capacity){
-        size_t capacity = entries->capacity;
-        entries->capacity = (capacity == 0)? 32:capacity*2;
-        entries->items = realloc(entries->items, entries->capacity*sizeof(*entries->items));
-        assert(entries->items != NULL && "Need more RAM!");
+    if (diagnostics == NULL || file == NULL) return;
+    for (size_t i=0; i<diagnostics->count; ++i){
+        ConpDiagnostic *diagnostic = &diagnostics->items[i];
+        fprintf(file, "[ERROR] "CONP_LOC_FMT" %s\n", conp_loc_expand(diagnostic->loc), diagnostic->message);
     }
-    entries->items[entries->count++] = entry;
 }
 
-bool conp_entries_iskey(ConpEntries *entries, char *key)
+void conp_diagnostics_free(ConpDiagnostics *diagnostics)
 {
-    if (entries == NULL || key == NULL) return false;
-    size_t key_len = strlen(key);
-    for (size_t i=0; i<entries->count; ++i){
-        ConpToken ikey = entries->items[i].key;
-        if (key_len == ikey.len && memcmp(key, ikey.start, key_len) == 0) return true;
+    if (diagnostics == NULL) return;
+    for (size_t i=0; i<diagnostics->count; ++i){
+        free(diagnostics->items[i].message);
     }
-    return false;
+    free(diagnostics->items);
+    *diagnostics = (ConpDiagnostics) {0};
 }
 
-ConpLexer conp_init(char *buffer, size_t buffer_size, char *buffer_name)
+/*
+    Lexes only up to the first entry with the key. The prefilter searches the
+    raw bytes of the key ahead of the lexer: entries that start before the
+    next occurrence are skipped without comparing their key, and once there
+    is no occurrence left the key cannot follow anymore. Errors are only
+    reported if they lie in front of the last occurrence.
+*/
+bool conp_find(char *buffer, size_t buffer_size, char *buffer_name, char *section, char *key, ConpToken *token)
 {
-    return (ConpLexer) {.buffer=buffer, .buffer_size=buffer_size, .index=0, .loc=(ConpLoc){.filename=buffer_name, .row=1, .column=1}};
+    return conp__find(buffer, buffer_size, buffer_name, section, key, false, token);
 }
 
-bool conp_next(ConpLexer *lexer, ConpToken *token)
+bool conp_find_nocase(char *buffer, size_t buffer_size, char *buffer_name, char *section, char *key, ConpToken *token)
 {
-    if (lexer == NULL || token == NULL || lexer->index > lexer->buffer_size) return false;
-    conp__trim_left(lexer);
-    char *start = conp_get_pointer(lexer);
-    ConpLoc loc = lexer->loc;
-    switch (conp_get_char(lexer)){
-        case '=':{
-            conp__set_token(token, ConpToken_Sep, start, start+1, loc);
-        } break;
-        case '"':{
-            // lex strings
-            conp_inc(lexer);
-            char *s_start = conp_get_pointer(lexer);
-            if (!conp__find(lexer, '"')){
-                fprintf(stderr, "[ERROR] Missing closing delimeter for '\"' at " CONP_LOC_FMT "\n", conp_loc_expand(loc));
-                return false;
-            }
-            char *s_end = conp_get_pointer(lexer);
-            conp__set_token(token, ConpToken_String, s_start, s_end, loc);
-            break;
+    return conp__find(buffer, buffer_size, buffer_name, section, key, true, token);
+}
+
+bool conp__find(char *buffer, size_t buffer_size, char *buffer_name, char *section, char *key, bool fold, ConpToken *token)
+{
+    if (buffer == NULL || key == NULL || token == NULL) return false;
+    size_t key_len = strlen(key);
+    size_t section_len = (section != NULL)? strlen(section):0;
+    bool in_section = section == NULL;
+    size_t next = conp__find_key(buffer, 0, buffer_size, key, key_len, fold);
+    if (next >= buffer_size) return false;
+    ConpLexer lexer = conp_init(buffer, buffer_size, buffer_name);
+    // only the errors in front of the key would be seen, so none are reported
+    lexer.quiet = true;
+    ConpEntry entry;
+    while (conp_parse(&lexer, &entry)){
+        if (entry.type == ConpToken_Section){
+            // the root section ends with the first header
+            if (section == NULL) return false;
+            in_section = entry.key.len == section_len && memcmp(buffer+entry.key.offset, section, section_len) == 0;
+            continue;
         }
-        case '\0':
-        case EOF:{
-            conp__set_token(token, ConpToken_End, start, start+1, loc);
-            conp_inc(lexer);
-            return false;
+        if (entry.key.offset > next){
+            // occurrences in front of this key were not at the start of a key
+            next = conp__find_key(buffer, entry.key.offset, buffer_size, key, key_len, fold);
+            if (next >= buffer_size) return false;
         }
-        default:{
-            // multi-character literal
-            // find end of literal
-            char c;
-            while (lexer->index < lexer->buffer_size && !conp__is_delimeter(c = conp_get_char(lexer))){
-                conp_check_line(lexer, c);
-                lexer->index++;
-            }
-            char *end = conp_get_pointer(lexer);
-            size_t t_len = end-start;
-            // check for known literals
-            if (memcmp(start, "true", t_len) == 0){
-                conp__set_token(token, ConpToken_True, start, end, loc);
-                return true;
-            }
-            if (memcmp(start, "false", t_len) == 0){
-                conp__set_token(token, ConpToken_False, start, end, loc);
-                return true;
-            }
-            if (conp__is_int(start, end)){
-                conp__set_token(token, ConpToken_Int, start, end, loc);
-                return true;
-            }
-            if (conp__is_float(start, end)){
-                conp__set_token(token, ConpToken_Float, start, end, loc);
-                return true;
-            }
-            conp__set_token(token, ConpToken_Field, start, end, loc);
+        if (in_section && entry.key.offset == next && entry.key.len == key_len){
+            conp__set_token(token, entry.type, buffer+entry.value.offset, buffer+entry.value.offset+entry.value.len);
+            token->escaped = entry.escaped;
             return true;
         }
     }
-    conp_inc(lexer);
-    return true;
+    return false;
 }
 
-bool conp__expect(ConpLexer *lexer, ConpToken *token, ConpTokenType types[], size_t count)
+#ifdef CONP_WITH_THREADS
+/*
+    The buffer is split behind newlines into one chunk per thread and every
+    chunk is parsed as if an entry started there. That guess is wrong if the
+    split lies inside a string or an entry, which is detected while merging:
+    a chunk is only taken as is if the previous one stopped exactly at its
+    first entry, otherwise it is parsed again from where the previous one
+    stopped. Workers are quiet, errors are reported by parsing the chunk that
+    contains them again, so diagnostics match conp_parse_all.
+*/
+bool conp_parse_all_parallel(ConpEntries *entries, char *buffer, size_t buffer_size, char *buffer_name, size_t thread_count)
 {
-    if (lexer == NULL || token == NULL) return false;
-    conp_next(lexer, token);
-    for (size_t i=0; i<count; ++i){
-        if (token->type == types[i]) return true;
+    if (entries == NULL || buffer == NULL) return false;
+    if (thread_count == 0){
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = (cores > 0)? (size_t) cores:1;
     }
-    fprintf(stderr, "[ERROR] "CONP_LOC_FMT " Expected token of type [", conp_loc_expand(token->loc));
-    size_t i;
-    for (i=0; i<count-1; ++i){
-        fprintf(stderr, "%s, ", ConpTokenTypeNames[types[i]]);
+    if (thread_count > buffer_size/CONP_PARALLEL_MIN_CHUNK) thread_count = buffer_size/CONP_PARALLEL_MIN_CHUNK;
+    if (thread_count <= 1 || buffer_size > UINT32_MAX) return conp_parse_all(entries, buffer, buffer_size, buffer_name);
+    size_t source;
+    if (!conp_entries_add_source(entries, buffer, buffer_size, buffer_name, &source)) return false;
+
+    ConpChunk *chunks = calloc(thread_count, sizeof(*chunks));
+    pthread_t *threads = calloc(thread_count, sizeof(*threads));
+    bool *started = calloc(thread_count, sizeof(*started));
+    assert(chunks != NULL && threads != NULL && started != NULL && "Need more RAM!");
+    size_t start = 0;
+    for (size_t i=0; i<thread_count; ++i){
+        size_t end = buffer_size;
+        if (i+1 < thread_count){
+            end = buffer_size/thread_count*(i+1);
+            if (end < start) end = start;
+            char *nl = memchr(buffer+end, '\n', buffer_size-end);
+            end = (nl != NULL)? (size_t) (nl-buffer)+1:buffer_size;
+        }
+        chunks[i] = (ConpChunk) {.buffer=buffer, .buffer_size=buffer_size, .buffer_name=buffer_name, .start=start, .end=end};
+        start = end;
+    }
+    // the first chunk is parsed by the calling thread
+    for (size_t i=1; i<thread_count; ++i){
+        started[i] = pthread_create(&threads[i], NULL, conp__parse_chunk_worker, &chunks[i]) == 0;
+        if (!started[i]) conp__parse_chunk(&chunks[i], true);
+    }
+    conp__parse_chunk(&chunks[0], false);
+    for (size_t i=1; i<thread_count; ++i){
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+
+    bool result = true;
+    size_t stop = chunks[0].first;
+    size_t section;
+    (void) conp__section_id(entries, NULL, 0, &section);
+    for (size_t i=0; i<thread_count; ++i){
+        ConpChunk *chunk = &chunks[i];
+        if (i > 0 && (chunk->first != stop || chunk->ended)){
+            // the guess was wrong or the chunk has to report an error, parse it again for real
+            chunk->start = stop;
+            chunk->count = 0;
+            chunk->ended = false;
+            chunk->failed = false;
+            conp__parse_chunk(chunk, false);
+        }
+        if (!conp__merge_chunk(entries, chunk, source, &section)){
+            entries->sources[source].failed = true;
+            result = false;
+            break;
+        }
+        if (chunk->ended){
+            entries->sources[source].failed = chunk->failed;
+            break;
+        }
+        stop = chunk->stop;
+    }
+    // the indexes are rebuilt in entry order, so the first entry with a key still wins
+    conp__index_rebuild(entries);
+
+    for (size_t i=0; i<thread_count; ++i){
+        free(chunks[i].items);
     }
-    fprintf(stderr, "%s], but got %s!\n", ConpTokenTypeNames[types[i]], ConpTokenTypeNames[token->type]);
-    return false;  
+    free(chunks);
+    free(threads);
+    free(started);
+    return result;
 }
 
-bool conp_extract(ConpToken *token, char *buffer, size_t buffer_size)
+bool conp_parse_sources(ConpEntries *entries, ConpSource *sources, size_t source_count, size_t thread_count)
 {
-    if (token == NULL || buffer == NULL || buffer_size == 0) return false;
-    size_t t_len = token->end-token->start;
-    if (t_len >= buffer_size) return false;
-    if (token->type == ConpToken_String){
-        char temp_buffer[t_len+1];
-        memset(temp_buffer, 0, t_len+1);
-        char *r = token->start;
-        char *w = temp_buffer;
-        while (r != token->end){
-            if (*r == '\\'){
-                switch(*++r){
-                    case '\'': *w = 0x27; break;
-					case '"':  *w = 0x22; break;
-					case '?':  *w = 0x3f; break;
-					case '\\': *w = 0x5c; break;
-					case 'a':  *w = 0x07; break;
-					case 'b':  *w = 0x08; break;
-					case 'f':  *w = 0x0c; break;
-					case 'n':  *w = 0x0a; break;
-					case 'r':  *w = 0x0d; break;
-					case 't':  *w = 0x09; break;
-					case 'v':  *w = 0x0b; break;
-                    default:{
-                        *w++ = '\\';
-                        *w = *r;
-                    }
-                }
-            }
-            else{
-                *w = *r;
-            }
-            r++;
-            w++;
+    if (entries == NULL || (sources == NULL && source_count > 0)) return false;
+    if (thread_count == 0){
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = (cores > 0)? (size_t) cores:1;
+    }
+    // every source is parsed by a single thread
+    if (thread_count > source_count) thread_count = source_count;
+
+    bool result = true;
+    ConpChunkQueue queue = {.chunks=calloc(source_count, sizeof(*queue.chunks)), .count=source_count};
+    pthread_t *threads = calloc(thread_count, sizeof(*threads));
+    bool *started = calloc(thread_count, sizeof(*started));
+    assert((source_count == 0 || queue.chunks != NULL) && (thread_count == 0 || (threads != NULL && started != NULL)) && "Need more RAM!");
+    for (size_t i=0; i<source_count; ++i){
+        ConpSource *source = &sources[i];
+        queue.chunks[i] = (ConpChunk) {.buffer=source->buffer, .buffer_size=source->buffer_size, .buffer_name=source->name, .end=source->buffer_size};
+        if (source->buffer == NULL || source->buffer_size > UINT32_MAX){
+            // nothing of the source is parsed, the queue skips chunks that already ended
+            queue.chunks[i].ended = true;
+            queue.chunks[i].failed = true;
         }
-        sprintf(buffer, "%.*s", (int) (w-temp_buffer+1), temp_buffer);
     }
-    else{
-        sprintf(buffer, "%.*s", (int) t_len, token->start);
+    for (size_t i=1; i<thread_count; ++i){
+        started[i] = pthread_create(&threads[i], NULL, conp__parse_queue_worker, &queue) == 0;
     }
+    // the calling thread works on the queue as well, so it is drained even if no thread could be started
+    conp__parse_queue_worker(&queue);
+    for (size_t i=1; i<thread_count; ++i){
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+
+    for (size_t i=0; i<source_count; ++i){
+        ConpChunk *chunk = &queue.chunks[i];
+        if (chunk->buffer == NULL) continue;
+        size_t source, section;
+        if (!conp_entries_add_source(entries, chunk->buffer, chunk->buffer_size, chunk->buffer_name, &source)){
+            result = false;
+            continue;
+        }
+        if (chunk->failed){
+            // the workers are quiet, the source is parsed again to report the error in order
+            chunk->count = 0;
+            chunk->ended = false;
+            chunk->failed = false;
+            conp__parse_chunk(chunk, false);
+        }
+        // every source starts in the root section
+        (void) conp__section_id(entries, NULL, 0, &section);
+        if (!conp__merge_chunk(entries, chunk, source, &section)){
+            entries->sources[source].failed = true;
+            result = false;
+            continue;
+        }
+        entries->sources[source].failed = chunk->failed;
+    }
+    // the indexes are rebuilt in entry order, so the first source with a key wins
+    conp__index_rebuild(entries);
+
+    for (size_t i=0; i<source_count; ++i){
+        free(queue.chunks[i].items);
+    }
+    free(queue.chunks);
+    free(threads);
+    free(started);
+    return result;
+}
+#endif // CONP_WITH_THREADS
+
+bool conp_entries_get(ConpEntries *entries, char *key, ConpToken *token)
+{
+    if (token == NULL) return false;
+    ConpEntry *entry = conp_entries_find(entries, key);
+    if (entry == NULL) return false;
+    *token = conp_entry_value(entries, entry);
     return true;
 }
 
-void conp_print_token(ConpToken token)
+void conp_entries_add(ConpEntries *entries, ConpEntry entry)
 {
-    switch (token.type){
-        case ConpToken_End:
-        case ConpToken_Sep:{
-            printf("%s", ConpTokenTypeNames[token.type]);
-        } break;
-        default:{
-            printf("%s: '%.*s'", ConpTokenTypeNames[token.type], (int) token.len, token.start);
-        }
+    if (entries == NULL) return;
+    if (entries->count >= entries->capacity){
+        size_t capacity = entries->capacity;
+        entries->capacity = (capacity == 0)? 32:capacity*2;
+        entries->items = conp__realloc(entries, entries->items, capacity*sizeof(*entries->items), entries->capacity*sizeof(*entries->items));
+        assert(entries->items != NULL && "Need more RAM!");
+    }
+    entries->items[entries->count++] = entry;
+    size_t root;
+    if (entries->section_count == 0) (void) conp__section_id(entries, NULL, 0, &root);
+    assert(entry.section < entries->section_count && "Unknown section!");
+    ConpSection *section = &entries->sections[entry.section];
+    section->count++;
+    // keep the load factor of the index at or below 1/2
+    if (2*section->count > section->index_capacity){
+        conp__index_grow(entries, entry.section);
+    }
+    else{
+        conp__index_insert(entries, entries->count-1);
     }
 }
 
-void conp_print(ConpToken token)
+bool conp_entries_iskey(ConpEntries *entries, char *key)
 {
-    printf(CONP_LOC_FMT": ", conp_loc_expand(token.loc));
-    conp_print_token(token);
-    putchar('\n');
+    return conp_entries_find(entries, key) != NULL;
 }
 
-void conp__set_token(ConpToken *token, ConpTokenType type, char *start, char *end, ConpLoc loc)
+ConpEntry* conp_entries_find(ConpEntries *entries, char *key)
 {
-    if (token == NULL) return;
-    token->type = type;
-    token->start = start;
-    token->end = end;
-    token->len = end-start;
-    token->loc = loc;
+    return conp_section_find(entries, NULL, key);
 }
 
-bool conp__find(ConpLexer *lexer, char c)
+ConpSection* conp_entries_section(ConpEntries *entries, char *section)
 {
-    char rc;
-    while (lexer->index < lexer->buffer_size){
-        if ((rc = conp_get_char(lexer)) == c) return true;
-        conp_check_line(lexer, rc);
-        lexer->index++;
+    if (entries == NULL || entries->section_count == 0) return NULL;
+    if (section == NULL) return &entries->sections[0];
+    size_t len = strlen(section);
+    for (size_t i=1; i<entries->section_count; ++i){
+        ConpSection *s = &entries->sections[i];
+        if (s->name_len == len && memcmp(s->name, section, len) == 0) return s;
     }
-    return false;
+    return NULL;
 }
 
-void conp__trim_left(ConpLexer *lexer)
+ConpEntry* conp_section_find(ConpEntries *entries, char *section, char *key)
 {
-    char c;
-    while (lexer->index <= lexer->buffer_size && conp_is_whitespace((c = conp_get_char(lexer)))){
-        conp_check_line(lexer, c);
-        lexer->index++;
+    if (key == NULL) return NULL;
+    ConpSection *s = conp_entries_section(entries, section);
+    if (s == NULL || s->index_capacity == 0) return NULL;
+    size_t key_len = strlen(key);
+    size_t mask = s->index_capacity-1;
+    for (size_t i=conp__hash(key, key_len)&mask; s->index[i] != 0; i=(i+1)&mask){
+        ConpEntry *entry = &entries->items[s->index[i]-1];
+        if (key_len == entry->key.len && memcmp(conp_span_ptr(entries, entry, entry->key), key, key_len) == 0) return entry;
     }
+    return NULL;
 }
 
-bool conp__is_delimeter(char c)
+bool conp_section_get(ConpEntries *entries, char *section, char *key, ConpToken *token)
 {
-    switch (c){
-        case '=':
-        case ' ':
-        case '\n':
-        case '\t':{
-            return true;
-        }
-        default: return false;
-    }
+    if (token == NULL) return false;
+    ConpEntry *entry = conp_section_find(entries, section, key);
+    if (entry == NULL) return false;
+    *token = conp_entry_value(entries, entry);
+    return true;
 }
 
-bool conp__is_int(char *s, char *e)
+bool conp_section_names(ConpEntries *entries, char *section, char *alias_section)
 {
-	if (!s || !e || e-s < 1) return false;
-	if (*s == '-' || *s == '+') s++;
-	while (s < e){
-		if (!isdigit(*s++)) return false;
-	}
-	return true;
+    ConpSection *s = conp_entries_section(entries, section);
+    if (s == NULL) return false;
+    ConpSection *aliases = (alias_section != NULL)? conp_entries_section(entries, alias_section):NULL;
+    s->aliases = (aliases != NULL)? (size_t) (aliases-entries->sections)+1:0;
+    conp__names_build(entries, s-entries->sections);
+    return true;
+}
+
+ConpEntry* conp_section_resolve(ConpEntries *entries, char *section, char *name)
+{
+    if (name == NULL) return NULL;
+    ConpSection *s = conp_entries_section(entries, section);
+    if (s == NULL || s->names_capacity == 0) return NULL;
+    ConpName *slot = conp__names_slot(entries, s-entries->sections, name, strlen(name), false);
+    return (slot != NULL && slot->entry != 0)? &entries->items[slot->entry-1]:NULL;
 }
 
-bool conp__is_float(char *s, char *e)
+void conp_entries_free(ConpEntries *entries)
 {
-    char* ep = NULL;
-    strtod(s, &ep);
-    return (ep && ep == e);
+    if (entries == NULL) return;
+    conp__free(entries, entries->items);
+    for (size_t i=0; i<entries->section_count; ++i){
+        free(entries->sections[i].index);
+        free(entries->sections[i].names);
+        conp__free(entries, entries->sections[i].name);
+    }
+    conp__free(entries, entries->sections);
+    for (size_t i=0; i<entries->source_count; ++i){
+        free(entries->sources[i].lines);
+    }
+    conp__free(entries, entries->sources);
+    *entries = (ConpEntries) {.arena=entries->arena};
+}
+
+/*
+    The entries in front of the edit are kept and lexing resumes behind the
+    last of them. The old and the new buffer are lexed side by side until an
+    old entry behind the edit starts at the same place as a new one, from there
+    on both buffers are the same, so the remaining entries are only moved.
+    Section headers that were added or removed by the edit and errors make the
+    whole source parsed again.
+*/
+bool conp_entries_update(ConpEntries *entries, size_t source, char *buffer, size_t buffer_size, size_t edit_start, size_t edit_old_len, size_t edit_new_len)
+{
+    if (entries == NULL || buffer == NULL || source >= entries->source_count) return false;
+    ConpSource *src = &entries->sources[source];
+    if (edit_start > src->buffer_size || edit_old_len > src->buffer_size-edit_start || src->buffer_size-edit_old_len+edit_new_len != buffer_size) return false;
+    if (buffer_size > UINT32_MAX){
+        fprintf(stderr, "[ERROR] '%s' is too large, at most %u bytes are supported!\n", src->name, UINT32_MAX);
+        return false;
+    }
+    size_t first = conp__source_first(entries, source);
+    size_t last = conp__source_first(entries, source+1);
+    size_t old_end = edit_start+edit_old_len;
+    // a literal that ends right at the edit might be continued by it
+    size_t at = first, hi = last;
+    while (at < hi){
+        size_t mid = at + (hi-at)/2;
+        ConpEntry *entry = &entries->items[mid];
+        if (entry->value.offset + entry->value.len + (entry->type == ConpToken_String) < edit_start) at = mid+1;
+        else hi = mid;
+    }
+    size_t resume = 0;
+    size_t section;
+    (void) conp__section_id(entries, NULL, 0, &section);
+    if (at > first){
+        ConpEntry *prev = &entries->items[at-1];
+        resume = prev->value.offset + prev->value.len + (prev->type == ConpToken_String);
+        section = prev->section;
+    }
+
+    ConpLexer old_lexer = conp_init(src->buffer, src->buffer_size, src->name);
+    ConpLexer new_lexer = conp_init(buffer, buffer_size, src->name);
+    old_lexer.index = new_lexer.index = resume;
+    old_lexer.quiet = new_lexer.quiet = true;
+    ConpEntry old_entry, new_entry;
+    size_t old_start, new_start;
+    size_t removed = 0;
+    ConpEntry *added = NULL;
+    size_t added_count = 0, added_capacity = 0;
+    bool fast = conp__update_next(&old_lexer, &old_entry, &old_start);
+    bool resynced = false;
+    while (fast && !resynced){
+        if (!conp__update_next(&new_lexer, &new_entry, &new_start)){
+            fast = false;
+            break;
+        }
+        bool end = new_start >= buffer_size;
+        // the old entries in front of the new one are replaced
+        while (fast && old_start < src->buffer_size){
+            size_t moved = (old_start >= old_end)? old_start-edit_old_len+edit_new_len:(old_start < edit_start)? old_start:edit_start;
+            if (!end && moved > new_start) break;
+            resynced = !end && moved == new_start && old_start >= old_end;
+            if (resynced){
+                fast = old_entry.type == ConpToken_Section || (at+removed < last && entries->items[at+removed].key.offset == old_entry.key.offset);
+                break;
+            }
+            if (old_entry.type == ConpToken_Section){
+                // a header in front of the edit is part of both buffers, any other one changes the sections behind it
+                fast = old_entry.value.offset < edit_start;
+            }
+            else{
+                fast = at+removed < last && entries->items[at+removed].key.offset == old_entry.key.offset;
+                removed++;
+            }
+            if (fast) fast = conp__update_next(&old_lexer, &old_entry, &old_start);
+        }
+        if (!fast || resynced) break;
+        if (end){
+            // every old entry behind the kept ones was lexed again
+            fast = at+removed == last;
+            break;
+        }
+        if (new_entry.type == ConpToken_Section){
+            if (new_entry.value.offset >= edit_start){
+                fast = false;
+                break;
+            }
+            if (entries->section_count >= CONP_MAX_SECTIONS){
+                // the header might not fit into the sections, the full parse reports it
+                fast = false;
+                break;
+            }
+            (void) conp__section_id(entries, buffer+new_entry.key.offset, new_entry.key.len, &section);
+            continue;
+        }
+        if (added_count >= added_capacity){
+            added_capacity = (added_capacity == 0)? 16:added_capacity*2;
+            added = realloc(added, added_capacity*sizeof(*added));
+            assert(added != NULL && "Need more RAM!");
+        }
+        new_entry.source = source;
+        new_entry.section = section;
+        added[added_count++] = new_entry;
+    }
+    if (!fast){
+        free(added);
+        conp__update_full(entries, source, first, last, buffer, buffer_size);
+        return !entries->sources[source].failed;
+    }
+
+    // the replaced entries are unindexed, their keys might be taken over by later duplicates
+    ConpEntry *orphans = malloc((removed+1)*sizeof(*orphans));
+    assert(orphans != NULL && "Need more RAM!");
+    size_t orphan_count = 0;
+    char *old_buffer = src->buffer;
+    for (size_t i=at; i<at+removed; ++i){
+        ConpEntry *entry = &entries->items[i];
+        uint32_t *slot = conp__index_slot(entries, entry->section, conp_span_ptr(entries, entry, entry->key), entry->key.len);
+        if (slot != NULL && *slot == i+1){
+            orphans[orphan_count++] = *entry;
+            conp__index_remove(entries, entry->section, slot);
+        }
+        entries->sections[entry->section].count--;
+    }
+    conp__splice(entries, at, removed, added, added_count);
+    for (size_t i=at+added_count; i<last-removed+added_count; ++i){
+        ConpEntry *entry = &entries->items[i];
+        entry->key.offset = entry->key.offset - edit_old_len + edit_new_len;
+        entry->value.offset = entry->value.offset - edit_old_len + edit_new_len;
+    }
+    src->buffer = buffer;
+    src->buffer_size = buffer_size;
+    free(src->lines);
+    src->lines = NULL;
+    src->line_count = 0;
+    if (added_count != removed){
+        // the indices of all entries behind the edit moved as well
+        for (size_t i=0; i<entries->section_count; ++i){
+            ConpSection *s = &entries->sections[i];
+            for (size_t j=0; j<s->index_capacity; ++j){
+                if (s->index[j] != 0 && s->index[j]-1 >= at+removed) s->index[j] = s->index[j]-removed+added_count;
+            }
+        }
+    }
+    ConpSection *s = &entries->sections[section];
+    s->count += added_count;
+    if (2*s->count > s->index_capacity){
+        conp__index_grow(entries, section);
+    }
+    else{
+        for (size_t i=at; i<at+added_count; ++i) conp__index_insert(entries, i);
+    }
+    for (size_t i=0; i<orphan_count; ++i){
+        ConpEntry *orphan = &orphans[i];
+        char *key = old_buffer + orphan->key.offset;
+        if (conp__index_slot(entries, orphan->section, key, orphan->key.len) != NULL) continue;
+        // nothing in front of the edit had the key, so the next duplicate is behind the new entries
+        for (size_t j=at+added_count; j<entries->count; ++j){
+            ConpEntry *entry = &entries->items[j];
+            if (entry->section == orphan->section && entry->key.len == orphan->key.len && memcmp(conp_span_ptr(entries, entry, entry->key), key, orphan->key.len) == 0){
+                conp__index_insert(entries, j);
+                break;
+            }
+        }
+    }
+    free(orphans);
+    free(added);
+    conp__names_rebuild(entries);
+    return !src->failed;
+}
+
+bool conp_entries_reload(ConpEntries *entries, size_t source, char *buffer, size_t buffer_size)
+{
+    if (entries == NULL || buffer == NULL || source >= entries->source_count) return false;
+    ConpSource *src = &entries->sources[source];
+    size_t min = (buffer_size < src->buffer_size)? buffer_size:src->buffer_size;
+    // the edit lies between the common prefix and the common suffix of both buffers
+    size_t prefix = 0;
+    while (prefix+8 <= min && memcmp(buffer+prefix, src->buffer+prefix, 8) == 0) prefix += 8;
+    while (prefix < min && buffer[prefix] == src->buffer[prefix]) prefix++;
+    size_t suffix = 0;
+    while (suffix+8 <= min-prefix && memcmp(buffer+buffer_size-suffix-8, src->buffer+src->buffer_size-suffix-8, 8) == 0) suffix += 8;
+    while (suffix < min-prefix && buffer[buffer_size-suffix-1] == src->buffer[src->buffer_size-suffix-1]) suffix++;
+    return conp_entries_update(entries, source, buffer, buffer_size, prefix, src->buffer_size-prefix-suffix, buffer_size-prefix-suffix);
+}
+
+bool conp_entries_add_source(ConpEntries *entries, char *buffer, size_t buffer_size, char *buffer_name, size_t *source)
+{
+    if (buffer_size > UINT32_MAX){
+        fprintf(stderr, "[ERROR] '%s' is too large, at most %u bytes are supported!\n", buffer_name, UINT32_MAX);
+        return false;
+    }
+    if (entries->source_count >= CONP_MAX_SOURCES){
+        fprintf(stderr, "[ERROR] '%s' can not be added, at most %u sources are supported!\n", buffer_name, (unsigned) CONP_MAX_SOURCES);
+        return false;
+    }
+    entries->sources = conp__realloc(entries, entries->sources, entries->source_count*sizeof(*entries->sources), (entries->source_count+1)*sizeof(*entries->sources));
+    assert(entries->sources != NULL && "Need more RAM!");
+    entries->sources[entries->source_count] = (ConpSource) {.buffer=buffer, .buffer_size=buffer_size, .name=buffer_name};
+    *source = entries->source_count++;
+    return true;
+}
+
+ConpToken conp_entry_key(ConpEntries *entries, ConpEntry *entry)
+{
+    ConpToken token;
+    char *start = conp_span_ptr(entries, entry, entry->key);
+    conp__set_token(&token, ConpToken_Field, start, start+entry->key.len);
+    return token;
+}
+
+ConpToken conp_entry_value(ConpEntries *entries, ConpEntry *entry)
+{
+    ConpToken token;
+    char *start = conp_span_ptr(entries, entry, entry->value);
+    conp__set_token(&token, entry->type, start, start+entry->value.len);
+    token.escaped = entry->escaped;
+    return token;
+}
+
+bool conp_entry_int(ConpEntries *entries, ConpEntry *entry, int64_t *value)
+{
+    if (entries == NULL || entry == NULL || value == NULL || entry->type != ConpToken_Int) return false;
+    uint64_t number;
+    uint8_t state = conp__entry_number(entries, entry, &number);
+    *value = (int64_t) number;
+    if (state == CONP__NUMBER_RANGE){
+        errno = ERANGE;
+        return false;
+    }
+    return true;
+}
+
+bool conp_entry_double(ConpEntries *entries, ConpEntry *entry, double *value)
+{
+    if (entries == NULL || entry == NULL || value == NULL) return false;
+    if (entry->type != ConpToken_Float && entry->type != ConpToken_Int) return false;
+    uint64_t number;
+    uint8_t state = conp__entry_number(entries, entry, &number);
+    if (entry->type == ConpToken_Float) memcpy(value, &number, sizeof(*value));
+    else if (state == CONP__NUMBER_OK) *value = (double) (int64_t) number;
+    else{
+        // an Int beyond int64_t is still a valid double
+        bool overflow;
+        *value = conp__parse_double(conp_span_ptr(entries, entry, entry->value), entry->value.len, &overflow);
+        state = overflow? CONP__NUMBER_RANGE:CONP__NUMBER_OK;
+    }
+    if (state == CONP__NUMBER_RANGE){
+        errno = ERANGE;
+        return false;
+    }
+    return true;
+}
+
+bool conp_entry_bool(ConpEntries *entries, ConpEntry *entry, bool *value)
+{
+    if (entries == NULL || entry == NULL || value == NULL) return false;
+    if (entry->type != ConpToken_True && entry->type != ConpToken_False) return false;
+    *value = entry->type == ConpToken_True;
+    return true;
+}
+
+bool conp_get_int(ConpEntries *entries, char *section, char *key, int64_t *value)
+{
+    return conp_entry_int(entries, conp_section_find(entries, section, key), value);
+}
+
+bool conp_get_double(ConpEntries *entries, char *section, char *key, double *value)
+{
+    return conp_entry_double(entries, conp_section_find(entries, section, key), value);
+}
+
+bool conp_get_bool(ConpEntries *entries, char *section, char *key, bool *value)
+{
+    return conp_entry_bool(entries, conp_section_find(entries, section, key), value);
+}
+
+ConpLoc conp_entries_loc(ConpEntries *entries, size_t source, size_t offset)
+{
+    ConpSource *src = &entries->sources[source];
+    if (src->lines == NULL) conp__source_lines(src);
+    // find the last line that starts at or before the offset
+    size_t lo = 0, hi = src->line_count;
+    while (hi-lo > 1){
+        size_t mid = lo + (hi-lo)/2;
+        if (src->lines[mid] <= offset) lo = mid;
+        else hi = mid;
+    }
+    return (ConpLoc) {.filename=src->name, .row=lo+1, .column=offset-src->lines[lo]+1};
+}
+
+void* conp_arena_alloc(ConpArena *arena, size_t size)
+{
+    if (arena == NULL) return NULL;
+    size = (size+7) & ~(size_t)7;
+    ConpArenaBlock *block = arena->head;
+    if (block == NULL || block->size - block->used < size){
+        size_t block_size = (arena->block_size == 0)? CONP_ARENA_BLOCK_SIZE:arena->block_size;
+        // grow the blocks along with the arena, so large inputs need only a few of them
+        if (block != NULL && block_size < block->size*2 && block->size*2 <= CONP_ARENA_BLOCK_MAX) block_size = block->size*2;
+        if (block_size < size) block_size = size;
+        block = malloc(sizeof(*block) + block_size);
+        assert(block != NULL && "Need more RAM!");
+        block->next = arena->head;
+        block->size = block_size;
+        block->used = 0;
+        arena->head = block;
+        arena->block_count++;
+    }
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+void* conp_arena_realloc(ConpArena *arena, void *ptr, size_t old_size, size_t new_size)
+{
+    if (arena == NULL) return NULL;
+    if (ptr == NULL) return conp_arena_alloc(arena, new_size);
+    ConpArenaBlock *block = arena->head;
+    old_size = (old_size+7) & ~(size_t)7;
+    size_t aligned = (new_size+7) & ~(size_t)7;
+    // the most recent allocation can simply be extended
+    if ((char*) ptr + old_size == block->data + block->used && block->used - old_size + aligned <= block->size){
+        block->used = block->used - old_size + aligned;
+        return ptr;
+    }
+    void *result = conp_arena_alloc(arena, new_size);
+    memcpy(result, ptr, (old_size < new_size)? old_size:new_size);
+    return result;
+}
+
+char* conp_arena_extract(ConpArena *arena, ConpToken *token)
+{
+    if (arena == NULL || token == NULL) return NULL;
+    char *buffer = conp_arena_alloc(arena, token->len+1);
+    if (!conp_extract(token, buffer, token->len+1)) return NULL;
+    return buffer;
+}
+
+void conp_arena_free(ConpArena *arena)
+{
+    if (arena == NULL) return;
+    ConpArenaBlock *block = arena->head;
+    while (block != NULL){
+        ConpArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+    arena->block_count = 0;
+}
+
+#ifdef CONP_WITH_CACHE
+bool conp_cache_write(ConpEntries *entries, char *cache_path, char *source, size_t source_size, int64_t source_mtime)
+{
+    if (entries == NULL || cache_path == NULL || source == NULL) return false;
+    // the table of the cache has 32 bit slots and at least twice as many of them as there are entries
+    if (entries->count > UINT32_MAX/4) return false;
+    bool result = false;
+    uint32_t table_size = 64;
+    while (table_size < 2*entries->count) table_size *= 2;
+    size_t section_count = (entries->section_count == 0)? 1:entries->section_count;
+    uint32_t *table = calloc(table_size, sizeof(*table));
+    ConpCacheEntry *items = calloc(entries->count+1, sizeof(*items));
+    ConpSpan *sections = calloc(section_count, sizeof(*sections));
+    // the entries may come from several sources of up to 4 GiB each, so the pool can outgrow its 32 bit offsets
+    size_t pool_size = 0;
+    assert(table != NULL && items != NULL && sections != NULL && "Need more RAM!");
+    for (size_t i=0; i<entries->count; ++i){
+        ConpEntry *entry = &entries->items[i];
+        items[i] = (ConpCacheEntry) {
+            .key={.offset=pool_size, .len=entry->key.len},
+            .value={.offset=pool_size+entry->key.len, .len=entry->value.len},
+            .type=entry->type,
+            .escaped=entry->escaped,
+            .section=entry->section,
+        };
+        pool_size += entry->key.len + entry->value.len;
+        // same rules as the indexes of the entries: the first entry with a key in a section wins
+        char *key = conp_span_ptr(entries, entry, entry->key);
+        uint32_t slot;
+        for (slot=conp__cache_hash(key, entry->key.len, entry->section)&(table_size-1); table[slot] != 0; slot=(slot+1)&(table_size-1)){
+            ConpEntry *other = &entries->items[table[slot]-1];
+            if (other->section == entry->section && other->key.len == entry->key.len && memcmp(conp_span_ptr(entries, other, other->key), key, entry->key.len) == 0) break;
+        }
+        if (table[slot] == 0) table[slot] = i+1;
+    }
+    for (size_t i=1; i<section_count; ++i){
+        sections[i] = (ConpSpan) {.offset=pool_size, .len=entries->sections[i].name_len};
+        pool_size += entries->sections[i].name_len;
+    }
+    // the offsets were cut, no cache is written, like for any other failure
+    if (pool_size > UINT32_MAX) goto defer;
+    ConpCacheHeader header = {
+        .magic=CONP_CACHE_MAGIC,
+        .version=CONP_CACHE_VERSION,
+        .count=entries->count,
+        .source_size=source_size,
+        .source_mtime=source_mtime,
+        .source_hash=conp__hash_content(source, source_size),
+        .table_size=table_size,
+        .pool_size=(uint32_t) pool_size,
+        .section_count=section_count,
+    };
+    // write to a temporary file first, so concurrent readers never see a partial cache
+    char temp_path[FILENAME_MAX];
+    if (snprintf(temp_path, sizeof(temp_path), "%s.%d.tmp", cache_path, (int) getpid()) >= (int) sizeof(temp_path)) goto defer;
+    FILE *file = fopen(temp_path, "wb");
+    if (file == NULL) goto defer;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+           && fwrite(table, sizeof(*table), table_size, file) == table_size
+           && fwrite(items, sizeof(*items), entries->count, file) == entries->count
+           && fwrite(sections, sizeof(*sections), section_count, file) == section_count;
+    for (size_t i=0; ok && i<entries->count; ++i){
+        ConpEntry *entry = &entries->items[i];
+        ok = fwrite(conp_span_ptr(entries, entry, entry->key), 1, entry->key.len, file) == entry->key.len
+          && fwrite(conp_span_ptr(entries, entry, entry->value), 1, entry->value.len, file) == entry->value.len;
+    }
+    for (size_t i=1; ok && i<section_count; ++i){
+        ok = fwrite(entries->sections[i].name, 1, entries->sections[i].name_len, file) == entries->sections[i].name_len;
+    }
+    if (fclose(file) != 0) ok = false;
+    if (ok && rename(temp_path, cache_path) == 0) result = true;
+    else remove(temp_path);
+  defer:
+    free(table);
+    free(items);
+    free(sections);
+    return result;
+}
+
+bool conp_cache_open(ConpCache *cache, char *cache_path, char *source, size_t source_size, int64_t source_mtime)
+{
+    if (cache == NULL || cache_path == NULL || source == NULL) return false;
+    *cache = (ConpCache) {0};
+    int fd = open(cache_path, O_RDONLY);
+    if (fd == -1) return false;
+    struct stat file;
+    if (fstat(fd, &file) == -1 || (size_t) file.st_size < sizeof(ConpCacheHeader)){
+        close(fd);
+        return false;
+    }
+    char *data = mmap(NULL, file.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    ConpCacheHeader *header = (ConpCacheHeader*) data;
+    size_t expected = sizeof(*header) + (size_t) header->table_size*sizeof(uint32_t) + (size_t) header->count*sizeof(ConpCacheEntry) + (size_t) header->section_count*sizeof(ConpSpan) + header->pool_size;
+    // the cheap checks come first, the content is only hashed if everything else matches
+    if (memcmp(header->magic, CONP_CACHE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != CONP_CACHE_VERSION
+        || expected != (size_t) file.st_size
+        || header->table_size == 0 || (header->table_size & (header->table_size-1)) != 0
+        || header->section_count == 0
+        || header->source_size != source_size
+        || header->source_mtime != source_mtime
+        || header->source_hash != conp__hash_content(source, source_size)){
+        munmap(data, file.st_size);
+        return false;
+    }
+    cache->data = data;
+    cache->size = file.st_size;
+    cache->header = header;
+    cache->table = (uint32_t*) (data + sizeof(*header));
+    cache->entries = (ConpCacheEntry*) (cache->table + header->table_size);
+    cache->sections = (ConpSpan*) (cache->entries + header->count);
+    cache->pool = (char*) (cache->sections + header->section_count);
+    return true;
+}
+
+bool conp_cache_get(ConpCache *cache, char *key, ConpToken *token)
+{
+    return conp_cache_section_get(cache, NULL, key, token);
+}
+
+bool conp_cache_section_get(ConpCache *cache, char *section, char *key, ConpToken *token)
+{
+    if (cache == NULL || cache->header == NULL || key == NULL || token == NULL) return false;
+    size_t id;
+    if (!conp__cache_section_id(cache, section, &id)) return false;
+    ConpCacheEntry *entry = conp__cache_find(cache, id, key, strlen(key), false);
+    if (entry == NULL || !conp__cache_token(cache, entry->value, token)) return false;
+    token->type = entry->type;
+    token->escaped = entry->escaped;
+    return true;
+}
+
+bool conp_cache_section_resolve(ConpCache *cache, char *section, char *alias_section, char *name, ConpToken *token)
+{
+    if (cache == NULL || cache->header == NULL || name == NULL || token == NULL) return false;
+    size_t id;
+    if (!conp__cache_section_id(cache, section, &id)) return false;
+    ConpCacheEntry *entry = conp__cache_find(cache, id, name, strlen(name), true);
+    size_t alias_id;
+    if (entry == NULL && alias_section != NULL && conp__cache_section_id(cache, alias_section, &alias_id)){
+        // the keys take precedence, an alias is only resolved to a key and never to another alias
+        ConpCacheEntry *alias = conp__cache_find(cache, alias_id, name, strlen(name), true);
+        ConpToken target;
+        char buffer[256];
+        if (alias != NULL && (alias->type == ConpToken_String || alias->type == ConpToken_Field) && conp__cache_token(cache, alias->value, &target)){
+            target.type = alias->type;
+            target.escaped = alias->escaped;
+            char *allocated;
+            ConpView view = conp__view_alloc(&target, buffer, sizeof(buffer), &allocated);
+            if (view.data != NULL) entry = conp__cache_find(cache, id, view.data, view.len, true);
+            free(allocated);
+        }
+    }
+    if (entry == NULL || !conp__cache_token(cache, entry->value, token)) return false;
+    token->type = entry->type;
+    token->escaped = entry->escaped;
+    return true;
+}
+
+ConpToken conp_cache_key(ConpCache *cache, size_t i)
+{
+    ConpToken token = {0};
+    if (cache == NULL || cache->header == NULL || i >= cache->header->count) return token;
+    conp__cache_token(cache, cache->entries[i].key, &token);
+    return token;
+}
+
+ConpToken conp_cache_value(ConpCache *cache, size_t i)
+{
+    ConpToken token = {0};
+    if (cache == NULL || cache->header == NULL || i >= cache->header->count) return token;
+    if (!conp__cache_token(cache, cache->entries[i].value, &token)) return token;
+    token.type = cache->entries[i].type;
+    token.escaped = cache->entries[i].escaped;
+    return token;
+}
+
+ConpToken conp_cache_section(ConpCache *cache, size_t i)
+{
+    ConpToken token = {0};
+    if (cache == NULL || cache->header == NULL || i >= cache->header->count) return token;
+    uint16_t section = cache->entries[i].section;
+    if (section == 0 || section >= cache->header->section_count) return token;
+    conp__cache_token(cache, cache->sections[section], &token);
+    return token;
+}
+
+void conp_cache_close(ConpCache *cache)
+{
+    if (cache == NULL || cache->data == NULL) return;
+    munmap(cache->data, cache->size);
+    *cache = (ConpCache) {0};
+}
+#endif // CONP_WITH_CACHE
+
+ConpStream conp_stream_init(char *stream_name)
+{
+    ConpStream stream = {0};
+    stream.lexer = conp_init(NULL, 0, stream_name);
+    stream.lexer.partial = true;
+    return stream;
+}
+
+void conp_stream_feed(ConpStream *stream, char *chunk, size_t chunk_size)
+{
+    if (stream == NULL || chunk == NULL) return;
+    ConpLexer *lexer = &stream->lexer;
+    // drop the input of all complete entries, only the current entry has to be kept
+    size_t drop = stream->entry;
+    if (drop > 0){
+        lexer->origin = conp_lexer_loc(lexer, lexer->buffer+drop);
+        memmove(lexer->buffer, lexer->buffer+drop, lexer->buffer_size-drop);
+        lexer->buffer_size -= drop;
+        lexer->index -= drop;
+        lexer->pending_start -= drop;
+        stream->key.offset -= drop;
+        stream->entry = 0;
+    }
+    if (lexer->buffer_size+chunk_size > stream->capacity){
+        size_t capacity = (stream->capacity == 0)? 4096:stream->capacity;
+        while (capacity < lexer->buffer_size+chunk_size) capacity *= 2;
+        lexer->buffer = realloc(lexer->buffer, capacity);
+        assert(lexer->buffer != NULL && "Need more RAM!");
+        stream->capacity = capacity;
+    }
+    memcpy(lexer->buffer+lexer->buffer_size, chunk, chunk_size);
+    lexer->buffer_size += chunk_size;
+}
+
+void conp_stream_finish(ConpStream *stream)
+{
+    if (stream == NULL) return;
+    stream->lexer.partial = false;
+}
+
+bool conp_stream_next(ConpStream *stream, ConpToken *key, ConpToken *value)
+{
+    if (stream == NULL || key == NULL || value == NULL || stream->failed) return false;
+    ConpLexer *lexer = &stream->lexer;
+    ConpToken token;
+    // each step may pause the lexer, in which case the entry is continued with the next call
+    switch (stream->state){
+        case 0:{
+            if (!conp_next(lexer, &token)){
+                stream->failed = !lexer->paused && token.type != ConpToken_End;
+                return false;
+            }
+            if (token.type == ConpToken_Section){
+                // a header is returned on its own, with the name as key and a value of type Section
+                *value = token;
+                *key = token;
+                key->type = ConpToken_Field;
+                stream->entry = lexer->index;
+                return true;
+            }
+            stream->key = (ConpSpan) {.offset=token.start-lexer->buffer, .len=token.len};
+            stream->state++;
+        } // fall through
+        case 1:{
+            if (!conp_expect(lexer, &token, ConpToken_Sep)){
+                stream->failed = !lexer->paused;
+                return false;
+            }
+            stream->state++;
+        } // fall through
+        default:{
+            if (!conp_expect(lexer, value, CONP_VALUES)){
+                stream->failed = !lexer->paused;
+                return false;
+            }
+            stream->state = 0;
+        }
+    }
+    char *key_start = lexer->buffer+stream->key.offset;
+    conp__set_token(key, ConpToken_Field, key_start, key_start+stream->key.len);
+    stream->entry = lexer->index;
+    return true;
+}
+
+void conp_stream_free(ConpStream *stream)
+{
+    if (stream == NULL) return;
+    free(stream->lexer.buffer);
+    *stream = (ConpStream) {0};
+}
+
+#ifdef CONP_WITH_THREADS
+ConpSnapshot* conp_snapshot_parse(char *buffer, size_t buffer_size, char *buffer_name, void (*release)(char *buffer, size_t buffer_size))
+{
+    if (buffer == NULL) return NULL;
+    ConpSnapshot *snapshot = calloc(1, sizeof(*snapshot));
+    assert(snapshot != NULL && "Need more RAM!");
+    snapshot->entries.arena = &snapshot->arena;
+    if (!conp_parse_all_parallel(&snapshot->entries, buffer, buffer_size, buffer_name, 0) || snapshot->entries.sources[0].failed){
+        conp_entries_free(&snapshot->entries);
+        conp_arena_free(&snapshot->arena);
+        free(snapshot);
+        return NULL;
+    }
+    snapshot->buffer = buffer;
+    snapshot->buffer_size = buffer_size;
+    snapshot->release = release;
+    return snapshot;
+}
+
+void conp_snapshot_free(ConpSnapshot *snapshot)
+{
+    if (snapshot == NULL) return;
+    conp_entries_free(&snapshot->entries);
+    conp_arena_free(&snapshot->arena);
+    if (snapshot->release != NULL) snapshot->release(snapshot->buffer, snapshot->buffer_size);
+    free(snapshot);
+}
+
+void conp_shared_init(ConpShared *shared)
+{
+    if (shared == NULL) return;
+    *shared = (ConpShared) {.epoch=1};
+    pthread_mutex_init(&shared->writer, NULL);
+}
+
+ConpReader* conp_shared_join(ConpShared *shared)
+{
+    if (shared == NULL) return NULL;
+    for (size_t i=0; i<CONP_SHARED_READERS; ++i){
+        bool used = false;
+        if (__atomic_compare_exchange_n(&shared->readers[i].used, &used, true, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) return &shared->readers[i];
+    }
+    return NULL;
+}
+
+void conp_shared_part(ConpShared *shared, ConpReader *reader)
+{
+    (void) shared;
+    if (reader == NULL) return;
+    __atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&reader->used, false, __ATOMIC_RELEASE);
+}
+
+ConpSnapshot* conp_shared_enter(ConpShared *shared, ConpReader *reader)
+{
+    // the epoch is announced before the snapshot is loaded, so the writer cannot miss the reader
+    __atomic_store_n(&reader->epoch, __atomic_load_n(&shared->epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&shared->current, __ATOMIC_SEQ_CST);
+}
+
+void conp_shared_leave(ConpShared *shared, ConpReader *reader)
+{
+    (void) shared;
+    __atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+}
+
+bool conp_shared_get(ConpShared *shared, ConpReader *reader, char *section, char *key, char *buffer, size_t buffer_size)
+{
+    if (shared == NULL || reader == NULL) return false;
+    ConpSnapshot *snapshot = conp_shared_enter(shared, reader);
+    ConpToken token;
+    bool result = snapshot != NULL && conp_section_get(&snapshot->entries, section, key, &token) && conp_extract(&token, buffer, buffer_size);
+    conp_shared_leave(shared, reader);
+    return result;
+}
+
+void conp_shared_publish(ConpShared *shared, ConpSnapshot *snapshot)
+{
+    if (shared == NULL) return;
+    pthread_mutex_lock(&shared->writer);
+    ConpSnapshot *old = __atomic_exchange_n(&shared->current, snapshot, __ATOMIC_SEQ_CST);
+    if (old != NULL){
+        // readers that entered in this epoch or before might still use the old snapshot
+        old->retired = __atomic_fetch_add(&shared->epoch, 1, __ATOMIC_SEQ_CST);
+        old->next = shared->retired;
+        shared->retired = old;
+    }
+    conp__shared_reclaim(shared);
+    pthread_mutex_unlock(&shared->writer);
+}
+
+size_t conp_shared_reclaim(ConpShared *shared)
+{
+    if (shared == NULL) return 0;
+    pthread_mutex_lock(&shared->writer);
+    size_t result = conp__shared_reclaim(shared);
+    pthread_mutex_unlock(&shared->writer);
+    return result;
+}
+
+void conp_shared_free(ConpShared *shared)
+{
+    if (shared == NULL) return;
+    conp_snapshot_free(shared->current);
+    while (shared->retired != NULL){
+        ConpSnapshot *next = shared->retired->next;
+        conp_snapshot_free(shared->retired);
+        shared->retired = next;
+    }
+    pthread_mutex_destroy(&shared->writer);
+    *shared = (ConpShared) {0};
+}
+#endif // CONP_WITH_THREADS
+
+#if defined(CONP_WITH_WATCH) && defined(__linux__)
+bool conp_watch_open(ConpWatch *watch, ConpEntries *entries, char *path)
+{
+    if (watch == NULL || entries == NULL || path == NULL) return false;
+    *watch = (ConpWatch) {.fd=-1, .wd=-1, .path=path, .entries=entries};
+    char *slash = strrchr(path, '/');
+    watch->name = (slash != NULL)? slash+1:path;
+    watch->buffer = conp__read_file(path, &watch->buffer_size);
+    if (watch->buffer == NULL){
+        fprintf(stderr, "[ERROR] Could not read '%s'!\n", path);
+        return false;
+    }
+    // the directory is watched, editors often replace a file instead of writing to it
+    char dir[FILENAME_MAX];
+    if (slash == NULL) snprintf(dir, sizeof(dir), ".");
+    else if (slash == path) snprintf(dir, sizeof(dir), "/");
+    else snprintf(dir, sizeof(dir), "%.*s", (int) (slash-path), path);
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->fd != -1) watch->wd = inotify_add_watch(watch->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watch->wd == -1){
+        fprintf(stderr, "[ERROR] Could not watch '%s': %s!\n", path, strerror(errno));
+        conp_watch_close(watch);
+        return false;
+    }
+    watch->source = entries->source_count;
+    (void) conp_parse_all(entries, watch->buffer, watch->buffer_size, path);
+    if (watch->source >= entries->source_count){
+        // the file was not added as a source at all
+        conp_watch_close(watch);
+        return false;
+    }
+    return true;
+}
+
+int conp_watch_poll(ConpWatch *watch, int timeout)
+{
+    if (watch == NULL || watch->fd == -1) return -1;
+    struct pollfd pfd = {.fd=watch->fd, .events=POLLIN};
+    int ready = poll(&pfd, 1, timeout);
+    if (ready <= 0) return (ready == 0 || errno == EINTR)? 0:-1;
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    ssize_t len;
+    while ((len = read(watch->fd, events, sizeof(events))) > 0){
+        struct inotify_event *event;
+        for (char *p=events; p<events+len; p+=sizeof(*event)+event->len){
+            event = (struct inotify_event*) p;
+            if (event->len > 0 && strcmp(event->name, watch->name) == 0) changed = true;
+        }
+    }
+    if (!changed) return 0;
+    size_t buffer_size;
+    char *buffer = conp__read_file(watch->path, &buffer_size);
+    if (buffer == NULL) return -1;
+    (void) conp_entries_reload(watch->entries, watch->source, buffer, buffer_size);
+    if (watch->entries->sources[watch->source].buffer != buffer){
+        // the source still uses the old buffer
+        free(buffer);
+        return -1;
+    }
+    free(watch->buffer);
+    watch->buffer = buffer;
+    watch->buffer_size = buffer_size;
+    return 1;
+}
+
+void conp_watch_close(ConpWatch *watch)
+{
+    if (watch == NULL) return;
+    if (watch->fd != -1) close(watch->fd);
+    free(watch->buffer);
+    *watch = (ConpWatch) {.fd=-1, .wd=-1};
+}
+#endif
+
+ConpLexer conp_init(char *buffer, size_t buffer_size, char *buffer_name)
+{
+    return (ConpLexer) {.buffer=buffer, .buffer_size=buffer_size, .index=0, .origin=(ConpLoc){.filename=buffer_name, .row=1, .column=1}};
+}
+
+bool conp_next(ConpLexer *lexer, ConpToken *token)
+{
+    if (lexer == NULL || token == NULL) return false;
+    char *start;
+    ConpTokenType type;
+    bool resume = lexer->paused && lexer->pending != ConpToken_End;
+    lexer->paused = false;
+    if (resume){
+        // continue with the token that ran into the end of the previous input
+        start = lexer->buffer + lexer->pending_start;
+        type = lexer->pending;
+    }
+    else{
+        conp__trim_left(lexer);
+        start = conp_get_pointer(lexer);
+        type = ConpToken_Field;
+        if (lexer->index < lexer->buffer_size){
+            switch (conp_get_char(lexer)){
+                case '=':  type = ConpToken_Sep; break;
+                case '[':  type = ConpToken_Section; break;
+                case '"':  type = ConpToken_String; lexer->escaped = false; conp_inc(lexer); break;
+                case '\0': type = ConpToken_End; break;
+            }
+        }
+        // the buffer does not need to be null-terminated, never read past buffer_size
+        else type = ConpToken_End;
+    }
+    switch (type){
+        case ConpToken_Sep:{
+            conp__set_token(token, ConpToken_Sep, start, start+1);
+        } break;
+        case ConpToken_String:{
+            // lex strings
+            char *s_start = start+1;
+            if (!conp__find_string_end(lexer)){
+                if (lexer->partial) return conp__pause(lexer, ConpToken_String, start);
+                conp__set_token(token, ConpToken_String, s_start, conp_get_pointer(lexer));
+                conp__report(lexer, start, "Missing closing delimeter for '\"'!");
+                return false;
+            }
+            char *s_end = conp_get_pointer(lexer);
+            conp__set_token(token, ConpToken_String, s_start, s_end);
+            token->escaped = lexer->escaped;
+            break;
+        }
+        case ConpToken_Section:{
+            // the name of a section ends at the closing bracket on the same line
+            char *name = start+1;
+            char *end = lexer->buffer + lexer->buffer_size;
+            char *p = name;
+            while (p < end && *p != ']' && *p != '\n') p++;
+            lexer->index = p-lexer->buffer;
+            conp__set_token(token, ConpToken_Section, name, p);
+            if (p >= end && lexer->partial) return conp__pause(lexer, ConpToken_Section, start);
+            if (p >= end || *p != ']'){
+                conp__report(lexer, start, "Missing closing delimeter for '['!");
+                return false;
+            }
+            break;
+        }
+        case ConpToken_End:{
+            conp__set_token(token, ConpToken_End, start, start);
+            if (lexer->index >= lexer->buffer_size){
+                if (lexer->partial) return conp__pause(lexer, ConpToken_End, start);
+                return false;
+            }
+            conp_inc(lexer);
+            return false;
+        }
+        default:{
+            // multi-character literal, it is classified in the same pass that finds its end
+            uint8_t state = resume? lexer->literal:CONP__LIT_START;
+            while (lexer->index < lexer->buffer_size){
+                uint8_t class = conp__char_classes[(unsigned char) conp_get_char(lexer)];
+                if (class == CONP__CHAR_DELIM) break;
+                state = conp__literal_dfa[state][class];
+                lexer->index++;
+                if (state == CONP__LIT_FIELD){
+                    // nothing but a field can come of it anymore, let the kernel find the end
+                    conp__find_delimeter(lexer);
+                    break;
+                }
+            }
+            if (lexer->index >= lexer->buffer_size && lexer->partial){
+                lexer->literal = state;
+                return conp__pause(lexer, ConpToken_Field, start);
+            }
+            conp__set_token(token, conp__literal_types[state], start, conp_get_pointer(lexer));
+            return true;
+        }
+    }
+    conp_inc(lexer);
+    return true;
+}
+
+bool conp__pause(ConpLexer *lexer, ConpTokenType type, char *start)
+{
+    lexer->paused = true;
+    lexer->pending = type;
+    lexer->pending_start = start-lexer->buffer;
+    return false;
+}
+
+bool conp__expect(ConpLexer *lexer, ConpToken *token, ConpTokenType types[], size_t count)
+{
+    if (lexer == NULL || token == NULL) return false;
+    // the lexer either paused or already reported the error itself
+    if (!conp_next(lexer, token) && (lexer->paused || token->type != ConpToken_End)) return false;
+    for (size_t i=0; i<count; ++i){
+        if (token->type == types[i]) return true;
+    }
+    char expected[128];
+    size_t len = 0;
+    for (size_t i=0; i<count && len < sizeof(expected); ++i){
+        len += snprintf(expected+len, sizeof(expected)-len, (i == 0)? "%s":", %s", ConpTokenTypeNames[types[i]]);
+    }
+    conp__report(lexer, token->start, "Expected token of type [%s], but got %s!", expected, ConpTokenTypeNames[token->type]);
+    return false;
+}
+
+void conp__report(ConpLexer *lexer, char *p, const char *fmt, ...)
+{
+    lexer->error_count++;
+    if (lexer->quiet) return;
+    char message[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(message, sizeof(message), fmt, args);
+    va_end(args);
+    if (lexer->diagnostics == NULL){
+        fprintf(stderr, "[ERROR] "CONP_LOC_FMT" %s\n", conp_loc_expand(conp_lexer_loc(lexer, p)), message);
+        return;
+    }
+    // the location is resolved later, counting the lines for every error would be quadratic
+    ConpDiagnostics *diagnostics = lexer->diagnostics;
+    if (diagnostics->count >= diagnostics->capacity){
+        diagnostics->capacity = (diagnostics->capacity == 0)? 16:diagnostics->capacity*2;
+        diagnostics->items = realloc(diagnostics->items, diagnostics->capacity*sizeof(*diagnostics->items));
+        assert(diagnostics->items != NULL && "Need more RAM!");
+    }
+    char *copy = malloc(strlen(message)+1);
+    assert(copy != NULL && "Need more RAM!");
+    strcpy(copy, message);
+    diagnostics->items[diagnostics->count++] = (ConpDiagnostic) {.offset=p-lexer->buffer, .loc=lexer->origin, .message=copy};
+}
+
+void conp__diagnostics_locate(ConpDiagnostics *diagnostics, ConpLexer *lexer)
+{
+    ConpLoc loc = lexer->origin;
+    size_t offset = 0;
+    for (size_t i=0; i<diagnostics->count; ++i){
+        ConpDiagnostic *diagnostic = &diagnostics->items[i];
+        if (diagnostic->offset < offset){
+            loc = lexer->origin;
+            offset = 0;
+        }
+        char *line = lexer->buffer+offset;
+        char *p = lexer->buffer+diagnostic->offset;
+        char *nl;
+        while ((nl = memchr(line, '\n', p-line)) != NULL){
+            loc.row++;
+            loc.column = 1;
+            line = nl+1;
+        }
+        loc.column += p-line;
+        offset = diagnostic->offset;
+        diagnostic->loc = loc;
+    }
+}
+
+bool conp_extract(ConpToken *token, char *buffer, size_t buffer_size)
+{
+    if (token == NULL || buffer == NULL || buffer_size == 0) return false;
+    size_t t_len = token->end-token->start;
+    if (t_len >= buffer_size) return false;
+    if (token->type == ConpToken_String && token->escaped){
+        // escape sequences never grow the content, so it is unescaped straight into the buffer
+        char *r = token->start;
+        char *w = buffer;
+        while (r != token->end){
+            if (*r == '\\' && r+1 != token->end){
+                switch(*++r){
+                    case '\'': *w = 0x27; break;
+					case '"':  *w = 0x22; break;
+					case '?':  *w = 0x3f; break;
+					case '\\': *w = 0x5c; break;
+					case 'a':  *w = 0x07; break;
+					case 'b':  *w = 0x08; break;
+					case 'f':  *w = 0x0c; break;
+					case 'n':  *w = 0x0a; break;
+					case 'r':  *w = 0x0d; break;
+					case 't':  *w = 0x09; break;
+					case 'v':  *w = 0x0b; break;
+                    default:{
+                        *w++ = '\\';
+                        *w = *r;
+                    }
+                }
+            }
+            else{
+                *w = *r;
+            }
+            r++;
+            w++;
+        }
+        *w = '\0';
+    }
+    else{
+        memcpy(buffer, token->start, t_len);
+        buffer[t_len] = '\0';
+    }
+    return true;
+}
+
+ConpView conp_view(ConpToken *token, char *buffer, size_t buffer_size)
+{
+    if (token == NULL) return (ConpView) {0};
+    if (!token->escaped) return (ConpView) {.data=token->start, .len=token->len};
+    if (!conp_extract(token, buffer, buffer_size)) return (ConpView) {0};
+    return (ConpView) {.data=buffer, .len=strlen(buffer)};
+}
+
+ConpView conp__view_alloc(ConpToken *token, char *buffer, size_t buffer_size, char **allocated)
+{
+    // the unescaped content is never longer than the token, so that much is allocated for long tokens
+    *allocated = NULL;
+    if (token != NULL && token->escaped && token->len >= buffer_size){
+        *allocated = malloc(token->len+1);
+        assert(*allocated != NULL && "Need more RAM!");
+        return conp_view(token, *allocated, token->len+1);
+    }
+    return conp_view(token, buffer, buffer_size);
+}
+
+void conp_print_token(ConpToken token)
+{
+    switch (token.type){
+        case ConpToken_End:
+        case ConpToken_Sep:{
+            printf("%s", ConpTokenTypeNames[token.type]);
+        } break;
+        default:{
+            printf("%s: '%.*s'", ConpTokenTypeNames[token.type], (int) token.len, token.start);
+        }
+    }
+}
+
+void conp_print(ConpLexer *lexer, ConpToken token)
+{
+    printf(CONP_LOC_FMT": ", conp_loc_expand(conp_lexer_loc(lexer, token.start)));
+    conp_print_token(token);
+    putchar('\n');
+}
+
+void conp__set_token(ConpToken *token, ConpTokenType type, char *start, char *end)
+{
+    if (token == NULL) return;
+    token->type = type;
+    token->start = start;
+    token->end = end;
+    token->len = end-start;
+    token->escaped = false;
+}
+
+ConpLoc conp_lexer_loc(ConpLexer *lexer, char *p)
+{
+    // only needed for diagnostics, so count the lines instead of tracking them while lexing
+    ConpLoc loc = lexer->origin;
+    char *line = lexer->buffer;
+    char *nl;
+    while ((nl = memchr(line, '\n', p-line)) != NULL){
+        loc.row++;
+        loc.column = 1;
+        line = nl+1;
+    }
+    loc.column += p-line;
+    return loc;
+}
+
+/*
+    Scanning kernels: each one advances the lexer to the first character that
+    stops the scan. The vector loop handles whole blocks of CONP__VEC_WIDTH
+    characters, the remaining tail is handled by the scalar loop.
+*/
+#if defined(__AVX2__)
+#define CONP__VEC_WIDTH 32
+typedef __m256i conp__vec;
+#define conp__vec_load(p) _mm256_loadu_si256((const __m256i*) (p))
+#define conp__vec_eq(v, c) ((uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8((v), _mm256_set1_epi8(c))))
+#elif defined(__SSE2__)
+#define CONP__VEC_WIDTH 16
+typedef __m128i conp__vec;
+#define conp__vec_load(p) _mm_loadu_si128((const __m128i*) (p))
+#define conp__vec_eq(v, c) ((uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8((v), _mm_set1_epi8(c))))
+#endif
+
+#ifdef CONP__VEC_WIDTH
+#define CONP__VEC_ALL ((uint32_t) ((1ULL << CONP__VEC_WIDTH)-1))
+#endif
+
+bool conp__find_string_end(ConpLexer *lexer)
+{
+    // stop at the first quote, a backslash does not escape it, so a string may end in a backslash (e.g. a Windows path)
+    while (true){
+#ifdef CONP__VEC_WIDTH
+        while (lexer->index + CONP__VEC_WIDTH <= lexer->buffer_size){
+            conp__vec v = conp__vec_load(conp_get_pointer(lexer));
+            uint32_t found = conp__vec_eq(v, '"') | conp__vec_eq(v, '\\');
+            if (found != 0){
+                lexer->index += __builtin_ctz(found);
+                break;
+            }
+            lexer->index += CONP__VEC_WIDTH;
+        }
+#endif
+        while (lexer->index < lexer->buffer_size && conp_get_char(lexer) != '"' && conp_get_char(lexer) != '\\'){
+            lexer->index++;
+        }
+        if (lexer->index >= lexer->buffer_size) return false;
+        if (conp_get_char(lexer) == '"') return true;
+        lexer->escaped = true;
+        lexer->index++;
+    }
+}
+
+void conp__find_delimeter(ConpLexer *lexer)
+{
+#ifdef CONP__VEC_WIDTH
+    while (lexer->index + CONP__VEC_WIDTH <= lexer->buffer_size){
+        conp__vec v = conp__vec_load(conp_get_pointer(lexer));
+        uint32_t found = conp__vec_eq(v, '=') | conp__vec_eq(v, ' ') | conp__vec_eq(v, '\n') | conp__vec_eq(v, '\t');
+        if (found != 0){
+            lexer->index += __builtin_ctz(found);
+            return;
+        }
+        lexer->index += CONP__VEC_WIDTH;
+    }
+#endif
+    while (lexer->index < lexer->buffer_size && !conp__is_delimeter(conp_get_char(lexer))){
+        lexer->index++;
+    }
+}
+
+void conp__trim_left(ConpLexer *lexer)
+{
+#ifdef CONP__VEC_WIDTH
+    while (lexer->index + CONP__VEC_WIDTH <= lexer->buffer_size){
+        conp__vec v = conp__vec_load(conp_get_pointer(lexer));
+        uint32_t found = ~(conp__vec_eq(v, ' ') | conp__vec_eq(v, '\t') | conp__vec_eq(v, '\n')) & CONP__VEC_ALL;
+        if (found != 0){
+            lexer->index += __builtin_ctz(found);
+            return;
+        }
+        lexer->index += CONP__VEC_WIDTH;
+    }
+#endif
+    char c;
+    while (lexer->index < lexer->buffer_size && conp_is_whitespace((c = conp_get_char(lexer)))){
+        lexer->index++;
+    }
+}
+
+bool conp__is_delimeter(char c)
+{
+    switch (c){
+        case '=':
+        case ' ':
+        case '\n':
+        case '\t':{
+            return true;
+        }
+        default: return false;
+    }
+}
+
+uint64_t conp__hash(const char *s, size_t len)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i=0; i<len; ++i){
+        hash ^= (unsigned char) s[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+#ifdef CONP_WITH_CACHE
+uint64_t conp__hash_content(const char *s, size_t len)
+{
+    // hashes whole files a word at a time, conp__hash is meant for short keys
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ len;
+    uint64_t word;
+    size_t i;
+    for (i=0; i+8<=len; i+=8){
+        memcpy(&word, s+i, 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 32;
+    }
+    word = 0;
+    memcpy(&word, s+i, len-i);
+    hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+    return hash ^ (hash >> 29);
+}
+#endif // CONP_WITH_CACHE
+
+uint64_t conp__hash_folded(const char *s, size_t len)
+{
+    // FNV-1a over the lowercase bytes
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i=0; i<len; ++i){
+        hash ^= (unsigned char) conp__fold(s[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash ^ (hash >> 32);
+}
+
+bool conp__equal_folded(const char *a, const char *b, size_t len)
+{
+    for (size_t i=0; i<len; ++i){
+        if (conp__fold(a[i]) != conp__fold(b[i])) return false;
+    }
+    return true;
+}
+
+uint8_t conp__entry_number(ConpEntries *entries, ConpEntry *entry, uint64_t *number)
+{
+    // readers of a shared snapshot may race to parse the same entry, they store the same bits,
+    // the state is published last, so whoever sees it set also sees the number
+    uint8_t state = __atomic_load_n(&entry->number_state, __ATOMIC_ACQUIRE);
+    if (state != CONP__NUMBER_UNPARSED){
+        *number = __atomic_load_n(&entry->number, __ATOMIC_RELAXED);
+        return state;
+    }
+    char *start = conp_span_ptr(entries, entry, entry->value);
+    if (entry->type == ConpToken_Int){
+        int64_t value;
+        state = conp__parse_int(start, entry->value.len, &value)? CONP__NUMBER_OK:CONP__NUMBER_RANGE;
+        *number = (uint64_t) value;
+    }
+    else{
+        bool overflow;
+        double value = conp__parse_double(start, entry->value.len, &overflow);
+        state = overflow? CONP__NUMBER_RANGE:CONP__NUMBER_OK;
+        memcpy(number, &value, sizeof(*number));
+    }
+    __atomic_store_n(&entry->number, *number, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->number_state, state, __ATOMIC_RELEASE);
+    return state;
+}
+
+bool conp__parse_int(const char *s, size_t len, int64_t *value)
+{
+    // s is an Int token, so it consists of an optional sign and at least one digit
+    size_t i = 0;
+    bool negative = s[0] == '-';
+    if (s[0] == '-' || s[0] == '+') i++;
+    uint64_t n = 0;
+    uint64_t limit = negative? (uint64_t) INT64_MAX+1:(uint64_t) INT64_MAX;
+    for (; i<len; ++i){
+        if (__builtin_mul_overflow(n, 10, &n) || __builtin_add_overflow(n, (uint64_t) (s[i]-'0'), &n) || n > limit){
+            *value = negative? INT64_MIN:INT64_MAX;
+            return false;
+        }
+    }
+    *value = negative? -(int64_t) (n-1)-1:(int64_t) n;
+    return true;
+}
+
+/*
+    Floats are converted like Clinger: if all significant digits fit into the
+    53 bits of a double and the power of ten is exact as well (at most 1e22),
+    a single rounded multiplication or division gives the correctly rounded
+    result. Any other number goes through an exact decimal that is shifted by
+    powers of two until the 53 bits of the mantissa can be read off it, which
+    is slow, but those numbers do not show up in configs in practice.
+*/
+double conp__parse_double(const char *s, size_t len, bool *overflow)
+{
+    // s is a Float or an Int token: [sign] digits [. digits] [e|E [sign] digits], the integer or fraction digits may be missing
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    static const int steps[] = {1, 3, 6, 9, 13, 16, 19, 23, 26}; // the largest shift by which 10^i stays below 2^shift
+    *overflow = false;
+    size_t i = 0;
+    bool negative = s[0] == '-';
+    if (s[0] == '-' || s[0] == '+') i++;
+    ConpDecimal decimal;
+    decimal.count = 0;
+    decimal.truncated = false;
+    int64_t point = 0;
+    uint64_t mantissa = 0;
+    int64_t exponent = 0; // the power of ten the mantissa is scaled by
+    size_t significant = 0;
+    bool fraction = false;
+    for (; i<len && s[i] != 'e' && s[i] != 'E'; ++i){
+        if (s[i] == '.'){
+            fraction = true;
+            continue;
+        }
+        uint8_t digit = s[i]-'0';
+        if (fraction) exponent--;
+        if (digit == 0 && significant == 0){
+            // leading zeros do not count, but those in the fraction move the point
+            if (fraction) point--;
+            continue;
+        }
+        if (significant < 19) mantissa = mantissa*10 + digit;
+        significant++;
+        if (!fraction) point++;
+        if (decimal.count < CONP__DECIMAL_DIGITS) decimal.digits[decimal.count++] = digit;
+        else if (digit != 0) decimal.truncated = true;
+    }
+    if (i < len){
+        bool exponent_negative = s[++i] == '-';
+        if (s[i] == '-' || s[i] == '+') i++;
+        int64_t e = 0;
+        // far beyond the range of a double, the remaining digits cannot change the result
+        for (; i<len; ++i) if (e < 100000) e = e*10 + (s[i]-'0');
+        exponent += exponent_negative? -e:e;
+        point += exponent_negative? -e:e;
+    }
+    double value;
+    if (significant == 0) value = 0.0;
+    else if (significant <= 19 && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22){
+        value = (exponent < 0)? (double) mantissa / powers[-exponent]:(double) mantissa * powers[exponent];
+    }
+    else{
+        while (decimal.count > 0 && decimal.digits[decimal.count-1] == 0) decimal.count--;
+        uint64_t bits;
+        int binary = 0;
+        if (point > 310) goto overflow;
+        if (point < -330){
+            value = 0.0;
+            goto done;
+        }
+        decimal.point = (int) point;
+        // scale into [0.5, 1) and count the powers of two
+        while (decimal.point > 0){
+            int n = (decimal.point >= (int) conp_arr_len(steps))? 27:steps[decimal.point];
+            conp__decimal_shift(&decimal, -n);
+            binary += n;
+        }
+        while (decimal.point < 0 || (decimal.point == 0 && decimal.digits[0] < 5)){
+            int n = (-decimal.point >= (int) conp_arr_len(steps))? 27:steps[-decimal.point];
+            conp__decimal_shift(&decimal, n);
+            binary -= n;
+        }
+        binary--;
+        // subnormals have the smallest exponent and fewer bits
+        if (binary < -1022){
+            conp__decimal_shift(&decimal, -(-1022-binary));
+            binary = -1022;
+        }
+        if (binary+1023 >= 0x7ff) goto overflow;
+        conp__decimal_shift(&decimal, 53);
+        uint64_t bits_mantissa = conp__decimal_round(&decimal);
+        if (bits_mantissa == (2ULL << 52)){
+            // rounded up to the next power of two
+            bits_mantissa >>= 1;
+            binary++;
+            if (binary+1023 >= 0x7ff) goto overflow;
+        }
+        if ((bits_mantissa & (1ULL << 52)) == 0) binary = -1023;
+        bits = (bits_mantissa & ((1ULL << 52)-1)) | ((uint64_t) (binary+1023) << 52);
+        memcpy(&value, &bits, sizeof(value));
+        goto done;
+      overflow:
+        *overflow = true;
+        value = HUGE_VAL;
+    }
+  done:
+    return negative? -value:value;
+}
+
+void conp__decimal_shift(ConpDecimal *decimal, int shift)
+{
+    // multiply by 2^shift, at most 60 bits at a time, so that the carries fit into 64 bits
+    while (shift > 0){
+        int n = (shift > 60)? 60:shift;
+        conp__decimal_left(decimal, n);
+        shift -= n;
+    }
+    while (shift < 0){
+        int n = (-shift > 60)? 60:-shift;
+        conp__decimal_right(decimal, n);
+        shift += n;
+    }
+}
+
+void conp__decimal_left(ConpDecimal *decimal, int shift)
+{
+    // the digits are written from the back, so the number of new digits does not have to be known in advance
+    uint8_t digits[CONP__DECIMAL_DIGITS+20];
+    size_t w = sizeof(digits);
+    uint64_t n = 0;
+    for (int r=decimal->count-1; r>=0; --r){
+        n += (uint64_t) decimal->digits[r] << shift;
+        digits[--w] = n%10;
+        n /= 10;
+    }
+    for (; n>0; n/=10) digits[--w] = n%10;
+    int count = sizeof(digits)-w;
+    decimal->point += count-decimal->count;
+    decimal->count = (count < CONP__DECIMAL_DIGITS)? count:CONP__DECIMAL_DIGITS;
+    for (int i=decimal->count; i<count; ++i){
+        if (digits[w+i] != 0) decimal->truncated = true;
+    }
+    memcpy(decimal->digits, digits+w, decimal->count);
+    while (decimal->count > 0 && decimal->digits[decimal->count-1] == 0) decimal->count--;
+}
+
+void conp__decimal_right(ConpDecimal *decimal, int shift)
+{
+    int r = 0;
+    int w = 0;
+    uint64_t n = 0;
+    // read digits until the first digit of the result is known
+    for (; (n >> shift) == 0; ++r){
+        if (r >= decimal->count){
+            if (n == 0){
+                decimal->count = 0;
+                return;
+            }
+            for (; (n >> shift) == 0; ++r) n *= 10;
+            break;
+        }
+        n = n*10 + decimal->digits[r];
+    }
+    decimal->point -= r-1;
+    uint64_t mask = (1ULL << shift)-1;
+    for (; r<decimal->count; ++r){
+        decimal->digits[w++] = n >> shift;
+        n = (n & mask)*10 + decimal->digits[r];
+    }
+    for (; n>0; n=(n & mask)*10){
+        uint8_t digit = n >> shift;
+        if (w < CONP__DECIMAL_DIGITS) decimal->digits[w++] = digit;
+        else if (digit != 0) decimal->truncated = true;
+    }
+    decimal->count = w;
+    while (decimal->count > 0 && decimal->digits[decimal->count-1] == 0) decimal->count--;
+}
+
+uint64_t conp__decimal_round(ConpDecimal *decimal)
+{
+    // the integer part rounded to nearest, ties to even
+    if (decimal->point > 20) return UINT64_MAX;
+    uint64_t n = 0;
+    int i;
+    for (i=0; i<decimal->point && i<decimal->count; ++i) n = n*10 + decimal->digits[i];
+    for (; i<decimal->point; ++i) n *= 10;
+    int at = decimal->point;
+    if (at >= 0 && at < decimal->count){
+        bool up = decimal->digits[at] >= 5;
+        if (decimal->digits[at] == 5 && at+1 == decimal->count && !decimal->truncated) up = at > 0 && decimal->digits[at-1] % 2 == 1;
+        if (up) n++;
+    }
+    return n;
+}
+
+void conp__names_build(ConpEntries *entries, size_t section)
+{
+    ConpSection *s = &entries->sections[section];
+    size_t count = s->count + ((s->aliases != 0)? entries->sections[s->aliases-1].count:0);
+    size_t capacity = 64;
+    while (capacity < 2*count) capacity *= 2;
+    // the index is rebuilt after every update, so it is reused as long as it is large enough
+    if (capacity > s->names_capacity){
+        free(s->names);
+        s->names = malloc(capacity*sizeof(*s->names));
+        assert(s->names != NULL && "Need more RAM!");
+        s->names_capacity = capacity;
+    }
+    capacity = s->names_capacity;
+    memset(s->names, 0, capacity*sizeof(*s->names));
+    size_t mask = capacity-1;
+    // the keys are inserted before the aliases and earlier entries before later ones, the first name wins
+    for (size_t pass=0; pass<2; ++pass){
+        for (size_t i=0; i<entries->count; ++i){
+            ConpEntry *entry = &entries->items[i];
+            size_t target = i+1;
+            if (pass == 0 && entry->section != section) continue;
+            if (pass == 1){
+                if (s->aliases == 0 || entry->section != s->aliases-1) continue;
+                // an alias stands for a key of the section, never for another alias, but it claims its name either way
+                char buffer[256];
+                ConpToken value = conp_entry_value(entries, entry);
+                char *allocated = NULL;
+                ConpView view = (value.type == ConpToken_String || value.type == ConpToken_Field)? conp__view_alloc(&value, buffer, sizeof(buffer), &allocated):(ConpView) {0};
+                ConpName *key = (view.data != NULL)? conp__names_slot(entries, section, view.data, view.len, true):NULL;
+                target = (key != NULL)? key->entry:0;
+                free(allocated);
+            }
+            char *name = conp_span_ptr(entries, entry, entry->key);
+            if (conp__names_slot(entries, section, name, entry->key.len, false) != NULL) continue;
+            size_t j;
+            for (j=conp__hash_folded(name, entry->key.len)&mask; s->names[j].name != 0; j=(j+1)&mask);
+            s->names[j] = (ConpName) {.name=i+1, .entry=target};
+        }
+    }
+}
+
+void conp__names_rebuild(ConpEntries *entries)
+{
+    // the name indexes hold entry indices as well, they are rebuilt after the entries moved
+    for (size_t i=0; i<entries->section_count; ++i){
+        if (entries->sections[i].names_capacity > 0) conp__names_build(entries, i);
+    }
+}
+
+ConpName* conp__names_slot(ConpEntries *entries, size_t section, const char *name, size_t name_len, bool keys_only)
+{
+    ConpSection *s = &entries->sections[section];
+    if (s->names_capacity == 0) return NULL;
+    size_t mask = s->names_capacity-1;
+    for (size_t i=conp__hash_folded(name, name_len)&mask; s->names[i].name != 0; i=(i+1)&mask){
+        if (keys_only && s->names[i].name != s->names[i].entry) continue;
+        ConpEntry *entry = &entries->items[s->names[i].name-1];
+        if (entry->key.len == name_len && conp__equal_folded(conp_span_ptr(entries, entry, entry->key), name, name_len)) return &s->names[i];
+    }
+    return NULL;
+}
+
+void conp__index_insert(ConpEntries *entries, size_t item)
+{
+    ConpEntry *entry = &entries->items[item];
+    ConpSection *section = &entries->sections[entry->section];
+    char *key = conp_span_ptr(entries, entry, entry->key);
+    size_t mask = section->index_capacity-1;
+    size_t i;
+    for (i=conp__hash(key, entry->key.len)&mask; section->index[i] != 0; i=(i+1)&mask){
+        ConpEntry *ientry = &entries->items[section->index[i]-1];
+        // the first entry with a given key wins, later duplicates are not indexed
+        if (entry->key.len == ientry->key.len && memcmp(key, conp_span_ptr(entries, ientry, ientry->key), entry->key.len) == 0){
+            if (section->index[i]-1 > item) section->index[i] = item+1;
+            return;
+        }
+    }
+    section->index[i] = item+1;
+}
+
+void conp__index_grow(ConpEntries *entries, size_t section)
+{
+    ConpSection *s = &entries->sections[section];
+    size_t capacity = (s->index_capacity == 0)? 64:s->index_capacity;
+    while (capacity < 2*s->count) capacity *= 2;
+    free(s->index);
+    s->index = calloc(capacity, sizeof(*s->index));
+    assert(s->index != NULL && "Need more RAM!");
+    s->index_capacity = capacity;
+    for (size_t i=0; i<entries->count; ++i){
+        if (entries->items[i].section == section) conp__index_insert(entries, i);
+    }
+}
+
+void conp__index_rebuild(ConpEntries *entries)
+{
+    // size every index for the count of its section, then insert all entries in a single pass
+    for (size_t i=0; i<entries->section_count; ++i){
+        ConpSection *s = &entries->sections[i];
+        size_t capacity = (s->index_capacity == 0)? 64:s->index_capacity;
+        while (capacity < 2*s->count) capacity *= 2;
+        if (capacity != s->index_capacity){
+            free(s->index);
+            s->index = malloc(capacity*sizeof(*s->index));
+            assert(s->index != NULL && "Need more RAM!");
+            s->index_capacity = capacity;
+        }
+        memset(s->index, 0, capacity*sizeof(*s->index));
+    }
+    for (size_t i=0; i<entries->count; ++i){
+        conp__index_insert(entries, i);
+    }
+}
+
+uint32_t* conp__index_slot(ConpEntries *entries, size_t section, const char *key, size_t key_len)
+{
+    // the slot that holds the entry with the given key, NULL if the key is not indexed
+    ConpSection *s = &entries->sections[section];
+    if (s->index_capacity == 0) return NULL;
+    size_t mask = s->index_capacity-1;
+    for (size_t i=conp__hash(key, key_len)&mask; s->index[i] != 0; i=(i+1)&mask){
+        ConpEntry *entry = &entries->items[s->index[i]-1];
+        if (key_len == entry->key.len && memcmp(conp_span_ptr(entries, entry, entry->key), key, key_len) == 0) return &s->index[i];
+    }
+    return NULL;
+}
+
+void conp__index_remove(ConpEntries *entries, size_t section, uint32_t *slot)
+{
+    // backward shift deletion, later entries of the probe sequence move into the gap if their home slot allows it
+    ConpSection *s = &entries->sections[section];
+    size_t mask = s->index_capacity-1;
+    size_t gap = slot-s->index;
+    for (size_t i=(gap+1)&mask; s->index[i] != 0; i=(i+1)&mask){
+        ConpEntry *entry = &entries->items[s->index[i]-1];
+        size_t home = conp__hash(conp_span_ptr(entries, entry, entry->key), entry->key.len)&mask;
+        // the entry may move if its home slot is not in (gap, i]
+        if (((i-home)&mask) >= ((i-gap)&mask)){
+            s->index[gap] = s->index[i];
+            gap = i;
+        }
+    }
+    s->index[gap] = 0;
+}
+
+void conp__splice(ConpEntries *entries, size_t at, size_t removed, ConpEntry *items, size_t count)
+{
+    // replace the entries [at, at+removed) with the given ones, the indexes are left alone
+    size_t new_count = entries->count - removed + count;
+    if (new_count > entries->capacity){
+        size_t capacity = (entries->capacity == 0)? 32:entries->capacity;
+        while (capacity < new_count) capacity *= 2;
+        entries->items = conp__realloc(entries, entries->items, entries->capacity*sizeof(*entries->items), capacity*sizeof(*entries->items));
+        entries->capacity = capacity;
+    }
+    if (entries->count > at+removed) memmove(&entries->items[at+count], &entries->items[at+removed], (entries->count-at-removed)*sizeof(*entries->items));
+    if (count > 0) memcpy(&entries->items[at], items, count*sizeof(*items));
+    entries->count = new_count;
+}
+
+bool conp__update_next(ConpLexer *lexer, ConpEntry *entry, size_t *start)
+{
+    // lex the next entry or section header for conp_entries_update, the start is the buffer size at the end of the input
+    conp__trim_left(lexer);
+    *start = lexer->index;
+    if (lexer->index >= lexer->buffer_size) return true;
+    return conp_parse(lexer, entry);
+}
+
+void conp__update_full(ConpEntries *entries, size_t source, size_t first, size_t last, char *buffer, size_t buffer_size)
+{
+    ConpChunk chunk = {.buffer=buffer, .buffer_size=buffer_size, .buffer_name=entries->sources[source].name, .end=buffer_size};
+    conp__parse_chunk(&chunk, false);
+    // resolve the section headers, every source starts in the root section
+    size_t section;
+    (void) conp__section_id(entries, NULL, 0, &section);
+    size_t count = 0;
+    for (size_t i=0; i<chunk.count; ++i){
+        ConpEntry entry = chunk.items[i];
+        if (entry.type == ConpToken_Section){
+            if (!conp__section_id(entries, buffer+entry.key.offset, entry.key.len, &section)){
+                // the source ends at the header that does not fit, like at an error
+                chunk.failed = true;
+                break;
+            }
+            continue;
+        }
+        entry.source = source;
+        entry.section = section;
+        entries->sections[section].count++;
+        chunk.items[count++] = entry;
+    }
+    for (size_t i=first; i<last; ++i){
+        entries->sections[entries->items[i].section].count--;
+    }
+    conp__splice(entries, first, last-first, chunk.items, count);
+    ConpSource *src = &entries->sources[source];
+    src->buffer = buffer;
+    src->buffer_size = buffer_size;
+    src->failed = chunk.failed;
+    free(src->lines);
+    src->lines = NULL;
+    src->line_count = 0;
+    conp__index_rebuild(entries);
+    conp__names_rebuild(entries);
+    free(chunk.items);
+}
+
+size_t conp__source_first(ConpEntries *entries, size_t source)
+{
+    // the entries are ordered by their source, find the first one of the given source
+    size_t lo = 0, hi = entries->count;
+    while (lo < hi){
+        size_t mid = lo + (hi-lo)/2;
+        if (entries->items[mid].source < source) lo = mid+1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+#ifdef CONP_WITH_THREADS
+size_t conp__shared_reclaim(ConpShared *shared)
+{
+    // a snapshot can be freed if every reader that is inside entered after it was replaced
+    uint64_t oldest = UINT64_MAX;
+    for (size_t i=0; i<CONP_SHARED_READERS; ++i){
+        uint64_t epoch = __atomic_load_n(&shared->readers[i].epoch, __ATOMIC_SEQ_CST);
+        if (epoch != 0 && epoch < oldest) oldest = epoch;
+    }
+    size_t left = 0;
+    ConpSnapshot **p = &shared->retired;
+    while (*p != NULL){
+        ConpSnapshot *snapshot = *p;
+        if (snapshot->retired < oldest){
+            *p = snapshot->next;
+            conp_snapshot_free(snapshot);
+        }
+        else{
+            p = &snapshot->next;
+            left++;
+        }
+    }
+    return left;
+}
+#endif // CONP_WITH_THREADS
+
+#ifdef CONP_WITH_WATCH
+char* conp__read_file(char *path, size_t *size)
+{
+    // the content is copied, a mapping would change along with the file
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return NULL;
+    struct stat file;
+    if (fstat(fd, &file) == -1){
+        close(fd);
+        return NULL;
+    }
+    size_t capacity = (size_t) file.st_size + 1;
+    size_t count = 0;
+    char *buffer = malloc(capacity);
+    assert(buffer != NULL && "Need more RAM!");
+    while (true){
+        ssize_t n = read(fd, buffer+count, capacity-count);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1){
+            free(buffer);
+            close(fd);
+            return NULL;
+        }
+        if (n == 0) break;
+        count += n;
+        if (count == capacity){
+            // the file grew since fstat
+            capacity *= 2;
+            buffer = realloc(buffer, capacity);
+            assert(buffer != NULL && "Need more RAM!");
+        }
+    }
+    close(fd);
+    *size = count;
+    return buffer;
+}
+#endif // CONP_WITH_WATCH
+
+bool conp__section_id(ConpEntries *entries, char *name, size_t name_len, size_t *section)
+{
+    // the root section is created with the first lookup and never fails, sections with the same name are merged
+    if (entries->section_count == 0){
+        entries->sections = conp__realloc(entries, NULL, 0, sizeof(*entries->sections));
+        entries->sections[0] = (ConpSection) {0};
+        entries->section_count = 1;
+    }
+    *section = 0;
+    if (name == NULL) return true;
+    for (size_t i=1; i<entries->section_count; ++i){
+        ConpSection *s = &entries->sections[i];
+        if (s->name_len == name_len && memcmp(s->name, name, name_len) == 0){
+            *section = i;
+            return true;
+        }
+    }
+    if (entries->section_count >= CONP_MAX_SECTIONS){
+        fprintf(stderr, "[ERROR] Section '%.*s' can not be added, at most %u sections are supported!\n", (int) name_len, name, (unsigned) CONP_MAX_SECTIONS);
+        return false;
+    }
+    entries->sections = conp__realloc(entries, entries->sections, entries->section_count*sizeof(*entries->sections), (entries->section_count+1)*sizeof(*entries->sections));
+    // the name is copied, so it outlives the buffer of the header
+    char *copy = conp__realloc(entries, NULL, 0, name_len+1);
+    memcpy(copy, name, name_len);
+    copy[name_len] = '\0';
+    entries->sections[entries->section_count] = (ConpSection) {.name=copy, .name_len=name_len};
+    *section = entries->section_count++;
+    return true;
+}
+
+#ifdef CONP_WITH_CACHE
+uint64_t conp__cache_hash(const char *key, size_t len, size_t section)
+{
+    return conp__hash_folded(key, len) ^ (section * 0x9e3779b97f4a7c15ULL);
+}
+
+bool conp__cache_section_id(ConpCache *cache, char *section, size_t *id)
+{
+    *id = 0;
+    if (section == NULL) return true;
+    size_t section_len = strlen(section);
+    for (size_t i=1; i<cache->header->section_count; ++i){
+        ConpToken name;
+        if (!conp__cache_token(cache, cache->sections[i], &name)) return false;
+        if (name.len == section_len && memcmp(name.start, section, section_len) == 0){
+            *id = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+ConpCacheEntry* conp__cache_find(ConpCache *cache, size_t section, const char *key, size_t key_len, bool fold)
+{
+    // the first entry of the section with the key, keys that only differ in case are inserted in entry order
+    uint32_t mask = cache->header->table_size-1;
+    // bounded by the table size, the table comes from disk and might be full
+    for (uint32_t i=conp__cache_hash(key, key_len, section)&mask, n=0; cache->table[i] != 0 && n <= mask; i=(i+1)&mask, ++n){
+        uint32_t item = cache->table[i]-1;
+        if (item >= cache->header->count) return NULL;
+        ConpCacheEntry *entry = &cache->entries[item];
+        if (entry->section != section) continue;
+        ConpToken ikey;
+        if (!conp__cache_token(cache, entry->key, &ikey)) return NULL;
+        if (ikey.len != key_len) continue;
+        if (fold? conp__equal_folded(ikey.start, key, key_len):memcmp(ikey.start, key, key_len) == 0) return entry;
+    }
+    return NULL;
+}
+#endif // CONP_WITH_CACHE
+
+void* conp__realloc(ConpEntries *entries, void *ptr, size_t old_size, size_t new_size)
+{
+    if (entries->arena != NULL) return conp_arena_realloc(entries->arena, ptr, old_size, new_size);
+    ptr = realloc(ptr, new_size);
+    assert(ptr != NULL && "Need more RAM!");
+    return ptr;
+}
+
+void conp__free(ConpEntries *entries, void *ptr)
+{
+    // arena memory is only released as a whole
+    if (entries->arena == NULL) free(ptr);
+}
+
+#ifdef CONP_WITH_CACHE
+bool conp__cache_token(ConpCache *cache, ConpSpan span, ConpToken *token)
+{
+    if ((uint64_t) span.offset + span.len > cache->header->pool_size) return false;
+    char *start = cache->pool + span.offset;
+    conp__set_token(token, ConpToken_Field, start, start+span.len);
+    return true;
+}
+#endif // CONP_WITH_CACHE
+
+void conp__parse_chunk(ConpChunk *chunk, bool quiet)
+{
+    ConpLexer lexer = conp_init(chunk->buffer, chunk->buffer_size, chunk->buffer_name);
+    lexer.index = chunk->start;
+    lexer.quiet = quiet;
+    conp__trim_left(&lexer);
+    chunk->first = lexer.index;
+    ConpEntry entry;
+    while (true){
+        conp__trim_left(&lexer);
+        if (lexer.index >= chunk->end){
+            chunk->stop = lexer.index;
+            return;
+        }
+        if (!conp_parse(&lexer, &entry)){
+            chunk->ended = true;
+            chunk->failed = lexer.error_count > 0;
+            return;
+        }
+        if (chunk->count >= chunk->capacity){
+            chunk->capacity = (chunk->capacity == 0)? 1024:chunk->capacity*2;
+            chunk->items = realloc(chunk->items, chunk->capacity*sizeof(*chunk->items));
+            assert(chunk->items != NULL && "Need more RAM!");
+        }
+        chunk->items[chunk->count++] = entry;
+    }
+}
+
+size_t conp__find_key(const char *buffer, size_t from, size_t buffer_size, const char *key, size_t key_len, bool fold)
+{
+    // returns the offset of the next occurrence of the key, buffer_size if there is none
+    if (key_len == 0) return (from < buffer_size)? from:buffer_size;
+    if (key_len > buffer_size) return buffer_size;
+    size_t last = buffer_size-key_len; // the last offset at which the key fits
+    size_t i = from;
+    // ignoring case, the first and the last byte are searched in lower and upper case
+    char first = fold? conp__fold(key[0]):key[0];
+    char final = fold? conp__fold(key[key_len-1]):key[key_len-1];
+    char first_upper = (first >= 'a' && first <= 'z' && fold)? first & ~0x20:first;
+    char final_upper = (final >= 'a' && final <= 'z' && fold)? final & ~0x20:final;
+#ifdef CONP__VEC_WIDTH
+    // compare the first and the last byte of the key for a whole block of offsets at once
+    while (i + CONP__VEC_WIDTH-1 <= last){
+        uint32_t found;
+        if (fold){
+            conp__vec head = conp__vec_load(buffer+i);
+            conp__vec tail = conp__vec_load(buffer+i+key_len-1);
+            found = (conp__vec_eq(head, first) | conp__vec_eq(head, first_upper)) & (conp__vec_eq(tail, final) | conp__vec_eq(tail, final_upper));
+        }
+        else found = conp__vec_eq(conp__vec_load(buffer+i), first) & conp__vec_eq(conp__vec_load(buffer+i+key_len-1), final);
+        while (found != 0){
+            size_t offset = i + __builtin_ctz(found);
+            if (fold? conp__equal_folded(buffer+offset, key, key_len):memcmp(buffer+offset, key, key_len) == 0) return offset;
+            found &= found-1;
+        }
+        i += CONP__VEC_WIDTH;
+    }
+#endif
+    for (; i<=last; ++i){
+        if (buffer[i] != first && buffer[i] != first_upper) continue;
+        if (fold? conp__equal_folded(buffer+i, key, key_len):memcmp(buffer+i, key, key_len) == 0) return i;
+    }
+    return buffer_size;
+}
+
+#ifdef CONP_WITH_THREADS
+void* conp__parse_chunk_worker(void *arg)
+{
+    conp__parse_chunk((ConpChunk*) arg, true);
+    return NULL;
+}
+
+void* conp__parse_queue_worker(void *arg)
+{
+    ConpChunkQueue *queue = (ConpChunkQueue*) arg;
+    size_t i;
+    while ((i = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED)) < queue->count){
+        if (!queue->chunks[i].ended) conp__parse_chunk(&queue->chunks[i], true);
+    }
+    return NULL;
+}
+
+bool conp__merge_chunk(ConpEntries *entries, ConpChunk *chunk, size_t source, size_t *section)
+{
+    // append the entries of a parsed chunk, the section is updated to the one that is open behind it,
+    // false if a header does not fit into the sections, the entries in front of it are kept
+    if (entries->count + chunk->count > entries->capacity){
+        size_t capacity = (entries->capacity == 0)? 32:entries->capacity;
+        while (capacity < entries->count + chunk->count) capacity *= 2;
+        entries->items = conp__realloc(entries, entries->items, entries->capacity*sizeof(*entries->items), capacity*sizeof(*entries->items));
+        entries->capacity = capacity;
+    }
+    for (size_t j=0; j<chunk->count; ++j){
+        ConpEntry *entry = &chunk->items[j];
+        if (entry->type == ConpToken_Section){
+            if (!conp__section_id(entries, chunk->buffer+entry->key.offset, entry->key.len, section)) return false;
+            continue;
+        }
+        entry->source = source;
+        entry->section = *section;
+        entries->sections[*section].count++;
+        entries->items[entries->count++] = *entry;
+    }
+    return true;
+}
+#endif // CONP_WITH_THREADS
+
+void conp__source_lines(ConpSource *source)
+{
+    size_t capacity = 64;
+    source->lines = malloc(capacity*sizeof(*source->lines));
+    assert(source->lines != NULL && "Need more RAM!");
+    source->lines[0] = 0;
+    source->line_count = 1;
+    char *end = source->buffer + source->buffer_size;
+    char *p = source->buffer;
+    while ((p = memchr(p, '\n', end-p)) != NULL){
+        p++;
+        if (source->line_count >= capacity){
+            source->lines = realloc(source->lines, 2*capacity*sizeof(*source->lines));
+            assert(source->lines != NULL && "Need more RAM!");
+            capacity *= 2;
+        }
+        source->lines[source->line_count++] = p-source->buffer;
+    }
 }
 #endif // CONP_IMPLEMENTATION
@@ -5,6 +5,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #if defined(_WIN32) || defined(__CYGWIN__)
 #define CWK_EXPORT __declspec(dllexport)
@@ -71,6 +72,57 @@ enum cwk_path_style
   CWK_STYLE_UNIX
 };
 
+/**
+ * A span describes one result of the batch functions. The result is stored at
+ * the offset within the arena and has the length without the null-terminating
+ * character.
+ */
+struct cwk_span
+{
+  size_t offset;
+  size_t length;
+};
+
+/**
+ * @brief A context which holds the configuration for the cwk_ctx_path_*
+ * functions.
+ *
+ * Unlike the global style of cwk_path_set_style, a context belongs to the
+ * caller, so threads can use different styles at the same time. A context may
+ * be initialized like this: struct cwk_ctx ctx = {CWK_STYLE_UNIX};
+ */
+struct cwk_ctx
+{
+  enum cwk_path_style style;
+};
+
+struct cwk_intern_level;
+
+/**
+ * @brief A table which stores every distinct path once.
+ *
+ * Two paths are the same if cwk_path_normalize creates the same path from them,
+ * so "a/./b", "a//b" and "a/c/../b" share one id. The ids are numbered from
+ * zero in the order the paths were added. The normalized paths are stored one
+ * after another in the pool. The members are managed by the cwk_intern_*
+ * functions.
+ */
+struct cwk_intern
+{
+  struct cwk_ctx ctx;
+  char *pool;
+  size_t pool_size;
+  size_t pool_capacity;
+  struct cwk_span *paths;
+  uint64_t *hashes;
+  size_t count;
+  size_t capacity;
+  size_t *slots;
+  size_t slot_count;
+  struct cwk_intern_level *levels;
+  size_t level_capacity;
+};
+
 /**
  * @brief Generates an absolute path based on a base.
  *
@@ -341,6 +393,51 @@ CWK_PUBLIC size_t cwk_path_change_extension(const char *path,
 CWK_PUBLIC size_t cwk_path_normalize(const char *path, char *buffer,
   size_t buffer_size);
 
+/**
+ * @brief Normalizes many paths into one arena.
+ *
+ * This function normalizes every path like cwk_path_normalize does, but all
+ * results are written one after another into the arena. The offset and length
+ * of every result are stored in the spans, which must have room for count
+ * entries. Every result is null-terminated. The returned value is the size the
+ * arena needs for all results (including the null-terminating characters).
+ *
+ * The arena is never grown. If the returned value is larger than arena_size,
+ * the results which don't end before arena_size are truncated or missing,
+ * while their spans are complete, and the call has to be retried with an
+ * arena of at least the returned size. The retry normalizes every path again,
+ * so a caller that knows a bound of the results (for example the lengths of
+ * the input paths plus one each) should size the arena by it up front.
+ *
+ * @param paths The paths which will be normalized.
+ * @param count The amount of paths.
+ * @param arena The buffer where the results are written to.
+ * @param arena_size The size of the arena.
+ * @param spans The offsets and lengths of the results.
+ * @return The size which the arena needs to hold all results.
+ */
+CWK_PUBLIC size_t cwk_path_normalize_many(const char **paths, size_t count,
+  char *arena, size_t arena_size, struct cwk_span *spans);
+
+/**
+ * @brief Joins many pairs of paths into one arena.
+ *
+ * This function joins paths_a[i] with paths_b[i] like cwk_path_join does, for
+ * every i below count. The results are written into the arena just like
+ * cwk_path_normalize_many does it, so a too small arena has to be retried the
+ * same way, which joins every pair again.
+ *
+ * @param paths_a The paths which come first.
+ * @param paths_b The paths which come after the first ones.
+ * @param count The amount of pairs.
+ * @param arena The buffer where the results are written to.
+ * @param arena_size The size of the arena.
+ * @param spans The offsets and lengths of the results.
+ * @return The size which the arena needs to hold all results.
+ */
+CWK_PUBLIC size_t cwk_path_join_many(const char **paths_a, const char **paths_b,
+  size_t count, char *arena, size_t arena_size, struct cwk_span *spans);
+
 /**
  * @brief Finds common portions in two paths.
  *
@@ -492,6 +589,136 @@ CWK_PUBLIC void cwk_path_set_style(enum cwk_path_style style);
  */
 CWK_PUBLIC enum cwk_path_style cwk_path_get_style(void);
 
+/**
+ * @brief The path functions with a context.
+ *
+ * These functions behave exactly like the cwk_path_* functions of the same
+ * name, but they use the style of the submitted context instead of the global
+ * style. They don't touch any global state, so they may be called from multiple
+ * threads with different styles at the same time. The segments passed to the
+ * segment functions must have been created with the same style.
+ */
+CWK_PUBLIC size_t cwk_ctx_path_get_absolute(const struct cwk_ctx *ctx,
+  const char *base, const char *path, char *buffer, size_t buffer_size);
+CWK_PUBLIC size_t cwk_ctx_path_get_relative(const struct cwk_ctx *ctx,
+  const char *base_directory, const char *path, char *buffer,
+  size_t buffer_size);
+CWK_PUBLIC size_t cwk_ctx_path_join(const struct cwk_ctx *ctx,
+  const char *path_a, const char *path_b, char *buffer, size_t buffer_size);
+CWK_PUBLIC size_t cwk_ctx_path_join_multiple(const struct cwk_ctx *ctx,
+  const char **paths, char *buffer, size_t buffer_size);
+CWK_PUBLIC void cwk_ctx_path_get_root(const struct cwk_ctx *ctx,
+  const char *path, size_t *length);
+CWK_PUBLIC size_t cwk_ctx_path_change_root(const struct cwk_ctx *ctx,
+  const char *path, const char *new_root, char *buffer, size_t buffer_size);
+CWK_PUBLIC bool cwk_ctx_path_is_absolute(const struct cwk_ctx *ctx,
+  const char *path);
+CWK_PUBLIC bool cwk_ctx_path_is_relative(const struct cwk_ctx *ctx,
+  const char *path);
+CWK_PUBLIC void cwk_ctx_path_get_basename(const struct cwk_ctx *ctx,
+  const char *path, const char **basename, size_t *length);
+CWK_PUBLIC size_t cwk_ctx_path_change_basename(const struct cwk_ctx *ctx,
+  const char *path, const char *new_basename, char *buffer, size_t buffer_size);
+CWK_PUBLIC void cwk_ctx_path_get_dirname(const struct cwk_ctx *ctx,
+  const char *path, size_t *length);
+CWK_PUBLIC bool cwk_ctx_path_get_extension(const struct cwk_ctx *ctx,
+  const char *path, const char **extension, size_t *length);
+CWK_PUBLIC bool cwk_ctx_path_has_extension(const struct cwk_ctx *ctx,
+  const char *path);
+CWK_PUBLIC size_t cwk_ctx_path_change_extension(const struct cwk_ctx *ctx,
+  const char *path, const char *new_extension, char *buffer,
+  size_t buffer_size);
+CWK_PUBLIC size_t cwk_ctx_path_normalize(const struct cwk_ctx *ctx,
+  const char *path, char *buffer, size_t buffer_size);
+CWK_PUBLIC size_t cwk_ctx_path_normalize_many(const struct cwk_ctx *ctx,
+  const char **paths, size_t count, char *arena, size_t arena_size,
+  struct cwk_span *spans);
+CWK_PUBLIC size_t cwk_ctx_path_join_many(const struct cwk_ctx *ctx,
+  const char **paths_a, const char **paths_b, size_t count, char *arena,
+  size_t arena_size, struct cwk_span *spans);
+CWK_PUBLIC size_t cwk_ctx_path_get_intersection(const struct cwk_ctx *ctx,
+  const char *path_base, const char *path_other);
+CWK_PUBLIC bool cwk_ctx_path_get_first_segment(const struct cwk_ctx *ctx,
+  const char *path, struct cwk_segment *segment);
+CWK_PUBLIC bool cwk_ctx_path_get_last_segment(const struct cwk_ctx *ctx,
+  const char *path, struct cwk_segment *segment);
+CWK_PUBLIC bool cwk_ctx_path_get_next_segment(const struct cwk_ctx *ctx,
+  struct cwk_segment *segment);
+CWK_PUBLIC bool cwk_ctx_path_get_previous_segment(const struct cwk_ctx *ctx,
+  struct cwk_segment *segment);
+CWK_PUBLIC bool cwk_ctx_path_is_separator(const struct cwk_ctx *ctx,
+  const char *str);
+CWK_PUBLIC size_t cwk_ctx_path_change_segment(const struct cwk_ctx *ctx,
+  struct cwk_segment *segment, const char *value, char *buffer,
+  size_t buffer_size);
+CWK_PUBLIC enum cwk_path_style cwk_ctx_path_guess_style(
+  const struct cwk_ctx *ctx, const char *path);
+
+/**
+ * @brief Initializes an empty intern table.
+ *
+ * The table uses the submitted style for all paths. It doesn't allocate
+ * anything until the first path is added.
+ *
+ * @param intern The table which will be initialized.
+ * @param style The style of the paths.
+ */
+CWK_PUBLIC void cwk_intern_init(struct cwk_intern *intern,
+  enum cwk_path_style style);
+
+/**
+ * @brief Frees the memory of an intern table.
+ *
+ * The table is empty afterwards and may be used again.
+ *
+ * @param intern The table which will be freed.
+ */
+CWK_PUBLIC void cwk_intern_free(struct cwk_intern *intern);
+
+/**
+ * @brief Adds a path to an intern table.
+ *
+ * The path is hashed by its normalized segments without creating the
+ * normalized path first. It is only written to the pool if the table doesn't
+ * contain the same path yet, in either case the id of the path is returned.
+ *
+ * @param intern The table to which the path is added.
+ * @param path The path which will be added.
+ * @param id The id of the path.
+ * @return Returns false if there was not enough memory, the table is unchanged
+ * in that case.
+ */
+CWK_PUBLIC bool cwk_intern_add(struct cwk_intern *intern, const char *path,
+  size_t *id);
+
+/**
+ * @brief Finds a path in an intern table.
+ *
+ * This function works like cwk_intern_add, but it doesn't add the path if the
+ * table doesn't contain it.
+ *
+ * @param intern The table in which the path is searched.
+ * @param path The path which will be searched.
+ * @param id The id of the path.
+ * @return Returns true if the table contains the path.
+ */
+CWK_PUBLIC bool cwk_intern_find(struct cwk_intern *intern, const char *path,
+  size_t *id);
+
+/**
+ * @brief Returns a path of an intern table.
+ *
+ * The returned path is the normalized one, and it is null-terminated. The
+ * pointer is valid until the next path is added to the table.
+ *
+ * @param intern The table which contains the path.
+ * @param id The id of the path.
+ * @param length The length of the path, may be NULL.
+ * @return The path with the submitted id.
+ */
+CWK_PUBLIC const char *cwk_intern_get(const struct cwk_intern *intern,
+  size_t id, size_t *length);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -0,0 +1,567 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/*
+    Synthetic configs from 1KB to 1GB, quadrupling in between, are generated
+    and measured with conp_next, conp_parse_all, conp_entries_get,
+    conp_extract, conp_entries_update (a one byte edit in the middle of the
+    config), conp_entry_double (the first read of every number) and the
+    classification of the literals, once with the DFA of conp_next
+    (classify_dfa) and once with the previous chain of memcmp, int check and
+    strtod (classify_chain). -strings 0 generates literal-heavy configs
+    without strings. The allocations of conp and the peak RSS are reported as
+    well, so every size runs in its own process. -lookup instead compares a
+    linear scan over the entries with the hashed conp_entries_get at 10, 1k
+    and 100k entries.
+*/
+
+// count the allocations of conp, the macros only apply to the code below
+static size_t alloc_count;
+static size_t alloc_bytes;
+
+void* bench_malloc(size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    return malloc(size);
+}
+
+void* bench_calloc(size_t count, size_t size)
+{
+    alloc_count++;
+    alloc_bytes += count*size;
+    return calloc(count, size);
+}
+
+void* bench_realloc(void *ptr, size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    return realloc(ptr, size);
+}
+
+#define malloc(size) bench_malloc(size)
+#define calloc(count, size) bench_calloc(count, size)
+#define realloc(ptr, size) bench_realloc(ptr, size)
+
+#define CONP_IMPLEMENTATION
+#include "conp.h"
+
+#define KB (1024ULL)
+#define MB (1024ULL*KB)
+#define GB (1024ULL*MB)
+
+#define MAX_LOOKUP_KEYS (1024*1024)
+#define MIN_BENCH_BYTES (64*MB) // small configs are processed repeatedly until this much input was handled
+#define UPDATE_REPETITIONS 1000 // edits applied with conp_entries_update, half of them undo the other half
+#define LOOKUP_KEYS 1000 // keys looked up per repetition of the -lookup comparison
+#define LOOKUP_REPETITIONS 5
+
+typedef struct{
+    size_t min_size;
+    size_t max_size;
+    size_t max_key_len;
+    unsigned string_percent; // share of string values, the rest is split between ints, floats, bools and fields
+    unsigned escape_permille; // chance of every character of a string to be an escape sequence
+    uint64_t seed;
+    char *output_path;
+    bool lookup; // compare the linear scan with the hashed lookup instead of running the suite
+} BenchOptions;
+
+typedef struct{
+    const char *name;
+    double seconds; // best time of one repetition
+    size_t bytes; // input bytes per repetition
+    size_t ops; // tokens, entries, lookups or extractions per repetition
+    size_t allocs; // allocations per repetition
+    size_t alloc_bytes;
+} BenchResult;
+
+static uint64_t rng_state;
+
+uint64_t rng_next(void)
+{
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+size_t rng_range(size_t min, size_t max)
+{
+    return min + rng_next() % (max-min+1);
+}
+
+double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+size_t parse_size(const char *s)
+{
+    char *end;
+    double value = strtod(s, &end);
+    switch (*end){
+        case 'k': case 'K': value *= KB; break;
+        case 'm': case 'M': value *= MB; break;
+        case 'g': case 'G': value *= GB; break;
+    }
+    return (size_t) value;
+}
+
+// fill the buffer with a synthetic config of exactly size bytes
+char* generate_config(BenchOptions *options, size_t size)
+{
+    static const char key_chars[] = "abcdefghijklmnopqrstuvwxyz_0123456789";
+    static const char escapes[] = "nt\\";
+    char *buffer = malloc(size);
+    if (buffer == NULL) return NULL;
+    rng_state = options->seed;
+    size_t i = 0;
+    // leave room for the longest entry, the rest is padded with whitespace
+    size_t entry_max = options->max_key_len + 128;
+    while (i + entry_max < size){
+        size_t key_len = rng_range(1, options->max_key_len);
+        buffer[i++] = key_chars[rng_next() % 26];
+        for (size_t k=1; k<key_len; ++k) buffer[i++] = key_chars[rng_next() % (sizeof(key_chars)-1)];
+        memcpy(buffer+i, " = ", 3);
+        i += 3;
+        unsigned kind = rng_next() % 100;
+        if (kind < options->string_percent){
+            size_t len = rng_range(0, 96);
+            buffer[i++] = '"';
+            for (size_t k=0; k<len; ++k){
+                if (rng_next() % 1000 < options->escape_permille){
+                    buffer[i++] = '\\';
+                    buffer[i++] = escapes[rng_next() % (sizeof(escapes)-1)];
+                    k++;
+                }
+                else buffer[i++] = 'a' + rng_next() % 26;
+            }
+            buffer[i++] = '"';
+        }
+        else{
+            switch (rng_next() % 4){
+                case 0: i += sprintf(buffer+i, "%lld", (long long) (rng_next() % 2000000) - 1000000); break;
+                case 1: i += sprintf(buffer+i, "%.6g", (double) (rng_next() % 1000000) / 997.0); break;
+                case 2: i += sprintf(buffer+i, "%s", (rng_next() & 1)? "true":"false"); break;
+                case 3: i += sprintf(buffer+i, "field_%u", (unsigned) (rng_next() % 100000)); break;
+            }
+        }
+        buffer[i++] = '\n';
+    }
+    memset(buffer+i, '\n', size-i);
+    return buffer;
+}
+
+// the classifications are only counted, this keeps the compiler from dropping them
+static volatile size_t classify_sink;
+
+// the classification of literals before the DFA: find the end, then try the known literals, an int and strtod in turn
+ConpTokenType classify_chain(char *start, char *end)
+{
+    size_t t_len = end-start;
+    // the old checks compared the first t_len characters, also reading past the literals, which is left out here
+    if (t_len <= 4 && memcmp(start, "true", t_len) == 0) return ConpToken_True;
+    if (t_len <= 5 && memcmp(start, "false", t_len) == 0) return ConpToken_False;
+    char *s = start;
+    if (*s == '-' || *s == '+') s++;
+    while (s < end && isdigit((unsigned char) *s)) s++;
+    if (s == end) return ConpToken_Int;
+    char temp[64];
+    if (t_len < sizeof(temp)){
+        memcpy(temp, start, t_len);
+        temp[t_len] = '\0';
+        char *ep = NULL;
+        strtod(temp, &ep);
+        if (ep == temp+t_len) return ConpToken_Float;
+    }
+    return ConpToken_Field;
+}
+
+// the classification conp_next does while it searches the end of a literal
+ConpTokenType classify_dfa(char *start, char *end)
+{
+    uint8_t state = CONP__LIT_START;
+    for (char *c=start; c<end && state != CONP__LIT_FIELD; ++c) state = conp__literal_dfa[state][conp__char_classes[(unsigned char) *c]];
+    return conp__literal_types[state];
+}
+
+size_t repetitions(size_t size)
+{
+    size_t reps = MIN_BENCH_BYTES/size;
+    return (reps < 1)? 1:(reps > 10000)? 10000:reps;
+}
+
+typedef struct{
+    double start;
+    size_t allocs;
+    size_t alloc_bytes;
+} BenchMark;
+
+BenchMark bench_mark(void)
+{
+    return (BenchMark) {.start=now(), .allocs=alloc_count, .alloc_bytes=alloc_bytes};
+}
+
+// keep the best time and the allocations of one repetition
+void bench_record(BenchResult *result, BenchMark mark)
+{
+    double seconds = now()-mark.start;
+    if (result->seconds == 0 || seconds < result->seconds) result->seconds = seconds;
+    result->allocs = alloc_count-mark.allocs;
+    result->alloc_bytes = alloc_bytes-mark.alloc_bytes;
+}
+
+void write_result(FILE *file, BenchOptions *options, size_t size, BenchResult *result, long peak_rss_kb)
+{
+    fprintf(file, "{\"bench\": \"%s\", \"size\": %zu, \"key_len\": %zu, \"string_percent\": %u, \"escape_permille\": %u, "
+                  "\"seconds\": %.9f, \"bytes_per_sec\": %.0f, \"ops\": %zu, \"ops_per_sec\": %.0f, "
+                  "\"allocs\": %zu, \"alloc_bytes\": %zu, \"peak_rss_kb\": %ld}\n",
+            result->name, size, options->max_key_len, options->string_percent, options->escape_permille,
+            result->seconds, result->bytes/result->seconds, result->ops, result->ops/result->seconds,
+            result->allocs, result->alloc_bytes, peak_rss_kb);
+}
+
+int bench_size(BenchOptions *options, size_t size, FILE *file)
+{
+    char *config = generate_config(options, size);
+    if (config == NULL){
+        fprintf(stderr, "[ERROR] Could not generate a config of %zu bytes!\n", size);
+        return 1;
+    }
+    size_t reps = repetitions(size);
+    BenchResult results[8] = {{.name="conp_next"}, {.name="conp_parse_all"}, {.name="conp_entries_get"}, {.name="conp_extract"}, {.name="conp_entries_update"}, {.name="conp_entry_double"},
+                              {.name="classify_chain"}, {.name="classify_dfa"}};
+    BenchMark mark;
+
+    // lexing alone
+    BenchResult *next = &results[0];
+    for (size_t r=0; r<reps; ++r){
+        mark = bench_mark();
+        ConpLexer lexer = conp_init(config, size, "bench");
+        ConpToken token;
+        size_t tokens = 0;
+        while (conp_next(&lexer, &token)) tokens++;
+        bench_record(next, mark);
+        next->ops = tokens;
+    }
+    next->bytes = size;
+
+    // classification of the literals found by the lexer, once with the old chain of checks and once with the DFA
+    size_t literal_count = 0, literal_capacity = 1024, literal_bytes = 0;
+    ConpToken *literals = malloc(literal_capacity*sizeof(*literals));
+    if (literals == NULL){
+        fprintf(stderr, "[ERROR] Could not allocate the literals!\n");
+        return 1;
+    }
+    ConpLexer lexer = conp_init(config, size, "bench");
+    ConpToken token;
+    while (conp_next(&lexer, &token)){
+        if (token.type != ConpToken_Int && token.type != ConpToken_Float && token.type != ConpToken_True
+            && token.type != ConpToken_False && token.type != ConpToken_Field) continue;
+        if (literal_count == literal_capacity){
+            literal_capacity *= 2;
+            literals = realloc(literals, literal_capacity*sizeof(*literals));
+            if (literals == NULL){
+                fprintf(stderr, "[ERROR] Could not allocate the literals!\n");
+                return 1;
+            }
+        }
+        literals[literal_count++] = token;
+        literal_bytes += token.len;
+    }
+    for (size_t i=0; i<2; ++i){
+        BenchResult *classify = &results[6+i];
+        size_t reps_classify = (literal_bytes == 0)? 1:repetitions(literal_bytes);
+        for (size_t r=0; r<reps_classify; ++r){
+            mark = bench_mark();
+            size_t numbers = 0;
+            for (size_t l=0; l<literal_count; ++l){
+                ConpTokenType type = (i == 0)? classify_chain(literals[l].start, literals[l].end):classify_dfa(literals[l].start, literals[l].end);
+                numbers += type == ConpToken_Int || type == ConpToken_Float;
+            }
+            bench_record(classify, mark);
+            classify_sink += numbers;
+        }
+        classify->ops = literal_count;
+        classify->bytes = literal_bytes;
+    }
+    free(literals);
+
+    // parsing into entries, the last repetition is kept for the lookups
+    BenchResult *parse = &results[1];
+    ConpEntries entries = {0};
+    for (size_t r=0; r<reps; ++r){
+        conp_entries_free(&entries);
+        mark = bench_mark();
+        conp_parse_all(&entries, config, size, "bench");
+        bench_record(parse, mark);
+        parse->ops = entries.count;
+    }
+    parse->bytes = size;
+
+    // conversion of all ints and floats, only the first read parses a number, so this runs once on the fresh entries
+    BenchResult *number = &results[5];
+    mark = bench_mark();
+    for (size_t e=0; e<entries.count; ++e){
+        double d;
+        ConpEntry *entry = &entries.items[e];
+        if (conp_entry_double(&entries, entry, &d)){
+            number->ops++;
+            number->bytes += entry->value.len;
+        }
+    }
+    bench_record(number, mark);
+
+    // lookups of the keys in a random order, extracted beforehand
+    BenchResult *get = &results[2];
+    size_t key_count = (entries.count < MAX_LOOKUP_KEYS)? entries.count:MAX_LOOKUP_KEYS;
+    char **keys = malloc((key_count+1)*sizeof(*keys));
+    char *key_buffer = malloc(key_count*(options->max_key_len+1)+1);
+    if (keys == NULL || key_buffer == NULL){
+        fprintf(stderr, "[ERROR] Could not allocate the lookup keys!\n");
+        return 1;
+    }
+    for (size_t k=0; k<key_count; ++k){
+        ConpToken key = conp_entry_key(&entries, &entries.items[rng_next() % entries.count]);
+        keys[k] = key_buffer + k*(options->max_key_len+1);
+        conp_extract(&key, keys[k], options->max_key_len+1);
+    }
+    size_t get_reps = (key_count == 0)? 1:repetitions(key_count*64);
+    for (size_t r=0; r<get_reps; ++r){
+        mark = bench_mark();
+        ConpToken token;
+        size_t found = 0;
+        for (size_t k=0; k<key_count; ++k) found += conp_entries_get(&entries, keys[k], &token);
+        bench_record(get, mark);
+        if (found != key_count) fprintf(stderr, "[ERROR] Only %zu of %zu keys were found!\n", found, key_count);
+    }
+    get->ops = key_count;
+
+    // extraction of all values
+    BenchResult *extract = &results[3];
+    char value[256];
+    for (size_t r=0; r<reps; ++r){
+        mark = bench_mark();
+        size_t bytes = 0;
+        for (size_t e=0; e<entries.count; ++e){
+            ConpToken token = conp_entry_value(&entries, &entries.items[e]);
+            if (conp_extract(&token, value, sizeof(value))) bytes += token.len;
+        }
+        bench_record(extract, mark);
+        extract->bytes = bytes;
+    }
+    extract->ops = entries.count;
+
+    // a byte is inserted into the value of the middle entry and removed again
+    BenchResult *update = &results[4];
+    char *edited = malloc(size+1);
+    if (edited == NULL){
+        fprintf(stderr, "[ERROR] Could not allocate the edited config!\n");
+        return 1;
+    }
+    size_t edit = (entries.count == 0)? size:entries.items[entries.count/2].value.offset;
+    memcpy(edited, config, edit);
+    edited[edit] = '1';
+    memcpy(edited+edit+1, config+edit, size-edit);
+    for (size_t r=0; r<UPDATE_REPETITIONS; ++r){
+        bool insert = r%2 == 0;
+        mark = bench_mark();
+        conp_entries_update(&entries, 0, insert? edited:config, insert? size+1:size, edit, !insert, insert);
+        bench_record(update, mark);
+    }
+    update->ops = 1;
+    update->bytes = size;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    for (size_t i=0; i<sizeof(results)/sizeof(*results); ++i){
+        if (results[i].seconds <= 0) results[i].seconds = 1e-9;
+        write_result(file, options, size, &results[i], usage.ru_maxrss);
+        printf("%10zu bytes  %-16s %10.3f ms  %9.1f MB/s  %12.0f ops/s  %8zu allocs\n", size, results[i].name,
+               results[i].seconds*1e3, results[i].bytes/results[i].seconds/MB, results[i].ops/results[i].seconds, results[i].allocs);
+    }
+    fflush(file);
+    fflush(stdout);
+    free(keys);
+    free(key_buffer);
+    conp_entries_free(&entries);
+    free(edited);
+    free(config);
+    return 0;
+}
+
+// a config of exactly count entries with distinct keys and int values
+char* generate_entries(BenchOptions *options, size_t count, size_t *size)
+{
+    static const char key_chars[] = "abcdefghijklmnopqrstuvwxyz_0123456789";
+    char *buffer = malloc(count*(options->max_key_len+40)+1);
+    if (buffer == NULL) return NULL;
+    rng_state = options->seed;
+    size_t i = 0;
+    for (size_t e=0; e<count; ++e){
+        // a random prefix, the number behind it keeps the keys distinct
+        size_t key_len = rng_range(1, options->max_key_len);
+        buffer[i++] = key_chars[rng_next() % 26];
+        for (size_t k=1; k<key_len; ++k) buffer[i++] = key_chars[rng_next() % (sizeof(key_chars)-1)];
+        i += sprintf(buffer+i, "_%zu = %u\n", e, (unsigned) (rng_next() % 1000000));
+    }
+    *size = i;
+    return buffer;
+}
+
+// the lookup before the index: the key of every entry is compared in order
+bool linear_get(ConpEntries *entries, const char *key, ConpToken *token)
+{
+    size_t key_len = strlen(key);
+    for (size_t e=0; e<entries->count; ++e){
+        ConpToken entry_key = conp_entry_key(entries, &entries->items[e]);
+        if (entry_key.len == key_len && memcmp(entry_key.start, key, key_len) == 0){
+            *token = conp_entry_value(entries, &entries->items[e]);
+            return true;
+        }
+    }
+    return false;
+}
+
+int bench_lookup(BenchOptions *options, size_t count, FILE *file)
+{
+    size_t size;
+    char *config = generate_entries(options, count, &size);
+    char *key_buffer = malloc(LOOKUP_KEYS*(options->max_key_len+32));
+    if (config == NULL || key_buffer == NULL){
+        fprintf(stderr, "[ERROR] Could not generate a config of %zu entries!\n", count);
+        return 1;
+    }
+    ConpEntries entries = {0};
+    conp_parse_all(&entries, config, size, "bench");
+
+    // the same random keys for both lookups, every one of them exists
+    char *keys[LOOKUP_KEYS];
+    for (size_t k=0; k<LOOKUP_KEYS; ++k){
+        ConpToken key = conp_entry_key(&entries, &entries.items[rng_next() % entries.count]);
+        keys[k] = key_buffer + k*(options->max_key_len+32);
+        conp_extract(&key, keys[k], options->max_key_len+32);
+    }
+
+    BenchResult results[2] = {{.name="lookup_linear"}, {.name="lookup_hashed"}};
+    for (size_t i=0; i<2; ++i){
+        BenchResult *result = &results[i];
+        for (size_t r=0; r<LOOKUP_REPETITIONS; ++r){
+            BenchMark mark = bench_mark();
+            ConpToken token;
+            size_t found = 0;
+            for (size_t k=0; k<LOOKUP_KEYS; ++k) found += (i == 0)? linear_get(&entries, keys[k], &token):conp_entries_get(&entries, keys[k], &token);
+            bench_record(result, mark);
+            if (found != LOOKUP_KEYS) fprintf(stderr, "[ERROR] Only %zu of %d keys were found!\n", found, LOOKUP_KEYS);
+        }
+        if (result->seconds <= 0) result->seconds = 1e-9;
+        result->ops = LOOKUP_KEYS;
+        fprintf(file, "{\"bench\": \"%s\", \"entries\": %zu, \"size\": %zu, \"key_len\": %zu, \"seconds\": %.9f, "
+                      "\"ns_per_lookup\": %.1f, \"ops_per_sec\": %.0f}\n",
+                result->name, entries.count, size, options->max_key_len, result->seconds,
+                result->seconds*1e9/result->ops, result->ops/result->seconds);
+        printf("%7zu entries  %-14s %12.1f ns/lookup\n", entries.count, result->name, result->seconds*1e9/result->ops);
+    }
+    fflush(file);
+    conp_entries_free(&entries);
+    free(key_buffer);
+    free(config);
+    return 0;
+}
+
+void print_usage(char *program_name)
+{
+    printf("Usage: %s [options]\n", program_name);
+    printf("  -min <size>       smallest config, default 1K\n");
+    printf("  -max <size>       largest config, default 1G, the size is quadrupled in between\n");
+    printf("  -keylen <n>       longest key, default 32\n");
+    printf("  -strings <pct>    share of string values, default 60\n");
+    printf("  -escapes <pml>    escape sequences per 1000 string characters, default 10\n");
+    printf("  -seed <n>         seed of the generator, default 1\n");
+    printf("  -o <file>         JSON lines output, default bench_output.txt\n");
+    printf("  -lookup           compare a linear scan with conp_entries_get at 10, 1k and 100k entries instead\n");
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options = {.min_size=KB, .max_size=GB, .max_key_len=32, .string_percent=60, .escape_permille=10, .seed=1, .output_path="bench_output.txt"};
+    for (int i=1; i<argc; ++i){
+        char *arg = argv[i];
+        if (strcmp(arg, "-h") == 0){
+            print_usage(argv[0]);
+            return 0;
+        }
+        if (strcmp(arg, "-lookup") == 0){
+            options.lookup = true;
+            continue;
+        }
+        if (i+1 >= argc){
+            fprintf(stderr, "[ERROR] Missing value for '%s'!\n", arg);
+            print_usage(argv[0]);
+            return 1;
+        }
+        char *value = argv[++i];
+        if (strcmp(arg, "-min") == 0) options.min_size = parse_size(value);
+        else if (strcmp(arg, "-max") == 0) options.max_size = parse_size(value);
+        else if (strcmp(arg, "-keylen") == 0) options.max_key_len = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "-strings") == 0) options.string_percent = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "-escapes") == 0) options.escape_permille = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "-seed") == 0) options.seed = strtoull(value, NULL, 10);
+        else if (strcmp(arg, "-o") == 0) options.output_path = value;
+        else{
+            fprintf(stderr, "[ERROR] Unknown option '%s'!\n", arg);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.max_key_len < 1 || options.max_key_len > 200 || options.seed == 0 || options.min_size < KB || options.min_size > options.max_size){
+        fprintf(stderr, "[ERROR] Invalid options!\n");
+        return 1;
+    }
+    FILE *file = fopen(options.output_path, "w");
+    if (file == NULL){
+        fprintf(stderr, "[ERROR] Could not open '%s'!\n", options.output_path);
+        return 1;
+    }
+    int result = 0;
+    if (options.lookup){
+        size_t counts[] = {10, 1000, 100000};
+        for (size_t i=0; i<sizeof(counts)/sizeof(*counts) && result == 0; ++i) result = bench_lookup(&options, counts[i], file);
+        fclose(file);
+        printf("Results were written to '%s'.\n", options.output_path);
+        return result;
+    }
+    for (size_t size=options.min_size; size<=options.max_size; size*=4){
+        // every size runs in its own process, so the peak RSS belongs to it alone
+        fflush(file);
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == -1){
+            fprintf(stderr, "[ERROR] Could not fork!\n");
+            result = 1;
+            break;
+        }
+        if (pid == 0) _exit(bench_size(&options, size, file));
+        int status;
+        if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0){
+            fprintf(stderr, "[ERROR] The benchmark of %zu bytes failed!\n", size);
+            result = 1;
+        }
+    }
+    fclose(file);
+    printf("Results were written to '%s'.\n", options.output_path);
+    return result;
+}
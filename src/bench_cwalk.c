@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <cwalk.h>
+
+#define MIN_BENCH_SEGMENTS (4*1024*1024) // short paths are normalized repeatedly until this many segments were handled
+#define MANY_REPETITIONS 5 // the best of this many runs of a batch is reported
+
+/*
+    Adversarial paths with thousands of segments are normalized into a
+    separate buffer and in place: deep nesting resolved by as many "..",
+    relative paths with more ".." than directories, alternating directories
+    and "..", and long directory names. -many instead normalizes and joins
+    listings of 1k to 1M short paths into a buffer per path and into one
+    arena with cwk_path_normalize_many and cwk_path_join_many.
+*/
+
+typedef struct{
+    size_t min_segments;
+    size_t max_segments;
+    char *output_path;
+    bool many; // compare a buffer per path with the batch API instead of running the patterns
+} BenchOptions;
+
+typedef struct{
+    const char *name;
+    const char *description;
+    // writes a path of about count segments into buffer and returns its length
+    size_t (*generate)(char *buffer, size_t count);
+} BenchPattern;
+
+double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+size_t append(char *buffer, size_t pos, const char *segment)
+{
+    size_t len = strlen(segment);
+    memcpy(buffer+pos, segment, len);
+    return pos+len;
+}
+
+// "/d0/d1/.../../..", every back segment removes the deepest remaining one
+size_t generate_nested(char *buffer, size_t count)
+{
+    size_t pos = 0;
+    char segment[32];
+    for (size_t i=0; i<count/2; ++i){
+        sprintf(segment, "/d%zu", i);
+        pos = append(buffer, pos, segment);
+    }
+    for (size_t i=0; i<count/2; ++i) pos = append(buffer, pos, "/..");
+    return pos;
+}
+
+// "d0/d1/.../d9/../../../..", the back segments outnumber the normal ones, so the rest is kept
+size_t generate_relative(char *buffer, size_t count)
+{
+    size_t pos = 0;
+    char segment[32];
+    for (size_t i=0; i<count/4; ++i){
+        sprintf(segment, "d%zu/", i);
+        pos = append(buffer, pos, segment);
+    }
+    for (size_t i=count/4; i<count; ++i) pos = append(buffer, pos, "../");
+    return pos;
+}
+
+// "/d0/./d1//d2/./...", deep without any back segments
+size_t generate_deep(char *buffer, size_t count)
+{
+    size_t pos = 0;
+    char segment[32];
+    for (size_t i=0; i<count; ++i){
+        sprintf(segment, (i % 2)? "/./d%zu":"//d%zu", i);
+        pos = append(buffer, pos, segment);
+    }
+    return pos;
+}
+
+// "/d0/../d1/../...", every normal segment is removed right away
+size_t generate_alternating(char *buffer, size_t count)
+{
+    size_t pos = 0;
+    char segment[32];
+    for (size_t i=0; i<count/2; ++i){
+        sprintf(segment, "/d%zu/..", i);
+        pos = append(buffer, pos, segment);
+    }
+    return pos;
+}
+
+// "/a_rather_long_directory_name.../...", long segments as found in source trees
+size_t generate_long(char *buffer, size_t count)
+{
+    size_t pos = 0;
+    char segment[80];
+    for (size_t i=0; i<count; ++i){
+        sprintf(segment, "/a_rather_long_directory_name_of_a_source_tree_%zu", i);
+        pos = append(buffer, pos, segment);
+    }
+    return pos;
+}
+
+static const BenchPattern patterns[] = {
+    {"nested", "normal segments followed by as many back segments", generate_nested},
+    {"relative", "a relative path with more back than normal segments", generate_relative},
+    {"deep", "normal segments mixed with current and empty ones", generate_deep},
+    {"alternating", "every normal segment followed by a back segment", generate_alternating},
+    {"long", "long normal segments, mostly spent searching the separators", generate_long},
+};
+
+int bench_pattern(const BenchPattern *pattern, size_t count, FILE *file)
+{
+    // no segment is longer than 80 characters, the buffer is as large so the path can be copied into it for in place runs
+    size_t capacity = count*80+1;
+    char *path = malloc(capacity);
+    char *buffer = malloc(capacity);
+    if (path == NULL || buffer == NULL){
+        fprintf(stderr, "[ERROR] Could not allocate a path of %zu segments!\n", count);
+        free(path);
+        free(buffer);
+        return 1;
+    }
+    size_t length = pattern->generate(path, count);
+    path[length] = '\0';
+
+    size_t reps = MIN_BENCH_SEGMENTS/count;
+    if (reps < 1) reps = 1;
+    double best = 0, best_in_place = 0;
+    size_t result = 0;
+    for (size_t r=0; r<reps; ++r){
+        double start = now();
+        result = cwk_path_normalize(path, buffer, capacity);
+        double seconds = now()-start;
+        if (best == 0 || seconds < best) best = seconds;
+
+        memcpy(buffer, path, length+1);
+        start = now();
+        size_t in_place = cwk_path_normalize(buffer, buffer, capacity);
+        seconds = now()-start;
+        if (best_in_place == 0 || seconds < best_in_place) best_in_place = seconds;
+        if (in_place != result){
+            fprintf(stderr, "[ERROR] The in place result of '%s' differs!\n", pattern->name);
+            free(path);
+            free(buffer);
+            return 1;
+        }
+    }
+    if (best <= 0) best = 1e-9;
+    if (best_in_place <= 0) best_in_place = 1e-9;
+
+    fprintf(file, "{\"bench\": \"cwk_path_normalize\", \"pattern\": \"%s\", \"segments\": %zu, \"bytes\": %zu, \"result_bytes\": %zu, "
+                  "\"seconds\": %.9f, \"ns_per_segment\": %.3f, \"in_place_seconds\": %.9f}\n",
+            pattern->name, count, length, result, best, best*1e9/count, best_in_place);
+    printf("%-12s %9zu segments  %10.3f ms  %8.2f ns/segment  %10.3f ms in place\n", pattern->name, count,
+           best*1e3, best*1e9/count, best_in_place*1e3);
+    free(path);
+    free(buffer);
+    return 0;
+}
+
+/*
+    A listing of many short paths, as found in a monorepo, normalized (or
+    joined with a file name) by the single calls into a buffer of its own per
+    path, sized by a first call without a buffer, and by the batch calls into
+    one arena, once sized by a first call without an arena and once sized from
+    the lengths of the inputs, which the results of this listing never exceed.
+*/
+typedef enum{
+    MANY_SEPARATE,
+    MANY_ARENA_RETRY,
+    MANY_ARENA_SIZED,
+} ManyMode;
+
+static const char *many_mode_names[] = {"separate", "arena_retry", "arena_sized"};
+
+// the total size of the results, or 0 if an allocation failed
+size_t run_many(ManyMode mode, bool join, const char **dirs, const char **files, size_t count, size_t input_size, char **buffers, struct cwk_span *spans, char **arena)
+{
+    if (mode == MANY_SEPARATE){
+        size_t total = 0;
+        for (size_t i=0; i<count; ++i){
+            size_t length = join? cwk_path_join(dirs[i], files[i], NULL, 0):cwk_path_normalize(dirs[i], NULL, 0);
+            buffers[i] = malloc(length+1);
+            if (buffers[i] == NULL) return 0;
+            if (join) cwk_path_join(dirs[i], files[i], buffers[i], length+1);
+            else cwk_path_normalize(dirs[i], buffers[i], length+1);
+            total += length+1;
+        }
+        return total;
+    }
+    size_t size = (mode == MANY_ARENA_SIZED)? input_size:0;
+    if (mode == MANY_ARENA_RETRY) size = join? cwk_path_join_many(dirs, files, count, NULL, 0, spans):cwk_path_normalize_many(dirs, count, NULL, 0, spans);
+    *arena = malloc(size);
+    if (*arena == NULL) return 0;
+    size_t total = join? cwk_path_join_many(dirs, files, count, *arena, size, spans):cwk_path_normalize_many(dirs, count, *arena, size, spans);
+    if (total > size){
+        fprintf(stderr, "[ERROR] The results need %zu bytes, but the inputs only %zu!\n", total, size);
+        return 0;
+    }
+    return total;
+}
+
+int bench_many(size_t count, FILE *file)
+{
+    const char **dirs = malloc(count*sizeof(*dirs));
+    const char **files = malloc(count*sizeof(*files));
+    char **buffers = malloc(count*sizeof(*buffers));
+    struct cwk_span *spans = malloc(count*sizeof(*spans));
+    char *listing = malloc(count*96);
+    if (dirs == NULL || files == NULL || buffers == NULL || spans == NULL || listing == NULL){
+        fprintf(stderr, "[ERROR] Could not allocate a listing of %zu paths!\n", count);
+        return 1;
+    }
+    // "src/m12/./lib/../include/x3/" and "file12.h", the joined results are no longer than both inputs
+    size_t pos = 0, input_size[2] = {0, 0};
+    for (size_t i=0; i<count; ++i){
+        dirs[i] = listing+pos;
+        pos += sprintf(listing+pos, "src/m%zu/./lib/../include/x%zu/", i%1000, i%7) + 1;
+        files[i] = listing+pos;
+        pos += sprintf(listing+pos, "file%zu.h", i) + 1;
+        input_size[0] += strlen(dirs[i])+1;
+        input_size[1] += strlen(dirs[i])+strlen(files[i])+2;
+    }
+    int result = 0;
+    for (int join=0; join<2 && result == 0; ++join){
+        for (ManyMode mode=MANY_SEPARATE; mode<=MANY_ARENA_SIZED && result == 0; ++mode){
+            double best = 0;
+            size_t total = 0;
+            for (size_t r=0; r<MANY_REPETITIONS; ++r){
+                char *arena = NULL;
+                double start = now();
+                total = run_many(mode, join, dirs, files, count, input_size[join], buffers, spans, &arena);
+                double seconds = now()-start;
+                if (best == 0 || seconds < best) best = seconds;
+                if (mode == MANY_SEPARATE){
+                    for (size_t i=0; i<count && total > 0; ++i) free(buffers[i]);
+                }
+                free(arena);
+                if (total == 0){
+                    fprintf(stderr, "[ERROR] Could not run %s %s!\n", join? "join":"normalize", many_mode_names[mode]);
+                    result = 1;
+                    break;
+                }
+            }
+            if (best <= 0) best = 1e-9;
+            fprintf(file, "{\"bench\": \"%s_many\", \"mode\": \"%s\", \"paths\": %zu, \"result_bytes\": %zu, \"seconds\": %.9f, \"ns_per_path\": %.3f}\n",
+                    join? "join":"normalize", many_mode_names[mode], count, total, best, best*1e9/count);
+            printf("%-10s %-12s %8zu paths  %10.3f ms  %8.2f ns/path\n", join? "join":"normalize", many_mode_names[mode], count, best*1e3, best*1e9/count);
+        }
+    }
+    free(dirs);
+    free(files);
+    free(buffers);
+    free(spans);
+    free(listing);
+    return result;
+}
+
+void print_usage(char *program_name)
+{
+    printf("Usage: %s [options]\n", program_name);
+    printf("  -min <n>          fewest segments, default 1024\n");
+    printf("  -max <n>          most segments, default 1048576, the count is quadrupled in between\n");
+    printf("  -o <file>         JSON lines output, default bench_cwalk_output.txt\n");
+    printf("  -many             compare a buffer per path with cwk_path_normalize_many and cwk_path_join_many\n");
+    printf("                    at 1k, 100k and 1M short paths instead\n");
+    printf("Patterns:\n");
+    for (size_t i=0; i<sizeof(patterns)/sizeof(*patterns); ++i) printf("  %-12s      %s\n", patterns[i].name, patterns[i].description);
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options = {.min_segments=1024, .max_segments=1024*1024, .output_path="bench_cwalk_output.txt"};
+    for (int i=1; i<argc; ++i){
+        char *arg = argv[i];
+        if (strcmp(arg, "-h") == 0){
+            print_usage(argv[0]);
+            return 0;
+        }
+        if (strcmp(arg, "-many") == 0){
+            options.many = true;
+            continue;
+        }
+        if (i+1 >= argc){
+            fprintf(stderr, "[ERROR] Missing value for '%s'!\n", arg);
+            print_usage(argv[0]);
+            return 1;
+        }
+        char *value = argv[++i];
+        if (strcmp(arg, "-min") == 0) options.min_segments = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "-max") == 0) options.max_segments = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "-o") == 0) options.output_path = value;
+        else{
+            fprintf(stderr, "[ERROR] Unknown option '%s'!\n", arg);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.min_segments < 4 || options.min_segments > options.max_segments){
+        fprintf(stderr, "[ERROR] Invalid options!\n");
+        return 1;
+    }
+    FILE *file = fopen(options.output_path, "w");
+    if (file == NULL){
+        fprintf(stderr, "[ERROR] Could not open '%s'!\n", options.output_path);
+        return 1;
+    }
+    // the style decides what counts as a separator, the patterns only use slashes
+    cwk_path_set_style(CWK_STYLE_UNIX);
+    int result = 0;
+    if (options.many){
+        size_t counts[] = {1000, 100000, 1000000};
+        for (size_t i=0; i<sizeof(counts)/sizeof(*counts) && result == 0; ++i) result = bench_many(counts[i], file);
+        fclose(file);
+        printf("Results were written to '%s'.\n", options.output_path);
+        return result;
+    }
+    for (size_t p=0; p<sizeof(patterns)/sizeof(*patterns) && result == 0; ++p){
+        for (size_t count=options.min_segments; count<=options.max_segments; count*=4){
+            if (bench_pattern(&patterns[p], count, file) != 0){
+                result = 1;
+                break;
+            }
+        }
+    }
+    fclose(file);
+    printf("Results were written to '%s'.\n", options.output_path);
+    return result;
+}
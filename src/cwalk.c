@@ -2,9 +2,75 @@
 #include <ctype.h>
 #include <cwalk.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+/**
+ * The separator search uses SIMD instructions if they are available. A vector
+ * compares a whole block of characters at once, and the result is a mask with
+ * one bit for every character of the block.
+ */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CWK_VEC_WIDTH 32
+typedef __m256i cwk_vec;
+#define cwk_vec_loadu(p) _mm256_loadu_si256((const __m256i *)(p))
+#define cwk_vec_eq(v, c)                                                       \
+  ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8((v), _mm256_set1_epi8(c))))
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CWK_VEC_WIDTH 16
+typedef __m128i cwk_vec;
+#define cwk_vec_loadu(p) _mm_loadu_si128((const __m128i *)(p))
+#define cwk_vec_eq(v, c)                                                       \
+  ((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8((v), _mm_set1_epi8(c))))
+#endif
+
+/**
+ * The position of a character in a block is the index of its bit in the mask.
+ * MSVC has no __builtin_ctz and __builtin_clz, it uses its own intrinsics.
+ */
+#if defined(CWK_VEC_WIDTH) && defined(_MSC_VER)
+#include <intrin.h>
+static unsigned int cwk_vec_first(uint32_t mask)
+{
+  unsigned long index;
+
+  _BitScanForward(&index, mask);
+  return (unsigned int)index;
+}
+
+static unsigned int cwk_vec_last(uint32_t mask)
+{
+  unsigned long index;
+
+  _BitScanReverse(&index, mask);
+  return (unsigned int)index;
+}
+#elif defined(CWK_VEC_WIDTH)
+#define cwk_vec_first(mask) ((unsigned int)__builtin_ctz(mask))
+#define cwk_vec_last(mask) (31u - (unsigned int)__builtin_clz(mask))
+#endif
+
+/**
+ * The length of a path is not known when we search forward, so a block is
+ * only loaded once strnlen found no '\0' in it. Since most segments are short,
+ * the first few characters are checked one by one before that, and strnlen
+ * looks at a few blocks at once.
+ */
+#define CWK_VEC_HEAD 8
+#define CWK_VEC_BLOCKS 4
+
+/**
+ * Segments which are pushed behind the end of the output buffer are not
+ * written, so their sizes are remembered to move back when they are popped
+ * again. This many sizes are kept on the stack before they are moved to the
+ * heap.
+ */
+#define CWK_OVER_LEVELS 32
+
 /**
  * We try to default to a different path style depending on the operating
  * system. So this should detect whether we should use windows or unix paths.
@@ -83,12 +149,12 @@ static size_t cwk_path_output_back(char *buffer, size_t buffer_size,
   return cwk_path_output_sized(buffer, buffer_size, position, "..", 2);
 }
 
-static size_t cwk_path_output_separator(char *buffer, size_t buffer_size,
-  size_t position)
+static size_t cwk_path_output_separator(const struct cwk_ctx *ctx, char *buffer,
+  size_t buffer_size, size_t position)
 {
   // We output a separator, which is a single character.
   return cwk_path_output_sized(buffer, buffer_size, position,
-    separators[path_style], 1);
+    separators[ctx->style], 1);
 }
 
 static size_t cwk_path_output_dot(char *buffer, size_t buffer_size,
@@ -121,8 +187,8 @@ static void cwk_path_terminate_output(char *buffer, size_t buffer_size,
   }
 }
 
-static bool cwk_path_is_string_equal(const char *first, const char *second,
-  size_t first_size, size_t second_size)
+static bool cwk_path_is_string_equal(const struct cwk_ctx *ctx,
+  const char *first, const char *second, size_t first_size, size_t second_size)
 {
   bool are_both_separators;
 
@@ -133,7 +199,7 @@ static bool cwk_path_is_string_equal(const char *first, const char *second,
 
   // If the path style is UNIX, we will compare case sensitively. This can be
   // done easily using strncmp.
-  if (path_style == CWK_STYLE_UNIX) {
+  if (ctx->style == CWK_STYLE_UNIX) {
     return strncmp(first, second, first_size) == 0;
   }
 
@@ -144,8 +210,8 @@ static bool cwk_path_is_string_equal(const char *first, const char *second,
     // We can consider the string to be not equal if the two lowercase
     // characters are not equal. The two chars may also be separators, which
     // means they would be equal.
-    are_both_separators = strchr(separators[path_style], *first) != NULL &&
-                          strchr(separators[path_style], *second) != NULL;
+    are_both_separators = strchr(separators[ctx->style], *first) != NULL &&
+                          strchr(separators[ctx->style], *second) != NULL;
 
     if (tolower(*first) != tolower(*second) && !are_both_separators) {
       return false;
@@ -162,11 +228,66 @@ static bool cwk_path_is_string_equal(const char *first, const char *second,
   return true;
 }
 
-static const char *cwk_path_find_next_stop(const char *c)
+#ifdef CWK_VEC_WIDTH
+static uint32_t cwk_path_vec_separators(const struct cwk_ctx *ctx, cwk_vec v)
+{
+  // The forward slash is a separator in every style, windows also accepts the
+  // backslash.
+  if (ctx->style == CWK_STYLE_WINDOWS) {
+    return cwk_vec_eq(v, '/') | cwk_vec_eq(v, '\\');
+  }
+
+  return cwk_vec_eq(v, '/');
+}
+#endif
+
+static const char *cwk_path_find_next_stop(const struct cwk_ctx *ctx,
+  const char *c)
 {
+  char alternative;
+#ifdef CWK_VEC_WIDTH
+  const char *end;
+  uint32_t found;
+  size_t i;
+#endif
+
+  // The forward slash is a separator in every style, windows also accepts the
+  // backslash. Comparing with both is cheaper than going through the list of
+  // separators for every character.
+  alternative = ctx->style == CWK_STYLE_WINDOWS ? '\\' : '/';
+
+#ifdef CWK_VEC_WIDTH
+  // Most segments are short, so we check the first characters one by one
+  // before we start with the vectors.
+  for (i = 0; i < CWK_VEC_HEAD; ++i) {
+    if (*c == '\0' || *c == '/' || *c == alternative) {
+      return c;
+    }
+
+    ++c;
+  }
+
+  // We don't know the length of the path, so a block may only be loaded if we
+  // know that there is no '\0' in it. strnlen tells us where the string ends
+  // within the next few blocks without reading past the end of the string.
+  // The lowest bit of the mask is our next "stop".
+  do {
+    end = c + strnlen(c, CWK_VEC_BLOCKS * CWK_VEC_WIDTH);
+    while (end - c >= CWK_VEC_WIDTH) {
+      found = cwk_path_vec_separators(ctx, cwk_vec_loadu(c));
+      if (found != 0) {
+        return c + cwk_vec_first(found);
+      }
+
+      c += CWK_VEC_WIDTH;
+    }
+  } while (*end != '\0');
+#endif
+
   // We just move forward until we find a '\0' or a separator, which will be our
-  // next "stop".
-  while (*c != '\0' && !cwk_path_is_separator(c)) {
+  // next "stop". With vectors this is only the tail of the path, which is
+  // shorter than a block.
+  while (*c != '\0' && *c != '/' && *c != alternative) {
     ++c;
   }
 
@@ -174,25 +295,42 @@ static const char *cwk_path_find_next_stop(const char *c)
   return c;
 }
 
-static const char *cwk_path_find_previous_stop(const char *begin, const char *c)
+static const char *cwk_path_find_previous_stop(const struct cwk_ctx *ctx,
+  const char *begin, const char *c)
 {
+#ifdef CWK_VEC_WIDTH
+  uint32_t found;
+
+  // The beginning is known here, so we can compare whole blocks which end at
+  // c as long as they don't reach the beginning. The highest bit of the mask
+  // is the separator closest to c.
+  while (c - begin >= CWK_VEC_WIDTH) {
+    found = cwk_path_vec_separators(ctx, cwk_vec_loadu(c - CWK_VEC_WIDTH + 1));
+    if (found != 0) {
+      return c - CWK_VEC_WIDTH + 2 + cwk_vec_last(found);
+    }
+
+    c -= CWK_VEC_WIDTH;
+  }
+#endif
+
   // We just move back until we find a separator or reach the beginning of the
   // path, which will be our previous "stop".
-  while (c > begin && !cwk_path_is_separator(c)) {
+  while (c > begin && !cwk_ctx_path_is_separator(ctx, c)) {
     --c;
   }
 
   // Return the pointer to the previous stop. We have to return the first
   // character after the separator, not on the separator itself.
-  if (cwk_path_is_separator(c)) {
+  if (cwk_ctx_path_is_separator(ctx, c)) {
     return c + 1;
   } else {
     return c;
   }
 }
 
-static bool cwk_path_get_first_segment_without_root(const char *path,
-  const char *segments, struct cwk_segment *segment)
+static bool cwk_path_get_first_segment_without_root(const struct cwk_ctx *ctx,
+  const char *path, const char *segments, struct cwk_segment *segment)
 {
   // Let's remember the path. We will move the path pointer afterwards, that's
   // why this has to be done first.
@@ -211,7 +349,7 @@ static bool cwk_path_get_first_segment_without_root(const char *path,
   // If the string starts with separators, we will jump over those. If there is
   // only a slash and a '\0' after it, we can't determine the first segment
   // since there is none.
-  while (cwk_path_is_separator(segments)) {
+  while (cwk_ctx_path_is_separator(ctx, segments)) {
     ++segments;
     if (*segments == '\0') {
       return false;
@@ -223,7 +361,7 @@ static bool cwk_path_get_first_segment_without_root(const char *path,
 
   // Now let's determine the end of the segment, which we do by moving the path
   // pointer further until we find a separator.
-  segments = cwk_path_find_next_stop(segments);
+  segments = cwk_path_find_next_stop(ctx, segments);
 
   // And finally, calculate the size of the segment by subtracting the position
   // from the end.
@@ -234,28 +372,28 @@ static bool cwk_path_get_first_segment_without_root(const char *path,
   return true;
 }
 
-static bool cwk_path_get_last_segment_without_root(const char *path,
-  struct cwk_segment *segment)
+static bool cwk_path_get_last_segment_without_root(const struct cwk_ctx *ctx,
+  const char *path, struct cwk_segment *segment)
 {
   // Now this is fairly similar to the normal algorithm, however, it will assume
   // that there is no root in the path. So we grab the first segment at this
   // position, assuming there is no root.
-  if (!cwk_path_get_first_segment_without_root(path, path, segment)) {
+  if (!cwk_path_get_first_segment_without_root(ctx, path, path, segment)) {
     return false;
   }
 
   // Now we find our last segment. The segment struct of the caller
   // will contain the last segment, since the function we call here will not
   // change the segment struct when it reaches the end.
-  while (cwk_path_get_next_segment(segment)) {
+  while (cwk_ctx_path_get_next_segment(ctx, segment)) {
     // We just loop until there is no other segment left.
   }
 
   return true;
 }
 
-static bool cwk_path_get_first_segment_joined(const char **paths,
-  struct cwk_segment_joined *sj)
+static bool cwk_path_get_first_segment_joined(const struct cwk_ctx *ctx,
+  const char **paths, struct cwk_segment_joined *sj)
 {
   bool result;
 
@@ -269,7 +407,7 @@ static bool cwk_path_get_first_segment_joined(const char **paths,
   // or not.
   result = false;
   while (paths[sj->path_index] != NULL &&
-         (result = cwk_path_get_first_segment(paths[sj->path_index],
+         (result = cwk_ctx_path_get_first_segment(ctx, paths[sj->path_index],
             &sj->segment)) == false) {
     ++sj->path_index;
   }
@@ -277,7 +415,8 @@ static bool cwk_path_get_first_segment_joined(const char **paths,
   return result;
 }
 
-static bool cwk_path_get_next_segment_joined(struct cwk_segment_joined *sj)
+static bool cwk_path_get_next_segment_joined(const struct cwk_ctx *ctx,
+  struct cwk_segment_joined *sj)
 {
   bool result;
 
@@ -285,7 +424,7 @@ static bool cwk_path_get_next_segment_joined(struct cwk_segment_joined *sj)
     // We reached already the end of all paths, so there is no other segment
     // left.
     return false;
-  } else if (cwk_path_get_next_segment(&sj->segment)) {
+  } else if (cwk_ctx_path_get_next_segment(ctx, &sj->segment)) {
     // There was another segment on the current path, so we are good to
     // continue.
     return true;
@@ -307,8 +446,8 @@ static bool cwk_path_get_next_segment_joined(struct cwk_segment_joined *sj)
     // has anything useful in it. There is one more thing we have to consider
     // here - for the first time we do this we want to skip the root, but
     // afterwards we will consider that to be part of the segments.
-    result = cwk_path_get_first_segment_without_root(sj->paths[sj->path_index],
-      sj->paths[sj->path_index], &sj->segment);
+    result = cwk_path_get_first_segment_without_root(ctx,
+      sj->paths[sj->path_index], sj->paths[sj->path_index], &sj->segment);
 
   } while (!result);
 
@@ -316,7 +455,8 @@ static bool cwk_path_get_next_segment_joined(struct cwk_segment_joined *sj)
   return result;
 }
 
-static bool cwk_path_get_previous_segment_joined(struct cwk_segment_joined *sj)
+static bool cwk_path_get_previous_segment_joined(const struct cwk_ctx *ctx,
+  struct cwk_segment_joined *sj)
 {
   bool result;
 
@@ -325,7 +465,7 @@ static bool cwk_path_get_previous_segment_joined(struct cwk_segment_joined *sj)
     // struct since there are no paths. In that case we can return false, since
     // there is no previous segment.
     return false;
-  } else if (cwk_path_get_previous_segment(&sj->segment)) {
+  } else if (cwk_ctx_path_get_previous_segment(ctx, &sj->segment)) {
     // Now we try to get the previous segment from the current path. If we can
     // do that successfully, we can let the caller know that we found one.
     return true;
@@ -347,11 +487,11 @@ static bool cwk_path_get_previous_segment_joined(struct cwk_segment_joined *sj)
     // If this is the first path we will have to consider that this path might
     // include a root, otherwise we just treat is as a segment.
     if (sj->path_index == 0) {
-      result = cwk_path_get_last_segment(sj->paths[sj->path_index],
+      result = cwk_ctx_path_get_last_segment(ctx, sj->paths[sj->path_index],
         &sj->segment);
     } else {
-      result = cwk_path_get_last_segment_without_root(sj->paths[sj->path_index],
-        &sj->segment);
+      result = cwk_path_get_last_segment_without_root(ctx,
+        sj->paths[sj->path_index], &sj->segment);
     }
 
   } while (!result);
@@ -359,7 +499,8 @@ static bool cwk_path_get_previous_segment_joined(struct cwk_segment_joined *sj)
   return result;
 }
 
-static bool cwk_path_segment_back_will_be_removed(struct cwk_segment_joined *sj)
+static bool cwk_path_segment_back_will_be_removed(const struct cwk_ctx *ctx,
+  struct cwk_segment_joined *sj)
 {
   enum cwk_segment_type type;
   int counter;
@@ -375,7 +516,7 @@ static bool cwk_path_segment_back_will_be_removed(struct cwk_segment_joined *sj)
 
   // We loop over all previous segments until we either reach the beginning,
   // which means our segment will not be dropped or the counter goes above zero.
-  while (cwk_path_get_previous_segment_joined(sj)) {
+  while (cwk_path_get_previous_segment_joined(ctx, sj)) {
 
     // Now grab the type. The type determines whether we will increase or
     // decrease the counter. We don't handle a CWK_CURRENT frame here since it
@@ -401,7 +542,7 @@ static bool cwk_path_segment_back_will_be_removed(struct cwk_segment_joined *sj)
   return false;
 }
 
-static bool cwk_path_segment_normal_will_be_removed(
+static bool cwk_path_segment_normal_will_be_removed(const struct cwk_ctx *ctx,
   struct cwk_segment_joined *sj)
 {
   enum cwk_segment_type type;
@@ -414,7 +555,7 @@ static bool cwk_path_segment_normal_will_be_removed(
 
   // We loop over all following segments until we either reach the end, which
   // means our segment will not be dropped or the counter goes below zero.
-  while (cwk_path_get_next_segment_joined(sj)) {
+  while (cwk_path_get_next_segment_joined(ctx, sj)) {
 
     // First, grab the type. The type determines whether we will increase or
     // decrease the counter. We don't handle a CWK_CURRENT frame here since it
@@ -439,8 +580,8 @@ static bool cwk_path_segment_normal_will_be_removed(
 }
 
 static bool
-cwk_path_segment_will_be_removed(const struct cwk_segment_joined *sj,
-  bool absolute)
+cwk_path_segment_will_be_removed(const struct cwk_ctx *ctx,
+  const struct cwk_segment_joined *sj, bool absolute)
 {
   enum cwk_segment_type type;
   struct cwk_segment_joined sjc;
@@ -454,18 +595,18 @@ cwk_path_segment_will_be_removed(const struct cwk_segment_joined *sj,
   if (type == CWK_CURRENT || (type == CWK_BACK && absolute)) {
     return true;
   } else if (type == CWK_BACK) {
-    return cwk_path_segment_back_will_be_removed(&sjc);
+    return cwk_path_segment_back_will_be_removed(ctx, &sjc);
   } else {
-    return cwk_path_segment_normal_will_be_removed(&sjc);
+    return cwk_path_segment_normal_will_be_removed(ctx, &sjc);
   }
 }
 
 static bool
-cwk_path_segment_joined_skip_invisible(struct cwk_segment_joined *sj,
-  bool absolute)
+cwk_path_segment_joined_skip_invisible(const struct cwk_ctx *ctx,
+  struct cwk_segment_joined *sj, bool absolute)
 {
-  while (cwk_path_segment_will_be_removed(sj, absolute)) {
-    if (!cwk_path_get_next_segment_joined(sj)) {
+  while (cwk_path_segment_will_be_removed(ctx, sj, absolute)) {
+    if (!cwk_path_get_next_segment_joined(ctx, sj)) {
       return false;
     }
   }
@@ -473,7 +614,8 @@ cwk_path_segment_joined_skip_invisible(struct cwk_segment_joined *sj,
   return true;
 }
 
-static void cwk_path_get_root_windows(const char *path, size_t *length)
+static void cwk_path_get_root_windows(const struct cwk_ctx *ctx,
+  const char *path, size_t *length)
 {
   const char *c;
   bool is_device_path;
@@ -488,12 +630,12 @@ static void cwk_path_get_root_windows(const char *path, size_t *length)
 
   // Now we have to verify whether this is a windows network path (UNC), which
   // we will consider our root.
-  if (cwk_path_is_separator(c)) {
+  if (cwk_ctx_path_is_separator(ctx, c)) {
     ++c;
 
     // Check whether the path starts with a single backslash, which means this
     // is not a network path - just a normal path starting with a backslash.
-    if (!cwk_path_is_separator(c)) {
+    if (!cwk_ctx_path_is_separator(ctx, c)) {
       // Okay, this is not a network path but we still use the backslash as a
       // root.
       ++(*length);
@@ -508,7 +650,8 @@ static void cwk_path_get_root_windows(const char *path, size_t *length)
     // a '.', but that's fine since we will search for a separator afterwards
     // anyway.
     ++c;
-    is_device_path = (*c == '?' || *c == '.') && cwk_path_is_separator(++c);
+    is_device_path = (*c == '?' || *c == '.') &&
+                     cwk_ctx_path_is_separator(ctx, ++c);
     if (is_device_path) {
       // That's a device path, and the root must be either "\\.\" or "\\?\"
       // which is 4 characters long. (at least that's how Windows
@@ -519,21 +662,21 @@ static void cwk_path_get_root_windows(const char *path, size_t *length)
 
     // We will grab anything up to the next stop. The next stop might be a '\0'
     // or another separator. That will be the server name.
-    c = cwk_path_find_next_stop(c);
+    c = cwk_path_find_next_stop(ctx, c);
 
     // If this is a separator and not the end of a string we wil have to include
     // it. However, if this is a '\0' we must not skip it.
-    while (cwk_path_is_separator(c)) {
+    while (cwk_ctx_path_is_separator(ctx, c)) {
       ++c;
     }
 
     // We are now skipping the shared folder name, which will end after the
     // next stop.
-    c = cwk_path_find_next_stop(c);
+    c = cwk_path_find_next_stop(ctx, c);
 
     // Then there might be a separator at the end. We will include that as well,
     // it will mark the path as absolute.
-    if (cwk_path_is_separator(c)) {
+    if (cwk_ctx_path_is_separator(ctx, c)) {
       ++c;
     }
 
@@ -550,24 +693,26 @@ static void cwk_path_get_root_windows(const char *path, size_t *length)
     // assume that the next character is a '\0' if it is a valid path. However,
     // we will not assume that - since ':' is not valid in a path it must be a
     // mistake by the caller than. We will try to understand it anyway.
-    if (cwk_path_is_separator(++c)) {
+    if (cwk_ctx_path_is_separator(ctx, ++c)) {
       *length = 3;
     }
   }
 }
 
-static void cwk_path_get_root_unix(const char *path, size_t *length)
+static void cwk_path_get_root_unix(const struct cwk_ctx *ctx, const char *path,
+  size_t *length)
 {
   // The slash of the unix path represents the root. There is no root if there
   // is no slash.
-  if (cwk_path_is_separator(path)) {
+  if (cwk_ctx_path_is_separator(ctx, path)) {
     *length = 1;
   } else {
     *length = 0;
   }
 }
 
-static bool cwk_path_is_root_absolute(const char *path, size_t length)
+static bool cwk_path_is_root_absolute(const struct cwk_ctx *ctx,
+  const char *path, size_t length)
 {
   // This is definitely not absolute if there is no root.
   if (length == 0) {
@@ -576,15 +721,16 @@ static bool cwk_path_is_root_absolute(const char *path, size_t length)
 
   // If there is a separator at the end of the root, we can safely consider this
   // to be an absolute path.
-  return cwk_path_is_separator(&path[length - 1]);
+  return cwk_ctx_path_is_separator(ctx, &path[length - 1]);
 }
 
-static void cwk_path_fix_root(char *buffer, size_t buffer_size, size_t length)
+static void cwk_path_fix_root(const struct cwk_ctx *ctx, char *buffer,
+  size_t buffer_size, size_t length)
 {
   size_t i;
 
   // This only affects windows.
-  if (path_style != CWK_STYLE_WINDOWS) {
+  if (ctx->style != CWK_STYLE_WINDOWS) {
     return;
   }
 
@@ -596,74 +742,248 @@ static void cwk_path_fix_root(char *buffer, size_t buffer_size, size_t length)
   // Replace all forward slashes with backwards slashes. Since this is windows
   // we can't have any forward slashes in the root.
   for (i = 0; i < length; ++i) {
-    if (cwk_path_is_separator(&buffer[i])) {
+    if (cwk_ctx_path_is_separator(ctx, &buffer[i])) {
       buffer[i] = *separators[CWK_STYLE_WINDOWS];
     }
   }
 }
 
-static size_t cwk_path_join_and_normalize_multiple(const char **paths,
-  char *buffer, size_t buffer_size)
+static size_t cwk_path_pop_segment(const struct cwk_ctx *ctx, char *buffer,
+  size_t buffer_size, size_t root_length, size_t pos)
+{
+  size_t i;
+
+  // The segment on top of the stack is the last one in the output. We walk
+  // backwards until we find the separator in front of it, the new position is
+  // that separator so the next segment will overwrite it. Only the part which
+  // fit into the buffer is available, but the caller guarantees that the
+  // segment starts within the buffer.
+  i = pos < buffer_size ? pos : buffer_size;
+  while (i > root_length && !cwk_ctx_path_is_separator(ctx, &buffer[i - 1])) {
+    --i;
+  }
+
+  // If we reached the root this was the first segment, which has no separator
+  // in front of it.
+  return i > root_length ? i - 1 : root_length;
+}
+
+static size_t cwk_path_count_surplus(enum cwk_segment_type type,
+  size_t surplus)
+{
+  // The surplus is the largest amount of normal segments which are not
+  // neutralized by back segments in any stretch of segments which ends at the
+  // current one. The empty stretch has no surplus, so it never drops below
+  // zero.
+  if (type == CWK_NORMAL) {
+    return surplus + 1;
+  } else if (type == CWK_BACK && surplus > 0) {
+    return surplus - 1;
+  }
+
+  return surplus;
+}
+
+static size_t cwk_path_count_surplus_without_root(const struct cwk_ctx *ctx,
+  const char *path, size_t surplus)
+{
+  struct cwk_segment segment;
+
+  // When walking backwards over a joined path every path except the first one
+  // is read as if it had no root, so the root counts as segments as well.
+  if (!cwk_path_get_first_segment_without_root(ctx, path, path, &segment)) {
+    return surplus;
+  }
+
+  do {
+    surplus = cwk_path_count_surplus(cwk_path_get_segment_type(&segment),
+      surplus);
+  } while (cwk_ctx_path_get_next_segment(ctx, &segment));
+
+  return surplus;
+}
+
+static bool cwk_path_grow_sizes(size_t **sizes, size_t *capacity,
+  size_t *local_sizes)
 {
-  size_t pos;
-  bool absolute, has_segment_output;
-  struct cwk_segment_joined sj;
+  size_t *grown;
+
+  // The first list is on the stack of the caller, so it has to be copied to
+  // the heap instead of being reallocated.
+  if (*sizes == local_sizes) {
+    grown = malloc(*capacity * 2 * sizeof(*grown));
+    if (grown != NULL) {
+      memcpy(grown, local_sizes, *capacity * sizeof(*grown));
+    }
+  } else {
+    grown = realloc(*sizes, *capacity * 2 * sizeof(*grown));
+  }
+
+  if (grown == NULL) {
+    return false;
+  }
+
+  *sizes = grown;
+  *capacity *= 2;
+  return true;
+}
+
+static size_t cwk_path_join_and_normalize_multiple(const struct cwk_ctx *ctx,
+  const char **paths, char *buffer, size_t buffer_size)
+{
+  size_t root_length, pos, levels, depth, over, skipped, capacity, size, i,
+    first, surplus, rooted_surplus;
+  size_t local_sizes[CWK_OVER_LEVELS], *sizes;
+  bool absolute, removable;
+  enum cwk_segment_type type;
+  struct cwk_segment_joined sj, sjc;
 
   // We initialize the position after the root, which should get us started.
-  cwk_path_get_root(paths[0], &pos);
+  cwk_ctx_path_get_root(ctx, paths[0], &root_length);
+  pos = root_length;
 
   // Determine whether the path is absolute or not. We need that to determine
   // later on whether we can remove superfluous "../" or not.
-  absolute = cwk_path_is_root_absolute(paths[0], pos);
+  absolute = cwk_path_is_root_absolute(ctx, paths[0], root_length);
 
   // First copy the root to the output. After copying, we will normalize the
   // root.
-  cwk_path_output_sized(buffer, buffer_size, 0, paths[0], pos);
-  cwk_path_fix_root(buffer, buffer_size, pos);
+  cwk_path_output_sized(buffer, buffer_size, 0, paths[0], root_length);
+  cwk_path_fix_root(ctx, buffer, buffer_size, root_length);
 
   // So we just grab the first segment. If there is no segment we will always
   // output a "/", since we currently only support absolute paths here.
-  if (!cwk_path_get_first_segment_joined(paths, &sj)) {
+  if (!cwk_path_get_first_segment_joined(ctx, paths, &sj)) {
     goto done;
   }
 
-  // Let's assume that we don't have any segment output for now. We will toggle
-  // this flag once there is some output.
-  has_segment_output = false;
+  // The output after the root is used as a stack of segments. A normal segment
+  // is pushed by writing it out, and a following back segment pops it again by
+  // moving the position back to the separator in front of it. This way every
+  // segment is read once and we never have to look at the input behind the
+  // current segment, which is why the path may be the same memory as the
+  // buffer. The levels are all segments on the stack, the depth is the amount
+  // of normal segments. Back segments which can't be resolved are only kept at
+  // the bottom of relative paths, so the top is a normal segment as long as the
+  // depth is not zero.
+  levels = 0;
+  depth = 0;
+
+  // A back segment is removed as soon as there is a stretch of segments in
+  // front of it with more normal than back segments. For the stack this only
+  // matters at the bottom of relative paths, where there is no normal segment
+  // left. If the first segment is found in a later path, the paths in front of
+  // it and the root of that path are read without their roots by the backward
+  // walk, so their roots count as segments for the back segments of the
+  // following paths. We count them upfront, before anything is written.
+  first = sj.path_index;
+  surplus = 0;
+  for (i = 1; i < first; ++i) {
+    surplus = cwk_path_count_surplus_without_root(ctx, paths[i], surplus);
+  }
+  rooted_surplus = first > 0 ? cwk_path_count_surplus_without_root(ctx,
+                                 paths[first], surplus)
+                             : 0;
+
+  // Segments which start behind the end of the buffer are not written, so we
+  // can't find their separators when popping them. We remember their sizes
+  // instead, first on the stack and on the heap if there are more of them. If
+  // there is no memory left, we fall back to looking ahead whether a normal
+  // segment will be removed. Those which will be are only counted as skipped
+  // and every segment pushed on top of them is skipped as well, all others are
+  // never popped again.
+  sizes = local_sizes;
+  capacity = CWK_OVER_LEVELS;
+  over = 0;
+  skipped = 0;
 
   do {
-    // Check whether we have to drop this segment because of resolving a
-    // relative path or because it is a CWK_CURRENT segment.
-    if (cwk_path_segment_will_be_removed(&sj, absolute)) {
+    // Leaving the path with the first segment, from now on the backward walk
+    // would have read its root as segments as well.
+    if (first > 0 && sj.path_index > first) {
+      surplus = rooted_surplus;
+      first = 0;
+    }
+
+    type = cwk_path_get_segment_type(&sj.segment);
+    removable = surplus > 0;
+    surplus = cwk_path_count_surplus(type, surplus);
+
+    // The current segments are always dropped, and so are back segments which
+    // have nothing left to remove in absolute paths or which are neutralized
+    // by the surplus of normal segments in relative ones.
+    if (type == CWK_CURRENT ||
+        (type == CWK_BACK && depth == 0 && (absolute || removable))) {
       continue;
     }
 
-    // We add a separator if we previously wrote a segment. The last segment
-    // must not have a trailing separator. This must happen before the segment
-    // output, since we would override the null terminating character with
-    // reused buffers if this was done afterwards.
-    if (has_segment_output) {
-      pos += cwk_path_output_separator(buffer, buffer_size, pos);
+    // A back segment removes the normal segment on top of the stack, and it is
+    // not written out itself.
+    if (type == CWK_BACK && depth > 0) {
+      --levels;
+      --depth;
+      if (skipped > 0) {
+        --skipped;
+      } else if (over > 0) {
+        pos -= sizes[--over];
+      } else {
+        pos = cwk_path_pop_segment(ctx, buffer, buffer_size, root_length, pos);
+      }
+      continue;
     }
 
-    // Remember that we have segment output, so we can handle the trailing slash
-    // later on. This is necessary since we might have segments but they are all
-    // removed.
-    has_segment_output = true;
+    // Otherwise the segment is pushed, with a separator in front of it if
+    // there is a segment below. Segments behind the end of the buffer are
+    // only counted.
+    if (over > 0 || pos >= buffer_size) {
+      size = (levels > 0 ? 1 : 0) + sj.segment.size;
+      if (skipped > 0) {
+        ++skipped;
+      } else if (over < capacity ||
+                 cwk_path_grow_sizes(&sizes, &capacity, local_sizes)) {
+        sizes[over++] = size;
+        pos += size;
+      } else {
+        // There is no memory left for the size, so we have to know now whether
+        // the segment will be removed again.
+        sjc = sj;
+        if (type == CWK_NORMAL &&
+            cwk_path_segment_normal_will_be_removed(ctx, &sjc)) {
+          ++skipped;
+        } else {
+          pos += size;
+        }
+      }
+    } else {
+      // We add a separator if we previously wrote a segment. The last segment
+      // must not have a trailing separator. This must happen before the
+      // segment output, since we would override the null terminating
+      // character with reused buffers if this was done afterwards.
+      if (levels > 0) {
+        pos += cwk_path_output_separator(ctx, buffer, buffer_size, pos);
+      }
 
-    // Write out the segment but keep in mind that we need to follow the
-    // buffer size limitations. That's why we use the path output functions
-    // here.
-    pos += cwk_path_output_sized(buffer, buffer_size, pos, sj.segment.begin,
-      sj.segment.size);
-  } while (cwk_path_get_next_segment_joined(&sj));
-
-  // Remove the trailing slash, but only if we have segment output. We don't
-  // want to remove anything from the root.
-  if (!has_segment_output && pos == 0) {
-    // This may happen if the path is absolute and all segments have been
-    // removed. We can not have an empty output - and empty output means we stay
-    // in the current directory. So we will output a ".".
+      // Write out the segment but keep in mind that we need to follow the
+      // buffer size limitations. That's why we use the path output functions
+      // here.
+      pos += cwk_path_output_sized(buffer, buffer_size, pos, sj.segment.begin,
+        sj.segment.size);
+    }
+
+    ++levels;
+    if (type == CWK_NORMAL) {
+      ++depth;
+    }
+  } while (cwk_path_get_next_segment_joined(ctx, &sj));
+
+  if (sizes != local_sizes) {
+    free(sizes);
+  }
+
+  // This may happen if the path is relative and all segments have been
+  // removed. We can not have an empty output - and empty output means we stay
+  // in the current directory. So we will output a ".".
+  if (levels == 0 && pos == 0) {
     assert(absolute == false);
     pos += cwk_path_output_current(buffer, buffer_size, pos);
   }
@@ -678,8 +998,8 @@ done:
   return pos;
 }
 
-size_t cwk_path_get_absolute(const char *base, const char *path, char *buffer,
-  size_t buffer_size)
+size_t cwk_ctx_path_get_absolute(const struct cwk_ctx *ctx, const char *base,
+  const char *path, char *buffer, size_t buffer_size)
 {
   size_t i;
   const char *paths[4];
@@ -687,9 +1007,9 @@ size_t cwk_path_get_absolute(const char *base, const char *path, char *buffer,
   // The basename should be an absolute path if the caller is using the API
   // correctly. However, he might not and in that case we will append a fake
   // root at the beginning.
-  if (cwk_path_is_absolute(base)) {
+  if (cwk_ctx_path_is_absolute(ctx, base)) {
     i = 0;
-  } else if (path_style == CWK_STYLE_WINDOWS) {
+  } else if (ctx->style == CWK_STYLE_WINDOWS) {
     paths[0] = "\\";
     i = 1;
   } else {
@@ -697,7 +1017,7 @@ size_t cwk_path_get_absolute(const char *base, const char *path, char *buffer,
     i = 1;
   }
 
-  if (cwk_path_is_absolute(path)) {
+  if (cwk_ctx_path_is_absolute(ctx, path)) {
     // If the submitted path is not relative the base path becomes irrelevant.
     // We will only normalize the submitted path instead.
     paths[i++] = path;
@@ -711,12 +1031,12 @@ size_t cwk_path_get_absolute(const char *base, const char *path, char *buffer,
   }
 
   // Finally join everything together and normalize it.
-  return cwk_path_join_and_normalize_multiple(paths, buffer, buffer_size);
+  return cwk_path_join_and_normalize_multiple(ctx, paths, buffer, buffer_size);
 }
 
-static void cwk_path_skip_segments_until_diverge(struct cwk_segment_joined *bsj,
-  struct cwk_segment_joined *osj, bool absolute, bool *base_available,
-  bool *other_available)
+static void cwk_path_skip_segments_until_diverge(const struct cwk_ctx *ctx,
+  struct cwk_segment_joined *bsj, struct cwk_segment_joined *osj, bool absolute,
+  bool *base_available, bool *other_available)
 {
   // Now looping over all segments until they start to diverge. A path may
   // diverge if two segments are not equal or if one path reaches the end.
@@ -725,8 +1045,10 @@ static void cwk_path_skip_segments_until_diverge(struct cwk_segment_joined *bsj,
     // Check whether there is anything available after we skip everything which
     // is invisible. We do that for both paths, since we want to let the caller
     // know which path has some trailing segments after they diverge.
-    *base_available = cwk_path_segment_joined_skip_invisible(bsj, absolute);
-    *other_available = cwk_path_segment_joined_skip_invisible(osj, absolute);
+    *base_available = cwk_path_segment_joined_skip_invisible(ctx, bsj,
+      absolute);
+    *other_available = cwk_path_segment_joined_skip_invisible(ctx, osj,
+      absolute);
 
     // We are done if one or both of those paths reached the end. They either
     // diverge or both reached the end - but in both cases we can not continue
@@ -737,7 +1059,7 @@ static void cwk_path_skip_segments_until_diverge(struct cwk_segment_joined *bsj,
 
     // Compare the content of both segments. We are done if they are not equal,
     // since they diverge.
-    if (!cwk_path_is_string_equal(bsj->segment.begin, osj->segment.begin,
+    if (!cwk_path_is_string_equal(ctx, bsj->segment.begin, osj->segment.begin,
           bsj->segment.size, osj->segment.size)) {
       break;
     }
@@ -745,13 +1067,14 @@ static void cwk_path_skip_segments_until_diverge(struct cwk_segment_joined *bsj,
     // We keep going until one of those segments reached the end. The next
     // segment might be invisible, but we will check for that in the beginning
     // of the loop once again.
-    *base_available = cwk_path_get_next_segment_joined(bsj);
-    *other_available = cwk_path_get_next_segment_joined(osj);
+    *base_available = cwk_path_get_next_segment_joined(ctx, bsj);
+    *other_available = cwk_path_get_next_segment_joined(ctx, osj);
   } while (*base_available && *other_available);
 }
 
-size_t cwk_path_get_relative(const char *base_directory, const char *path,
-  char *buffer, size_t buffer_size)
+size_t cwk_ctx_path_get_relative(const struct cwk_ctx *ctx,
+  const char *base_directory, const char *path, char *buffer,
+  size_t buffer_size)
 {
   size_t pos, base_root_length, path_root_length;
   bool absolute, base_available, other_available, has_output;
@@ -763,10 +1086,10 @@ size_t cwk_path_get_relative(const char *base_directory, const char *path,
   // First we compare the roots of those two paths. If the roots are not equal
   // we can't continue, since there is no way to get a relative path from
   // different roots.
-  cwk_path_get_root(base_directory, &base_root_length);
-  cwk_path_get_root(path, &path_root_length);
+  cwk_ctx_path_get_root(ctx, base_directory, &base_root_length);
+  cwk_ctx_path_get_root(ctx, path, &path_root_length);
   if (base_root_length != path_root_length ||
-      !cwk_path_is_string_equal(base_directory, path, base_root_length,
+      !cwk_path_is_string_equal(ctx, base_directory, path, base_root_length,
         path_root_length)) {
     cwk_path_terminate_output(buffer, buffer_size, pos);
     return pos;
@@ -774,7 +1097,7 @@ size_t cwk_path_get_relative(const char *base_directory, const char *path,
 
   // Verify whether this is an absolute path. We need to know that since we can
   // remove all back-segments if it is.
-  absolute = cwk_path_is_root_absolute(base_directory, base_root_length);
+  absolute = cwk_path_is_root_absolute(ctx, base_directory, base_root_length);
 
   // Initialize our joined segments. This will allow us to use the internal
   // functions to skip until diverge and invisible. We only have one path in
@@ -783,13 +1106,13 @@ size_t cwk_path_get_relative(const char *base_directory, const char *path,
   base_paths[1] = NULL;
   other_paths[0] = path;
   other_paths[1] = NULL;
-  cwk_path_get_first_segment_joined(base_paths, &bsj);
-  cwk_path_get_first_segment_joined(other_paths, &osj);
+  cwk_path_get_first_segment_joined(ctx, base_paths, &bsj);
+  cwk_path_get_first_segment_joined(ctx, other_paths, &osj);
 
   // Okay, now we skip until the segments diverge. We don't have anything to do
   // with the segments which are equal.
-  cwk_path_skip_segments_until_diverge(&bsj, &osj, absolute, &base_available,
-    &other_available);
+  cwk_path_skip_segments_until_diverge(ctx, &bsj, &osj, absolute,
+    &base_available, &other_available);
 
   // Assume there is no output until we have got some. We will need this
   // information later on to remove trailing slashes or alternatively output a
@@ -802,7 +1125,7 @@ size_t cwk_path_get_relative(const char *base_directory, const char *path,
     do {
       // Skip any invisible segment. We don't care about those and we don't need
       // to navigate back because of them.
-      if (!cwk_path_segment_joined_skip_invisible(&bsj, absolute)) {
+      if (!cwk_path_segment_joined_skip_invisible(ctx, &bsj, absolute)) {
         break;
       }
 
@@ -813,8 +1136,8 @@ size_t cwk_path_get_relative(const char *base_directory, const char *path,
       // Output the back segment and a separator. No need to worry about the
       // superfluous segment since it will be removed later on.
       pos += cwk_path_output_back(buffer, buffer_size, pos);
-      pos += cwk_path_output_separator(buffer, buffer_size, pos);
-    } while (cwk_path_get_next_segment_joined(&bsj));
+      pos += cwk_path_output_separator(ctx, buffer, buffer_size, pos);
+    } while (cwk_path_get_next_segment_joined(ctx, &bsj));
   }
 
   // And if we have some segments available of the target path we will output
@@ -823,7 +1146,7 @@ size_t cwk_path_get_relative(const char *base_directory, const char *path,
     do {
       // Again, skip any invisible segments since we don't need to navigate into
       // them.
-      if (!cwk_path_segment_joined_skip_invisible(&osj, absolute)) {
+      if (!cwk_path_segment_joined_skip_invisible(ctx, &osj, absolute)) {
         break;
       }
 
@@ -835,8 +1158,8 @@ size_t cwk_path_get_relative(const char *base_directory, const char *path,
       // superfluous segment since it will be removed later on.
       pos += cwk_path_output_sized(buffer, buffer_size, pos, osj.segment.begin,
         osj.segment.size);
-      pos += cwk_path_output_separator(buffer, buffer_size, pos);
-    } while (cwk_path_get_next_segment_joined(&osj));
+      pos += cwk_path_output_separator(ctx, buffer, buffer_size, pos);
+    } while (cwk_path_get_next_segment_joined(ctx, &osj));
   }
 
   // If we have some output by now we will have to remove the trailing slash. We
@@ -857,8 +1180,8 @@ size_t cwk_path_get_relative(const char *base_directory, const char *path,
   return pos;
 }
 
-size_t cwk_path_join(const char *path_a, const char *path_b, char *buffer,
-  size_t buffer_size)
+size_t cwk_ctx_path_join(const struct cwk_ctx *ctx, const char *path_a,
+  const char *path_b, char *buffer, size_t buffer_size)
 {
   const char *paths[3];
 
@@ -870,37 +1193,38 @@ size_t cwk_path_join(const char *path_a, const char *path_b, char *buffer,
 
   // And then call the join and normalize function which will do the hard work
   // for us.
-  return cwk_path_join_and_normalize_multiple(paths, buffer, buffer_size);
+  return cwk_path_join_and_normalize_multiple(ctx, paths, buffer, buffer_size);
 }
 
-size_t cwk_path_join_multiple(const char **paths, char *buffer,
-  size_t buffer_size)
+size_t cwk_ctx_path_join_multiple(const struct cwk_ctx *ctx, const char **paths,
+  char *buffer, size_t buffer_size)
 {
   // We can just call the internal join and normalize function for this one,
   // since it will handle everything.
-  return cwk_path_join_and_normalize_multiple(paths, buffer, buffer_size);
+  return cwk_path_join_and_normalize_multiple(ctx, paths, buffer, buffer_size);
 }
 
-void cwk_path_get_root(const char *path, size_t *length)
+void cwk_ctx_path_get_root(const struct cwk_ctx *ctx, const char *path,
+  size_t *length)
 {
   // We use a different implementation here based on the configuration of the
   // library.
-  if (path_style == CWK_STYLE_WINDOWS) {
-    cwk_path_get_root_windows(path, length);
+  if (ctx->style == CWK_STYLE_WINDOWS) {
+    cwk_path_get_root_windows(ctx, path, length);
   } else {
-    cwk_path_get_root_unix(path, length);
+    cwk_path_get_root_unix(ctx, path, length);
   }
 }
 
-size_t cwk_path_change_root(const char *path, const char *new_root,
-  char *buffer, size_t buffer_size)
+size_t cwk_ctx_path_change_root(const struct cwk_ctx *ctx, const char *path,
+  const char *new_root, char *buffer, size_t buffer_size)
 {
   const char *tail;
   size_t root_length, path_length, tail_length, new_root_length, new_path_size;
 
   // First we need to determine the actual size of the root which we will
   // change.
-  cwk_path_get_root(path, &root_length);
+  cwk_ctx_path_get_root(ctx, path, &root_length);
 
   // Now we determine the sizes of the new root and the path. We need that to
   // determine the size of the part after the root (the tail).
@@ -926,33 +1250,33 @@ size_t cwk_path_change_root(const char *path, const char *new_root,
   return new_path_size;
 }
 
-bool cwk_path_is_absolute(const char *path)
+bool cwk_ctx_path_is_absolute(const struct cwk_ctx *ctx, const char *path)
 {
   size_t length;
 
   // We grab the root of the path. This root does not include the first
   // separator of a path.
-  cwk_path_get_root(path, &length);
+  cwk_ctx_path_get_root(ctx, path, &length);
 
   // Now we can determine whether the root is absolute or not.
-  return cwk_path_is_root_absolute(path, length);
+  return cwk_path_is_root_absolute(ctx, path, length);
 }
 
-bool cwk_path_is_relative(const char *path)
+bool cwk_ctx_path_is_relative(const struct cwk_ctx *ctx, const char *path)
 {
   // The path is relative if it is not absolute.
-  return !cwk_path_is_absolute(path);
+  return !cwk_ctx_path_is_absolute(ctx, path);
 }
 
-void cwk_path_get_basename(const char *path, const char **basename,
-  size_t *length)
+void cwk_ctx_path_get_basename(const struct cwk_ctx *ctx, const char *path,
+  const char **basename, size_t *length)
 {
   struct cwk_segment segment;
 
   // We get the last segment of the path. The last segment will contain the
   // basename if there is any. If there are no segments we will set the basename
   // to NULL and the length to 0.
-  if (!cwk_path_get_last_segment(path, &segment)) {
+  if (!cwk_ctx_path_get_last_segment(ctx, path, &segment)) {
     *basename = NULL;
     if (length) {
       *length = 0;
@@ -969,24 +1293,24 @@ void cwk_path_get_basename(const char *path, const char **basename,
   }
 }
 
-size_t cwk_path_change_basename(const char *path, const char *new_basename,
-  char *buffer, size_t buffer_size)
+size_t cwk_ctx_path_change_basename(const struct cwk_ctx *ctx, const char *path,
+  const char *new_basename, char *buffer, size_t buffer_size)
 {
   struct cwk_segment segment;
   size_t pos, root_size, new_basename_size;
 
   // First we try to get the last segment. We may only have a root without any
   // segments, in which case we will create one.
-  if (!cwk_path_get_last_segment(path, &segment)) {
+  if (!cwk_ctx_path_get_last_segment(ctx, path, &segment)) {
 
     // So there is no segment in this path. First we grab the root and output
     // that. We are not going to modify the root in any way.
-    cwk_path_get_root(path, &root_size);
+    cwk_ctx_path_get_root(ctx, path, &root_size);
     pos = cwk_path_output_sized(buffer, buffer_size, 0, path, root_size);
 
     // We have to trim the separators from the beginning of the new basename.
     // This is quite easy to do.
-    while (cwk_path_is_separator(new_basename)) {
+    while (cwk_ctx_path_is_separator(ctx, new_basename)) {
       ++new_basename;
     }
 
@@ -1000,7 +1324,8 @@ size_t cwk_path_change_basename(const char *path, const char *new_basename,
     // And then we trim the separators at the end of the basename until we reach
     // the first valid character.
     while (new_basename_size > 0 &&
-           cwk_path_is_separator(&new_basename[new_basename_size - 1])) {
+           cwk_ctx_path_is_separator(ctx,
+             &new_basename[new_basename_size - 1])) {
       --new_basename_size;
     }
 
@@ -1015,17 +1340,19 @@ size_t cwk_path_change_basename(const char *path, const char *new_basename,
 
   // If there is a last segment we can just forward this call, which is fairly
   // easy.
-  return cwk_path_change_segment(&segment, new_basename, buffer, buffer_size);
+  return cwk_ctx_path_change_segment(ctx, &segment, new_basename, buffer,
+    buffer_size);
 }
 
-void cwk_path_get_dirname(const char *path, size_t *length)
+void cwk_ctx_path_get_dirname(const struct cwk_ctx *ctx, const char *path,
+  size_t *length)
 {
   struct cwk_segment segment;
 
   // We get the last segment of the path. The last segment will contain the
   // basename if there is any. If there are no segments we will set the length
   // to 0.
-  if (!cwk_path_get_last_segment(path, &segment)) {
+  if (!cwk_ctx_path_get_last_segment(ctx, path, &segment)) {
     *length = 0;
     return;
   }
@@ -1035,15 +1362,15 @@ void cwk_path_get_dirname(const char *path, size_t *length)
   *length = (size_t)(segment.begin - path);
 }
 
-bool cwk_path_get_extension(const char *path, const char **extension,
-  size_t *length)
+bool cwk_ctx_path_get_extension(const struct cwk_ctx *ctx, const char *path,
+  const char **extension, size_t *length)
 {
   struct cwk_segment segment;
   const char *c;
 
   // We get the last segment of the path. The last segment will contain the
   // extension if there is any.
-  if (!cwk_path_get_last_segment(path, &segment)) {
+  if (!cwk_ctx_path_get_last_segment(ctx, path, &segment)) {
     return false;
   }
 
@@ -1063,17 +1390,17 @@ bool cwk_path_get_extension(const char *path, const char **extension,
   return false;
 }
 
-bool cwk_path_has_extension(const char *path)
+bool cwk_ctx_path_has_extension(const struct cwk_ctx *ctx, const char *path)
 {
   const char *extension;
   size_t length;
 
   // We just wrap the get_extension call which will then do the work for us.
-  return cwk_path_get_extension(path, &extension, &length);
+  return cwk_ctx_path_get_extension(ctx, path, &extension, &length);
 }
 
-size_t cwk_path_change_extension(const char *path, const char *new_extension,
-  char *buffer, size_t buffer_size)
+size_t cwk_ctx_path_change_extension(const struct cwk_ctx *ctx,
+  const char *path, const char *new_extension, char *buffer, size_t buffer_size)
 {
   struct cwk_segment segment;
   const char *c, *old_extension;
@@ -1081,12 +1408,12 @@ size_t cwk_path_change_extension(const char *path, const char *new_extension,
 
   // First we try to get the last segment. We may only have a root without any
   // segments, in which case we will create one.
-  if (!cwk_path_get_last_segment(path, &segment)) {
+  if (!cwk_ctx_path_get_last_segment(ctx, path, &segment)) {
 
     // So there is no segment in this path. First we grab the root and output
     // that. We are not going to modify the root in any way. If there is no
     // root, this will end up with a root size 0, and nothing will be written.
-    cwk_path_get_root(path, &root_size);
+    cwk_ctx_path_get_root(ctx, path, &root_size);
     pos = cwk_path_output_sized(buffer, buffer_size, 0, path, root_size);
 
     // Add a dot if the submitted value doesn't have any.
@@ -1143,7 +1470,8 @@ size_t cwk_path_change_extension(const char *path, const char *new_extension,
   return pos;
 }
 
-size_t cwk_path_normalize(const char *path, char *buffer, size_t buffer_size)
+size_t cwk_ctx_path_normalize(const struct cwk_ctx *ctx, const char *path,
+  char *buffer, size_t buffer_size)
 {
   const char *paths[2];
 
@@ -1152,10 +1480,76 @@ size_t cwk_path_normalize(const char *path, char *buffer, size_t buffer_size)
   paths[0] = path;
   paths[1] = NULL;
 
-  return cwk_path_join_and_normalize_multiple(paths, buffer, buffer_size);
+  return cwk_path_join_and_normalize_multiple(ctx, paths, buffer, buffer_size);
 }
 
-size_t cwk_path_get_intersection(const char *path_base, const char *path_other)
+static size_t cwk_path_output_to_arena(const struct cwk_ctx *ctx,
+  const char **paths, char *arena, size_t arena_size, size_t offset,
+  struct cwk_span *span)
+{
+  char *buffer;
+  size_t buffer_size;
+
+  // The result is written right behind the previous one. Once the arena is
+  // full there is no space left at all, but we still normalize the paths to
+  // let the caller know how large the arena has to be.
+  if (offset < arena_size) {
+    buffer = arena + offset;
+    buffer_size = arena_size - offset;
+  } else {
+    buffer = NULL;
+    buffer_size = 0;
+  }
+
+  span->offset = offset;
+  span->length = cwk_path_join_and_normalize_multiple(ctx, paths, buffer,
+    buffer_size);
+
+  // The next result starts after the null-terminating character of this one.
+  return offset + span->length + 1;
+}
+
+size_t cwk_ctx_path_normalize_many(const struct cwk_ctx *ctx,
+  const char **paths, size_t count, char *arena, size_t arena_size,
+  struct cwk_span *spans)
+{
+  const char *joined[2];
+  size_t i, offset;
+
+  // Every path is normalized on its own, just like cwk_path_normalize does it.
+  joined[1] = NULL;
+  offset = 0;
+  for (i = 0; i < count; ++i) {
+    joined[0] = paths[i];
+    offset = cwk_path_output_to_arena(ctx, joined, arena, arena_size, offset,
+      &spans[i]);
+  }
+
+  return offset;
+}
+
+size_t cwk_ctx_path_join_many(const struct cwk_ctx *ctx, const char **paths_a,
+  const char **paths_b, size_t count, char *arena, size_t arena_size,
+  struct cwk_span *spans)
+{
+  const char *joined[3];
+  size_t i, offset;
+
+  // The pairs of paths are joined like cwk_path_join does it.
+  joined[2] = NULL;
+  offset = 0;
+  for (i = 0; i < count; ++i) {
+    joined[0] = paths_a[i];
+    joined[1] = paths_b[i];
+    offset = cwk_path_output_to_arena(ctx, joined, arena, arena_size, offset,
+      &spans[i]);
+  }
+
+  return offset;
+}
+
+size_t cwk_ctx_path_get_intersection(const struct cwk_ctx *ctx,
+  const char *path_base, const char *path_other)
 {
   bool absolute;
   size_t base_root_length, other_root_length;
@@ -1166,9 +1560,9 @@ size_t cwk_path_get_intersection(const char *path_base, const char *path_other)
   // We first compare the two roots. We just return zero if they are not equal.
   // This will also happen to return zero if the paths are mixed relative and
   // absolute.
-  cwk_path_get_root(path_base, &base_root_length);
-  cwk_path_get_root(path_other, &other_root_length);
-  if (!cwk_path_is_string_equal(path_base, path_other, base_root_length,
+  cwk_ctx_path_get_root(ctx, path_base, &base_root_length);
+  cwk_ctx_path_get_root(ctx, path_other, &other_root_length);
+  if (!cwk_path_is_string_equal(ctx, path_base, path_other, base_root_length,
         other_root_length)) {
     return 0;
   }
@@ -1181,8 +1575,8 @@ size_t cwk_path_get_intersection(const char *path_base, const char *path_other)
 
   // So we get the first segment of both paths. If one of those paths don't have
   // any segment, we will return 0.
-  if (!cwk_path_get_first_segment_joined(paths_base, &base) ||
-      !cwk_path_get_first_segment_joined(paths_other, &other)) {
+  if (!cwk_path_get_first_segment_joined(ctx, paths_base, &base) ||
+      !cwk_path_get_first_segment_joined(ctx, paths_other, &other)) {
     return base_root_length;
   }
 
@@ -1190,7 +1584,7 @@ size_t cwk_path_get_intersection(const char *path_base, const char *path_other)
   // because if will ignore removed segments, and this behaves differently if
   // the path is absolute. However, we only need to check the base path because
   // we are guaranteed that both paths are either relative or absolute.
-  absolute = cwk_path_is_root_absolute(path_base, base_root_length);
+  absolute = cwk_path_is_root_absolute(ctx, path_base, base_root_length);
 
   // We must keep track of the end of the previous segment. Initially, this is
   // set to the beginning of the path. This means that 0 is returned if the
@@ -1202,12 +1596,12 @@ size_t cwk_path_get_intersection(const char *path_base, const char *path_other)
   do {
     // We skip all segments which will be removed in each path, since we want to
     // know about the true path.
-    if (!cwk_path_segment_joined_skip_invisible(&base, absolute) ||
-        !cwk_path_segment_joined_skip_invisible(&other, absolute)) {
+    if (!cwk_path_segment_joined_skip_invisible(ctx, &base, absolute) ||
+        !cwk_path_segment_joined_skip_invisible(ctx, &other, absolute)) {
       break;
     }
 
-    if (!cwk_path_is_string_equal(base.segment.begin, other.segment.begin,
+    if (!cwk_path_is_string_equal(ctx, base.segment.begin, other.segment.begin,
           base.segment.size, other.segment.size)) {
       // So the content of those two segments are not equal. We will return the
       // size up to the beginning.
@@ -1216,49 +1610,52 @@ size_t cwk_path_get_intersection(const char *path_base, const char *path_other)
 
     // Remember the end of the previous segment before we go to the next one.
     end = base.segment.end;
-  } while (cwk_path_get_next_segment_joined(&base) &&
-           cwk_path_get_next_segment_joined(&other));
+  } while (cwk_path_get_next_segment_joined(ctx, &base) &&
+           cwk_path_get_next_segment_joined(ctx, &other));
 
   // Now we calculate the length up to the last point where our paths pointed to
   // the same place.
   return (size_t)(end - path_base);
 }
 
-bool cwk_path_get_first_segment(const char *path, struct cwk_segment *segment)
+bool cwk_ctx_path_get_first_segment(const struct cwk_ctx *ctx, const char *path,
+  struct cwk_segment *segment)
 {
   size_t length;
   const char *segments;
 
   // We skip the root since that's not part of the first segment. The root is
   // treated as a separate entity.
-  cwk_path_get_root(path, &length);
+  cwk_ctx_path_get_root(ctx, path, &length);
   segments = path + length;
 
   // Now, after we skipped the root we can continue and find the actual segment
   // content.
-  return cwk_path_get_first_segment_without_root(path, segments, segment);
+  return cwk_path_get_first_segment_without_root(ctx, path, segments, segment);
 }
 
-bool cwk_path_get_last_segment(const char *path, struct cwk_segment *segment)
+bool cwk_ctx_path_get_last_segment(const struct cwk_ctx *ctx, const char *path,
+  struct cwk_segment *segment)
 {
   // We first grab the first segment. This might be our last segment as well,
   // but we don't know yet. There is no last segment if there is no first
   // segment, so we return false in that case.
-  if (!cwk_path_get_first_segment(path, segment)) {
+  if (!cwk_ctx_path_get_first_segment(ctx, path, segment)) {
     return false;
   }
 
   // Now we find our last segment. The segment struct of the caller
   // will contain the last segment, since the function we call here will not
   // change the segment struct when it reaches the end.
-  while (cwk_path_get_next_segment(segment)) {
+  while (cwk_ctx_path_get_next_segment(ctx, segment)) {
     // We just loop until there is no other segment left.
   }
 
   return true;
 }
 
-bool cwk_path_get_next_segment(struct cwk_segment *segment)
+bool cwk_ctx_path_get_next_segment(const struct cwk_ctx *ctx,
+  struct cwk_segment *segment)
 {
   const char *c;
 
@@ -1271,10 +1668,10 @@ bool cwk_path_get_next_segment(struct cwk_segment *segment)
 
   // Now we skip all separator until we reach something else. We are not yet
   // guaranteed to have a segment, since the string could just end afterwards.
-  assert(cwk_path_is_separator(c));
+  assert(cwk_ctx_path_is_separator(ctx, c));
   do {
     ++c;
-  } while (cwk_path_is_separator(c));
+  } while (cwk_ctx_path_is_separator(ctx, c));
 
   // If the string ends here, we can safely assume that there is no other
   // segment after this one.
@@ -1288,7 +1685,7 @@ bool cwk_path_get_next_segment(struct cwk_segment *segment)
 
   // And now determine the size of this segment, and store it in the struct of
   // the caller as well.
-  c = cwk_path_find_next_stop(c);
+  c = cwk_path_find_next_stop(ctx, c);
   segment->end = c;
   segment->size = (size_t)(c - segment->begin);
 
@@ -1296,7 +1693,8 @@ bool cwk_path_get_next_segment(struct cwk_segment *segment)
   return true;
 }
 
-bool cwk_path_get_previous_segment(struct cwk_segment *segment)
+bool cwk_ctx_path_get_previous_segment(const struct cwk_ctx *ctx,
+  struct cwk_segment *segment)
 {
   const char *c;
 
@@ -1316,12 +1714,12 @@ bool cwk_path_get_previous_segment(struct cwk_segment *segment)
       // false and don't change the segment structure submitted by the caller.
       return false;
     }
-  } while (cwk_path_is_separator(c));
+  } while (cwk_ctx_path_is_separator(ctx, c));
 
   // We are guaranteed now that there is another segment, since we moved before
   // the previous separator and did not reach the segment path beginning.
   segment->end = c + 1;
-  segment->begin = cwk_path_find_previous_stop(segment->segments, c);
+  segment->begin = cwk_path_find_previous_stop(ctx, segment->segments, c);
   segment->size = (size_t)(segment->end - segment->begin);
 
   return true;
@@ -1341,12 +1739,12 @@ enum cwk_segment_type cwk_path_get_segment_type(
   return CWK_NORMAL;
 }
 
-bool cwk_path_is_separator(const char *str)
+bool cwk_ctx_path_is_separator(const struct cwk_ctx *ctx, const char *str)
 {
   const char *c;
 
   // We loop over all characters in the read symbols.
-  c = separators[path_style];
+  c = separators[ctx->style];
   while (*c) {
     if (*c == *str) {
       return true;
@@ -1358,8 +1756,9 @@ bool cwk_path_is_separator(const char *str)
   return false;
 }
 
-size_t cwk_path_change_segment(struct cwk_segment *segment, const char *value,
-  char *buffer, size_t buffer_size)
+size_t cwk_ctx_path_change_segment(const struct cwk_ctx *ctx,
+  struct cwk_segment *segment, const char *value, char *buffer,
+  size_t buffer_size)
 {
   size_t pos, value_size, tail_size;
 
@@ -1370,7 +1769,7 @@ size_t cwk_path_change_segment(struct cwk_segment *segment, const char *value,
 
   // In order to trip the submitted value, we will skip any separator at the
   // beginning of it and behave as if it was never there.
-  while (cwk_path_is_separator(value)) {
+  while (cwk_ctx_path_is_separator(ctx, value)) {
     ++value;
   }
 
@@ -1384,7 +1783,8 @@ size_t cwk_path_change_segment(struct cwk_segment *segment, const char *value,
   // Since we trim separators at the beginning and in the end of the value we
   // have to subtract from the size until there are either no more characters
   // left or the last character is no separator.
-  while (value_size > 0 && cwk_path_is_separator(&value[value_size - 1])) {
+  while (value_size > 0 &&
+         cwk_ctx_path_is_separator(ctx, &value[value_size - 1])) {
     --value_size;
   }
 
@@ -1411,7 +1811,8 @@ size_t cwk_path_change_segment(struct cwk_segment *segment, const char *value,
   return pos;
 }
 
-enum cwk_path_style cwk_path_guess_style(const char *path)
+enum cwk_path_style cwk_ctx_path_guess_style(const struct cwk_ctx *ctx,
+  const char *path)
 {
   const char *c;
   size_t root_length;
@@ -1420,7 +1821,7 @@ enum cwk_path_style cwk_path_guess_style(const char *path)
   // First we determine the root. Only windows roots can be longer than a single
   // slash, so if we can determine that it starts with something like "C:", we
   // know that this is a windows path.
-  cwk_path_get_root_windows(path, &root_length);
+  cwk_path_get_root_windows(ctx, path, &root_length);
   if (root_length > 1) {
     return CWK_STYLE_WINDOWS;
   }
@@ -1440,7 +1841,7 @@ enum cwk_path_style cwk_path_guess_style(const char *path)
   // actually must be the first one), and determine whether the segment starts
   // with a dot. A dot is a hidden folder or file in the UNIX world, in that
   // case we assume the path to have UNIX style.
-  if (!cwk_path_get_last_segment(path, &segment)) {
+  if (!cwk_ctx_path_get_last_segment(ctx, path, &segment)) {
     // We couldn't find any segments, so we default to a UNIX path style since
     // there is no way to make any assumptions.
     return CWK_STYLE_UNIX;
@@ -1464,6 +1865,564 @@ enum cwk_path_style cwk_path_guess_style(const char *path)
   return CWK_STYLE_UNIX;
 }
 
+/**
+ * The intern table keeps a stack of the segments which the normalized path
+ * consists of. Every level remembers the hash and the length of the
+ * normalized path in front of it, so a back segment can restore both without
+ * looking at the path again.
+ */
+struct cwk_intern_level
+{
+  const char *begin;
+  size_t size;
+  size_t length;
+  uint64_t hash;
+};
+
+/**
+ * The normalized form of a path, which has not been written anywhere. The
+ * root is still the one of the original path, which has to be fixed when it is
+ * written out.
+ */
+struct cwk_intern_key
+{
+  const char *root;
+  size_t root_length;
+  size_t levels;
+  size_t length;
+  bool current;
+  uint64_t hash;
+};
+
+static uint64_t cwk_intern_hash(uint64_t hash, const char *str, size_t length)
+{
+  size_t i;
+
+  // This is FNV-1a, the hash is continued from the given one so the pieces of
+  // the normalized path can be hashed one after another.
+  for (i = 0; i < length; ++i) {
+    hash ^= (unsigned char)str[i];
+    hash *= 0x100000001b3ULL;
+  }
+
+  return hash;
+}
+
+static char cwk_intern_root_char(const struct cwk_intern *intern,
+  const char *c)
+{
+  // The separators of a windows root are always written as backslashes, just
+  // like cwk_path_fix_root does it.
+  if (intern->ctx.style == CWK_STYLE_WINDOWS &&
+      cwk_ctx_path_is_separator(&intern->ctx, c)) {
+    return *separators[CWK_STYLE_WINDOWS];
+  }
+
+  return *c;
+}
+
+static bool cwk_intern_normalize(struct cwk_intern *intern, const char *path,
+  struct cwk_intern_key *key)
+{
+  struct cwk_intern_level *levels, *level;
+  struct cwk_segment segment;
+  enum cwk_segment_type type;
+  size_t i, depth, capacity;
+  bool absolute, has_segments, has_segment;
+  char c;
+
+  // The root is hashed first, with the separators it will be written with.
+  cwk_ctx_path_get_root(&intern->ctx, path, &key->root_length);
+  absolute = cwk_path_is_root_absolute(&intern->ctx, path, key->root_length);
+  key->root = path;
+  key->hash = 0xcbf29ce484222325ULL;
+  for (i = 0; i < key->root_length; ++i) {
+    c = cwk_intern_root_char(intern, &path[i]);
+    key->hash = cwk_intern_hash(key->hash, &c, 1);
+  }
+  key->length = key->root_length;
+  key->levels = 0;
+  key->current = false;
+
+  // This resolves the segments the same way as
+  // cwk_path_join_and_normalize_multiple, but instead of writing the segments
+  // out we push them on the stack of levels and continue the hash.
+  depth = 0;
+  has_segments = cwk_ctx_path_get_first_segment(&intern->ctx, path, &segment);
+  has_segment = has_segments;
+  while (has_segment) {
+    type = cwk_path_get_segment_type(&segment);
+    if (type == CWK_BACK && depth > 0) {
+      // A back segment removes the normal segment on top of the stack, so the
+      // hash and the length are the ones in front of that segment again.
+      level = &intern->levels[--key->levels];
+      key->hash = level->hash;
+      key->length = level->length;
+      --depth;
+    } else if (type == CWK_NORMAL || (type == CWK_BACK && !absolute)) {
+      // We need another level, the stack grows as deep as the deepest path
+      // which has been interned so far.
+      if (key->levels == intern->level_capacity) {
+        capacity = intern->level_capacity ? intern->level_capacity * 2 : 16;
+        levels = realloc(intern->levels, capacity * sizeof(*levels));
+        if (levels == NULL) {
+          return false;
+        }
+        intern->levels = levels;
+        intern->level_capacity = capacity;
+      }
+
+      level = &intern->levels[key->levels++];
+      level->begin = segment.begin;
+      level->size = segment.size;
+      level->hash = key->hash;
+      level->length = key->length;
+
+      // The segment is preceded by a separator unless it is the first one.
+      if (key->levels > 1) {
+        key->hash = cwk_intern_hash(key->hash, separators[intern->ctx.style],
+          1);
+        ++key->length;
+      }
+      key->hash = cwk_intern_hash(key->hash, segment.begin, segment.size);
+      key->length += segment.size;
+      if (type == CWK_NORMAL) {
+        ++depth;
+      }
+    }
+
+    has_segment = cwk_ctx_path_get_next_segment(&intern->ctx, &segment);
+  }
+
+  // A relative path whose segments have all been removed is the current
+  // directory. A path without any segments stays empty though, just like in
+  // cwk_path_normalize.
+  if (key->length == 0 && has_segments) {
+    key->current = true;
+    key->hash = cwk_intern_hash(key->hash, ".", 1);
+    key->length = 1;
+  }
+
+  return true;
+}
+
+static bool cwk_intern_output_sized(char *buffer, const char *str,
+  size_t length, bool compare)
+{
+  // Either compares the piece with the buffer or writes it there.
+  if (compare) {
+    return memcmp(buffer, str, length) == 0;
+  }
+
+  memcpy(buffer, str, length);
+  return true;
+}
+
+static bool cwk_intern_output(const struct cwk_intern *intern,
+  const struct cwk_intern_key *key, char *buffer, bool compare)
+{
+  const struct cwk_intern_level *level;
+  size_t i, pos;
+  char c;
+
+  // The pieces of the normalized path are either compared with the buffer or
+  // written to it, so both are guaranteed to produce the same string.
+  for (i = 0; i < key->root_length; ++i) {
+    c = cwk_intern_root_char(intern, &key->root[i]);
+    if (!cwk_intern_output_sized(&buffer[i], &c, 1, compare)) {
+      return false;
+    }
+  }
+
+  pos = key->root_length;
+  for (i = 0; i < key->levels; ++i) {
+    level = &intern->levels[i];
+    if (i > 0) {
+      if (!cwk_intern_output_sized(&buffer[pos], separators[intern->ctx.style],
+            1, compare)) {
+        return false;
+      }
+      ++pos;
+    }
+
+    if (!cwk_intern_output_sized(&buffer[pos], level->begin, level->size,
+          compare)) {
+      return false;
+    }
+    pos += level->size;
+  }
+
+  if (key->current) {
+    return cwk_intern_output_sized(&buffer[pos], ".", 1, compare);
+  }
+
+  return true;
+}
+
+static bool cwk_intern_lookup(const struct cwk_intern *intern,
+  const struct cwk_intern_key *key, size_t *slot)
+{
+  const struct cwk_span *stored;
+  size_t id;
+
+  // The table uses linear probing and stores the id plus one, so zero marks an
+  // empty slot. The slot of the path or the empty slot where it belongs is
+  // passed back to the caller.
+  if (intern->slot_count == 0) {
+    return false;
+  }
+
+  for (*slot = key->hash & (intern->slot_count - 1);
+       intern->slots[*slot] != 0;
+       *slot = (*slot + 1) & (intern->slot_count - 1)) {
+    id = intern->slots[*slot] - 1;
+    stored = &intern->paths[id];
+    if (intern->hashes[id] == key->hash && stored->length == key->length &&
+        cwk_intern_output(intern, key, &intern->pool[stored->offset], true)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool cwk_intern_reserve(struct cwk_intern *intern, size_t length)
+{
+  size_t i, slot, slot_count, capacity, *slots;
+  struct cwk_span *paths;
+  uint64_t *hashes;
+  char *pool;
+
+  // All allocations happen before anything is added, so the table stays
+  // unchanged if one of them fails. The pool grows by doubling, just like the
+  // list of paths.
+  if (intern->pool_size + length + 1 > intern->pool_capacity) {
+    capacity = intern->pool_capacity ? intern->pool_capacity : 256;
+    while (intern->pool_size + length + 1 > capacity) {
+      capacity *= 2;
+    }
+    pool = realloc(intern->pool, capacity);
+    if (pool == NULL) {
+      return false;
+    }
+    intern->pool = pool;
+    intern->pool_capacity = capacity;
+  }
+
+  if (intern->count == intern->capacity) {
+    capacity = intern->capacity ? intern->capacity * 2 : 16;
+    paths = realloc(intern->paths, capacity * sizeof(*paths));
+    if (paths == NULL) {
+      return false;
+    }
+    intern->paths = paths;
+    hashes = realloc(intern->hashes, capacity * sizeof(*hashes));
+    if (hashes == NULL) {
+      return false;
+    }
+    intern->hashes = hashes;
+    intern->capacity = capacity;
+  }
+
+  // The slots are kept at most half full, they are rebuilt from the stored
+  // hashes when they grow.
+  if ((intern->count + 1) * 2 > intern->slot_count) {
+    slot_count = intern->slot_count ? intern->slot_count * 2 : 32;
+    slots = calloc(slot_count, sizeof(*slots));
+    if (slots == NULL) {
+      return false;
+    }
+    for (i = 0; i < intern->count; ++i) {
+      slot = intern->hashes[i] & (slot_count - 1);
+      while (slots[slot] != 0) {
+        slot = (slot + 1) & (slot_count - 1);
+      }
+      slots[slot] = i + 1;
+    }
+    free(intern->slots);
+    intern->slots = slots;
+    intern->slot_count = slot_count;
+  }
+
+  return true;
+}
+
+void cwk_intern_init(struct cwk_intern *intern, enum cwk_path_style style)
+{
+  memset(intern, 0, sizeof(*intern));
+  intern->ctx.style = style;
+}
+
+void cwk_intern_free(struct cwk_intern *intern)
+{
+  free(intern->pool);
+  free(intern->paths);
+  free(intern->hashes);
+  free(intern->slots);
+  free(intern->levels);
+  cwk_intern_init(intern, intern->ctx.style);
+}
+
+bool cwk_intern_add(struct cwk_intern *intern, const char *path, size_t *id)
+{
+  struct cwk_intern_key key;
+  struct cwk_span *stored;
+  size_t slot;
+
+  // The path is only written to the pool if there is no path with the same
+  // normalized form yet.
+  if (!cwk_intern_normalize(intern, path, &key)) {
+    return false;
+  }
+
+  if (cwk_intern_lookup(intern, &key, &slot)) {
+    *id = intern->slots[slot] - 1;
+    return true;
+  }
+
+  if (!cwk_intern_reserve(intern, key.length)) {
+    return false;
+  }
+
+  // Reserving might have rebuilt the slots, so we have to search the empty
+  // slot again.
+  cwk_intern_lookup(intern, &key, &slot);
+
+  *id = intern->count++;
+  stored = &intern->paths[*id];
+  stored->offset = intern->pool_size;
+  stored->length = key.length;
+  cwk_intern_output(intern, &key, &intern->pool[stored->offset], false);
+  intern->pool[stored->offset + stored->length] = '\0';
+  intern->pool_size += stored->length + 1;
+  intern->hashes[*id] = key.hash;
+  intern->slots[slot] = *id + 1;
+
+  return true;
+}
+
+bool cwk_intern_find(struct cwk_intern *intern, const char *path, size_t *id)
+{
+  struct cwk_intern_key key;
+  size_t slot;
+
+  if (!cwk_intern_normalize(intern, path, &key) ||
+      !cwk_intern_lookup(intern, &key, &slot)) {
+    return false;
+  }
+
+  *id = intern->slots[slot] - 1;
+  return true;
+}
+
+const char *cwk_intern_get(const struct cwk_intern *intern, size_t id,
+  size_t *length)
+{
+  assert(id < intern->count);
+
+  if (length != NULL) {
+    *length = intern->paths[id].length;
+  }
+
+  return &intern->pool[intern->paths[id].offset];
+}
+
+/**
+ * The functions without a context use the global style, which is configured by
+ * cwk_path_set_style. They just wrap the functions which take a context.
+ */
+size_t cwk_path_get_absolute(const char *base, const char *path, char *buffer,
+  size_t buffer_size)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_get_absolute(&ctx, base, path, buffer, buffer_size);
+}
+
+size_t cwk_path_get_relative(const char *base_directory, const char *path,
+  char *buffer, size_t buffer_size)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_get_relative(&ctx, base_directory, path, buffer,
+    buffer_size);
+}
+
+size_t cwk_path_join(const char *path_a, const char *path_b, char *buffer,
+  size_t buffer_size)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_join(&ctx, path_a, path_b, buffer, buffer_size);
+}
+
+size_t cwk_path_join_multiple(const char **paths, char *buffer,
+  size_t buffer_size)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_join_multiple(&ctx, paths, buffer, buffer_size);
+}
+
+void cwk_path_get_root(const char *path, size_t *length)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  cwk_ctx_path_get_root(&ctx, path, length);
+}
+
+size_t cwk_path_change_root(const char *path, const char *new_root,
+  char *buffer, size_t buffer_size)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_change_root(&ctx, path, new_root, buffer, buffer_size);
+}
+
+bool cwk_path_is_absolute(const char *path)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_is_absolute(&ctx, path);
+}
+
+bool cwk_path_is_relative(const char *path)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_is_relative(&ctx, path);
+}
+
+void cwk_path_get_basename(const char *path, const char **basename,
+  size_t *length)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  cwk_ctx_path_get_basename(&ctx, path, basename, length);
+}
+
+size_t cwk_path_change_basename(const char *path, const char *new_basename,
+  char *buffer, size_t buffer_size)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_change_basename(&ctx, path, new_basename, buffer,
+    buffer_size);
+}
+
+void cwk_path_get_dirname(const char *path, size_t *length)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  cwk_ctx_path_get_dirname(&ctx, path, length);
+}
+
+bool cwk_path_get_extension(const char *path, const char **extension,
+  size_t *length)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_get_extension(&ctx, path, extension, length);
+}
+
+bool cwk_path_has_extension(const char *path)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_has_extension(&ctx, path);
+}
+
+size_t cwk_path_change_extension(const char *path, const char *new_extension,
+  char *buffer, size_t buffer_size)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_change_extension(&ctx, path, new_extension, buffer,
+    buffer_size);
+}
+
+size_t cwk_path_normalize(const char *path, char *buffer, size_t buffer_size)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_normalize(&ctx, path, buffer, buffer_size);
+}
+
+size_t cwk_path_normalize_many(const char **paths, size_t count, char *arena,
+  size_t arena_size, struct cwk_span *spans)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_normalize_many(&ctx, paths, count, arena, arena_size,
+    spans);
+}
+
+size_t cwk_path_join_many(const char **paths_a, const char **paths_b,
+  size_t count, char *arena, size_t arena_size, struct cwk_span *spans)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_join_many(&ctx, paths_a, paths_b, count, arena,
+    arena_size, spans);
+}
+
+size_t cwk_path_get_intersection(const char *path_base, const char *path_other)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_get_intersection(&ctx, path_base, path_other);
+}
+
+bool cwk_path_get_first_segment(const char *path, struct cwk_segment *segment)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_get_first_segment(&ctx, path, segment);
+}
+
+bool cwk_path_get_last_segment(const char *path, struct cwk_segment *segment)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_get_last_segment(&ctx, path, segment);
+}
+
+bool cwk_path_get_next_segment(struct cwk_segment *segment)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_get_next_segment(&ctx, segment);
+}
+
+bool cwk_path_get_previous_segment(struct cwk_segment *segment)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_get_previous_segment(&ctx, segment);
+}
+
+bool cwk_path_is_separator(const char *str)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_is_separator(&ctx, str);
+}
+
+size_t cwk_path_change_segment(struct cwk_segment *segment, const char *value,
+  char *buffer, size_t buffer_size)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_change_segment(&ctx, segment, value, buffer, buffer_size);
+}
+
+enum cwk_path_style cwk_path_guess_style(const char *path)
+{
+  struct cwk_ctx ctx = {path_style};
+
+  return cwk_ctx_path_guess_style(&ctx, path);
+}
+
 void cwk_path_set_style(enum cwk_path_style style)
 {
   // We can just set the global path style variable and then the behaviour for
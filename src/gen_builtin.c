@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CONP_IMPLEMENTATION
+#include "conp.h"
+
+#define return_defer(value) do{result = (value); goto defer;}while(0)
+
+#define MAX_DISPLACEMENT (1U << 24)
+#define LICENSES_SECTION "licenses"
+
+// must match builtin_license_hash in the generated header
+uint64_t builtin_hash(const char *s, size_t len, uint32_t seed)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL ^ seed;
+    for (size_t i=0; i<len; ++i){
+        hash ^= (unsigned char) s[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash ^ (hash >> 32);
+}
+
+typedef struct{
+    ConpToken key;
+    char *value;
+} Builtin;
+
+typedef struct{
+    size_t *items;
+    size_t count;
+} Bucket;
+
+int compare_buckets(const void *a, const void *b)
+{
+    size_t ca = ((const Bucket*) a)->count;
+    size_t cb = ((const Bucket*) b)->count;
+    return (ca < cb) - (ca > cb);
+}
+
+/*
+    Hash and displace: the keys are split into buckets by builtin_hash(key, 0),
+    then each bucket, largest first, gets the smallest displacement d for which
+    builtin_hash(key, d) % count sends all of its keys to free slots.
+*/
+bool build_perfect_hash(Builtin *builtins, size_t count, uint32_t *displacements, size_t bucket_count, size_t *slots)
+{
+    bool result = true;
+    Bucket *buckets = calloc(bucket_count, sizeof(*buckets));
+    size_t *bucket_items = calloc(count, sizeof(*bucket_items));
+    bool *taken = calloc(count, sizeof(*taken));
+    size_t *candidate = calloc(count, sizeof(*candidate));
+    if (!buckets || !bucket_items || !taken || !candidate) return_defer(false);
+    for (size_t i=0; i<count; ++i){
+        buckets[builtin_hash(builtins[i].key.start, builtins[i].key.len, 0) % bucket_count].count++;
+    }
+    size_t offset = 0;
+    for (size_t b=0; b<bucket_count; ++b){
+        buckets[b].items = bucket_items + offset;
+        offset += buckets[b].count;
+        buckets[b].count = 0;
+    }
+    for (size_t i=0; i<count; ++i){
+        Bucket *bucket = &buckets[builtin_hash(builtins[i].key.start, builtins[i].key.len, 0) % bucket_count];
+        bucket->items[bucket->count++] = i;
+    }
+    qsort(buckets, bucket_count, sizeof(*buckets), compare_buckets);
+    for (size_t b=0; b<bucket_count && buckets[b].count > 0; ++b){
+        Bucket *bucket = &buckets[b];
+        Builtin *first = &builtins[bucket->items[0]];
+        size_t index = builtin_hash(first->key.start, first->key.len, 0) % bucket_count;
+        uint32_t d;
+        for (d=1; d<MAX_DISPLACEMENT; ++d){
+            size_t n;
+            for (n=0; n<bucket->count; ++n){
+                Builtin *builtin = &builtins[bucket->items[n]];
+                size_t slot = builtin_hash(builtin->key.start, builtin->key.len, d) % count;
+                if (taken[slot]) break;
+                // keys of the same bucket must not collide with each other either
+                size_t k;
+                for (k=0; k<n && candidate[k] != slot; ++k);
+                if (k < n) break;
+                candidate[n] = slot;
+            }
+            if (n == bucket->count) break;
+        }
+        if (d == MAX_DISPLACEMENT) return_defer(false);
+        displacements[index] = d;
+        for (size_t n=0; n<bucket->count; ++n){
+            taken[candidate[n]] = true;
+            slots[candidate[n]] = bucket->items[n];
+        }
+    }
+  defer:
+    free(buckets);
+    free(bucket_items);
+    free(taken);
+    free(candidate);
+    return result;
+}
+
+void write_string(FILE *file, const char *s, size_t len)
+{
+    fputc('"', file);
+    for (size_t i=0; i<len; ++i){
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\') fprintf(file, "\\%c", c);
+        else if (c < 0x20 || c >= 0x7f) fprintf(file, "\\%03o", c);
+        else fputc(c, file);
+    }
+    fputc('"', file);
+}
+
+int main(int argc, char **argv)
+{
+    int result = 0;
+    if (argc != 3){
+        fprintf(stderr, "Usage: %s <config> <header>\n", argv[0]);
+        return 1;
+    }
+    char *config_path = argv[1];
+    char *header_path = argv[2];
+    ConpEntries entries = {0};
+    Builtin *builtins = NULL;
+    uint32_t *displacements = NULL;
+    size_t *slots = NULL;
+    FILE *file = NULL;
+
+    FILE *config = fopen(config_path, "rb");
+    if (config == NULL){
+        fprintf(stderr, "[ERROR] Could not open '%s'!\n", config_path);
+        return 1;
+    }
+    fseek(config, 0, SEEK_END);
+    size_t config_size = ftell(config);
+    rewind(config);
+    char *content = malloc(config_size+1);
+    if (content == NULL || fread(content, 1, config_size, config) != config_size){
+        fprintf(stderr, "[ERROR] Could not read '%s'!\n", config_path);
+        fclose(config);
+        return_defer(1);
+    }
+    fclose(config);
+    // the builtin config has to be complete, parsing stops at the first error, which is reported
+    if (!conp_parse_all(&entries, content, config_size, config_path) || entries.sources[0].failed) return_defer(1);
+
+    // the licenses are read in the order they are resolved at runtime, the [licenses] section before the
+    // entries in front of the first section, later duplicates are shadowed there, so they are dropped here
+    size_t count = 0;
+    builtins = calloc(entries.count+1, sizeof(*builtins));
+    if (builtins == NULL) return_defer(1);
+    char *sections[] = {LICENSES_SECTION, ""};
+    for (size_t s=0; s<conp_arr_len(sections); ++s){
+        for (size_t i=0; i<entries.count; ++i){
+            ConpEntry *entry = &entries.items[i];
+            ConpSection *section = &entries.sections[entry->section];
+            if (section->name_len != strlen(sections[s]) || memcmp(section->name, sections[s], section->name_len) != 0) continue;
+            ConpToken key = conp_entry_key(&entries, entry);
+            // the names are lowercased before they are looked up
+            for (size_t c=0; c<key.len; ++c){
+                if ('A' <= key.start[c] && key.start[c] <= 'Z'){
+                    ConpLoc loc = conp_entries_loc(&entries, entry->source, entry->key.offset);
+                    fprintf(stderr, "[ERROR] "CONP_LOC_FMT" The name of a built-in license must be lowercase, but got '%.*s'!\n", conp_loc_expand(loc), (int) key.len, key.start);
+                    return_defer(1);
+                }
+            }
+            bool duplicate = false;
+            for (size_t j=0; j<count && !duplicate; ++j){
+                duplicate = builtins[j].key.len == key.len && memcmp(builtins[j].key.start, key.start, key.len) == 0;
+            }
+            if (duplicate) continue;
+            ConpToken value = conp_entry_value(&entries, entry);
+            if (value.type != ConpToken_String){
+                ConpLoc loc = conp_entries_loc(&entries, entry->source, entry->value.offset);
+                fprintf(stderr, "[ERROR] "CONP_LOC_FMT" Expected the path of a license as a String, but got %s!\n", conp_loc_expand(loc), ConpTokenTypeNames[value.type]);
+                return_defer(1);
+            }
+            builtins[count].key = key;
+            builtins[count].value = malloc(value.len+1);
+            if (builtins[count].value == NULL || !conp_extract(&value, builtins[count].value, value.len+1)) return_defer(1);
+            count++;
+        }
+    }
+
+    size_t bucket_count = count/2+1;
+    displacements = calloc(bucket_count, sizeof(*displacements));
+    slots = calloc(count+1, sizeof(*slots));
+    if (displacements == NULL || slots == NULL) return_defer(1);
+    if (count > 0 && !build_perfect_hash(builtins, count, displacements, bucket_count, slots)){
+        fprintf(stderr, "[ERROR] Could not find a perfect hash for the %zu keys of '%s'!\n", count, config_path);
+        return_defer(1);
+    }
+
+    file = fopen(header_path, "w");
+    if (file == NULL){
+        fprintf(stderr, "[ERROR] Could not open '%s'!\n", header_path);
+        return_defer(1);
+    }
+    fprintf(file, "// generated by gen_builtin from %s, do not edit\n", config_path);
+    fprintf(file, "#ifndef _LICENSES_BUILTIN_H\n#define _LICENSES_BUILTIN_H\n\n");
+    fprintf(file, "#include <stddef.h>\n#include <stdint.h>\n#include <string.h>\n\n");
+    fprintf(file, "#define BUILTIN_LICENSE_COUNT %zu\n#define BUILTIN_LICENSE_BUCKETS %zu\n\n", count, bucket_count);
+    fprintf(file, "static const uint32_t builtin_license_displacements[BUILTIN_LICENSE_BUCKETS] = {");
+    for (size_t b=0; b<bucket_count; ++b){
+        fprintf(file, "%s%u", (b > 0)? ", ":"", displacements[b]);
+    }
+    fprintf(file, "};\n\n");
+    // the arrays are indexed by slot, an empty config still needs one element
+    fprintf(file, "static const char *const builtin_license_keys[BUILTIN_LICENSE_COUNT+1] = {\n");
+    for (size_t i=0; i<count; ++i){
+        fprintf(file, "    ");
+        write_string(file, builtins[slots[i]].key.start, builtins[slots[i]].key.len);
+        fprintf(file, ",\n");
+    }
+    fprintf(file, "    NULL\n};\n\n");
+    fprintf(file, "static const char *const builtin_license_values[BUILTIN_LICENSE_COUNT+1] = {\n");
+    for (size_t i=0; i<count; ++i){
+        fprintf(file, "    ");
+        write_string(file, builtins[slots[i]].value, strlen(builtins[slots[i]].value));
+        fprintf(file, ",\n");
+    }
+    fprintf(file, "    NULL\n};\n\n");
+    fprintf(file,
+        "static inline uint64_t builtin_license_hash(const char *s, size_t len, uint32_t seed)\n"
+        "{\n"
+        "    uint64_t hash = 0xcbf29ce484222325ULL ^ seed;\n"
+        "    for (size_t i=0; i<len; ++i){\n"
+        "        hash ^= (unsigned char) s[i];\n"
+        "        hash *= 0x100000001b3ULL;\n"
+        "    }\n"
+        "    return hash ^ (hash >> 32);\n"
+        "}\n\n"
+        "// resolve a built-in license to the path of its template, NULL if it is unknown\n"
+        "static inline const char* builtin_license_get(const char *key)\n"
+        "{\n"
+        "    if (BUILTIN_LICENSE_COUNT == 0) return NULL;\n"
+        "    size_t len = strlen(key);\n"
+        "    uint32_t d = builtin_license_displacements[builtin_license_hash(key, len, 0) %% BUILTIN_LICENSE_BUCKETS];\n"
+        "    size_t slot = builtin_license_hash(key, len, d) %% (BUILTIN_LICENSE_COUNT+(BUILTIN_LICENSE_COUNT == 0));\n"
+        "    if (strcmp(builtin_license_keys[slot], key) != 0) return NULL;\n"
+        "    return builtin_license_values[slot];\n"
+        "}\n\n"
+        "#endif // _LICENSES_BUILTIN_H\n");
+    if (fclose(file) != 0){
+        file = NULL;
+        fprintf(stderr, "[ERROR] Could not write '%s'!\n", header_path);
+        return_defer(1);
+    }
+    file = NULL;
+    printf("Generated %s with %zu built-in licenses.\n", header_path, count);
+  defer:
+    if (file != NULL) fclose(file);
+    if (builtins != NULL){
+        for (size_t i=0; i<entries.count; ++i) free(builtins[i].value);
+    }
+    free(builtins);
+    free(displacements);
+    free(slots);
+    conp_entries_free(&entries);
+    free(content);
+    return result;
+}
@@ -3,22 +3,45 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <stdint.h>
 #include <errno.h>
+#include <dirent.h>
 
 #include <cwalk.h>
 
+#define CONP_WITH_THREADS
+#define CONP_WITH_CACHE
 #define CONP_IMPLEMENTATION
 #include "conp.h"
 
+#ifdef LICENSES_BUILTIN
+#include "licenses_builtin.h"
+#else
+#define BUILTIN_LICENSE_COUNT 0
+#define builtin_license_get(key) ((void)(key), (const char*) NULL)
+#endif
+
 #define return_defer(value) do{result = (value); goto defer;}while(0)
     
 #define CONFIG_FILE_NAME "licenses.config"
+#define CACHE_FILE_EXT ".cache"
+#define LICENSES_SECTION "licenses"
+#define ALIASES_SECTION "aliases"
+#define FRAGMENT_DIR_NAME "licenses.d"
+#define FRAGMENT_EXT ".config"
 
 static char temp_buffer[FILENAME_MAX];
 static char exe_dir[FILENAME_MAX];
 
-static ConpEntries config;
+static ConpArena arena;
+static ConpEntries config = {.arena=&arena};
+static ConpCache cache;
+static char cache_path[FILENAME_MAX];
+static ConpSource *sources; // the config followed by its fragments, in the order of precedence
+static size_t source_count;
 
 bool get_exe_path(char *buffer, size_t buffer_size)
 {
@@ -92,17 +115,77 @@ bool create_dir(const char *path)
     return true;
 }
 
+char* str_to_lower(char *buffer)
+{
+    char *r = buffer;
+    char c;
+    while ((c = *r) != '\0'){
+        if (64 < c && c < 91){
+            *r = c | 0x20;
+        }
+        r++;
+    }
+    return buffer;
+}
+
+// licenses are listed in the [licenses] section or in front of the first section
+bool is_license_section(const char *name, size_t name_len)
+{
+    return name_len == 0 || (name_len == strlen(LICENSES_SECTION) && memcmp(name, LICENSES_SECTION, name_len) == 0);
+}
+
 void print_usage(char *program_name)
 {
     printf("Licenses - How to use:\n");
     printf("  %s <license>\n", program_name);
-    if (config.count == 0){
+    printf("  %s --validate [config]   report all errors of the config\n", program_name);
+    // the keys come from the cache if it was valid, otherwise from the parsed config
+    size_t count = (cache.header != NULL)? cache.header->count:config.count;
+    if (count + BUILTIN_LICENSE_COUNT == 0){
         printf("  There are no licenses available.\n");
         return;
     }
     printf("  Currently these licenses are available:\n");
-    for (size_t i=0; i<config.count; ++i){
-        ConpToken key = config.items[i].key;
+#ifdef LICENSES_BUILTIN
+    for (size_t i=0; i<BUILTIN_LICENSE_COUNT; ++i){
+        printf("    - %s\n", builtin_license_keys[i]);
+    }
+#endif
+    for (size_t i=0; i<count; ++i){
+        ConpToken key, value;
+        size_t section_len;
+        if (cache.header != NULL){
+            ConpToken section = conp_cache_section(&cache, i);
+            if (!is_license_section(section.start, section.len)) continue;
+            section_len = section.len;
+            key = conp_cache_key(&cache, i);
+            value = conp_cache_value(&cache, i);
+        }
+        else{
+            ConpSection *section = &config.sections[config.items[i].section];
+            if (!is_license_section(section->name, section->name_len)) continue;
+            section_len = section->name_len;
+            key = conp_entry_key(&config, &config.items[i]);
+        }
+        // config entries are shadowed by built-in licenses of the same name,
+        // entries in front of the first section by the names of the [licenses] section
+        // and later duplicates by the first entry with the same key, ignoring case
+        if (key.len < sizeof(temp_buffer)){
+            memcpy(temp_buffer, key.start, key.len);
+            temp_buffer[key.len] = '\0';
+            str_to_lower(temp_buffer);
+            if (builtin_license_get(temp_buffer) != NULL) continue;
+            if (section_len == 0){
+                ConpToken shadow;
+                if (conp_cache_section_resolve(&cache, LICENSES_SECTION, ALIASES_SECTION, temp_buffer, &shadow)) continue;
+                if (conp_section_resolve(&config, LICENSES_SECTION, temp_buffer) != NULL) continue;
+            }
+            if (cache.header != NULL){
+                ConpToken first;
+                if (!conp_cache_section_resolve(&cache, (section_len == 0)? NULL:LICENSES_SECTION, NULL, temp_buffer, &first) || first.start != value.start) continue;
+            }
+            else if (conp_section_resolve(&config, (section_len == 0)? NULL:LICENSES_SECTION, temp_buffer) != &config.items[i]) continue;
+        }
         printf("    - %.*s\n", (int)key.len, key.start);
     }
 }
@@ -116,25 +199,20 @@ char* shift_args(int *argc, char ***argv)
 	return result;
 }
 
-char* str_to_lower(char *buffer)
-{
-    char *r = buffer;
-    char c;
-    while ((c = *r) != '\0'){
-        if (64 < c && c < 91){
-            *r = c | 0x20;
-        }
-        r++;
+unsigned long long file_size(const char* file_path){
+    struct stat file;
+    if (stat(file_path, &file) == -1){
+        return 0;
     }
-    return buffer;
+    return (unsigned long long) file.st_size;
 }
 
-unsigned long long file_size(const char* file_path){
+int64_t file_mtime(const char* file_path){
     struct stat file;
     if (stat(file_path, &file) == -1){
         return 0;
     }
-    return (unsigned long long) file.st_size;
+    return (int64_t) file.st_mtime;
 }
 
 // allocate and populate a string with the file's content
@@ -154,6 +232,35 @@ char* read_entire_file(char *file_path)
     return content;
 }
 
+// map a file read-only into memory, the content is not null-terminated
+char* map_entire_file(char *file_path, size_t *size)
+{
+    if (file_path == NULL || size == NULL) return NULL;
+    int fd = open(file_path, O_RDONLY);
+    if (fd == -1) return NULL;
+    struct stat file;
+    if (fstat(fd, &file) == -1){
+        close(fd);
+        return NULL;
+    }
+    *size = (size_t) file.st_size;
+    if (*size == 0){
+        // mmap rejects empty mappings
+        close(fd);
+        return "";
+    }
+    char *content = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (content == MAP_FAILED) return NULL;
+    return content;
+}
+
+void unmap_file(char *content, size_t size)
+{
+    if (content == NULL || size == 0) return;
+    munmap(content, size);
+}
+
 int write_license(char *filepath)
 {
     int result = 0;
@@ -180,9 +287,145 @@ int write_license(char *filepath)
     return result;
 }
 
+// report every error of a config at once
+int validate_config(char *config_path)
+{
+    size_t config_size;
+    char *config_content = map_entire_file(config_path, &config_size);
+    if (config_content == NULL){
+        fprintf(stderr, "[ERROR] Could not read '%s'!\n", config_path);
+        return 1;
+    }
+    ConpDiagnostics diagnostics = {0};
+    bool valid = conp_validate(config_content, config_size, config_path, &diagnostics);
+    conp_diagnostics_print(&diagnostics, stderr);
+    if (valid) printf("'%s' is valid.\n", config_path);
+    else fprintf(stderr, "'%s' contains %zu error%s.\n", config_path, diagnostics.count, (diagnostics.count == 1)? "":"s");
+    conp_diagnostics_free(&diagnostics);
+    unmap_file(config_content, config_size);
+    return valid? 0:1;
+}
+
+int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+// map the config and the *.config fragments of licenses.d behind it, the fragments in lexical order of their names
+bool load_sources(char *config_content, size_t config_size)
+{
+    bool result = true;
+    char **names = NULL;
+    size_t count = 0;
+    char dir_path[FILENAME_MAX];
+    cwk_path_join(get_config_path(), FRAGMENT_DIR_NAME, dir_path, sizeof(dir_path));
+    DIR *dir = opendir(dir_path);
+    if (dir != NULL){
+        struct dirent *file;
+        size_t ext_len = strlen(FRAGMENT_EXT);
+        while ((file = readdir(dir)) != NULL){
+            size_t len = strlen(file->d_name);
+            if (len <= ext_len || strcmp(file->d_name+len-ext_len, FRAGMENT_EXT) != 0) continue;
+            names = realloc(names, (count+1)*sizeof(*names));
+            assert(names != NULL && "Need more RAM!");
+            names[count++] = strdup(file->d_name);
+        }
+        closedir(dir);
+        qsort(names, count, sizeof(*names), compare_names);
+    }
+    sources = calloc(count+1, sizeof(*sources));
+    assert(sources != NULL && "Need more RAM!");
+    sources[source_count++] = (ConpSource) {.buffer=config_content, .buffer_size=config_size, .name=CONFIG_FILE_NAME};
+    for (size_t i=0; i<count; ++i){
+        char path[FILENAME_MAX];
+        cwk_path_join(dir_path, names[i], path, sizeof(path));
+        if (!isfile(path)) continue;
+        ConpSource *source = &sources[source_count];
+        source->buffer = map_entire_file(path, &source->buffer_size);
+        if (source->buffer == NULL){
+            fprintf(stderr, "[ERROR] Could not read fragment '%s'!\n", path);
+            return_defer(false);
+        }
+        // diagnostics name the fragment relative to the licenses directory
+        size_t name_size = strlen(FRAGMENT_DIR_NAME) + strlen(names[i]) + 2;
+        source->name = malloc(name_size);
+        assert(source->name != NULL && "Need more RAM!");
+        snprintf(source->name, name_size, FRAGMENT_DIR_NAME"/%s", names[i]);
+        source_count++;
+    }
+  defer:
+    for (size_t i=0; i<count; ++i) free(names[i]);
+    free(names);
+    return result;
+}
+
+void unload_sources(void)
+{
+    // the config itself is unmapped by main
+    for (size_t i=1; i<source_count; ++i){
+        unmap_file(sources[i].buffer, sources[i].buffer_size);
+        free(sources[i].name);
+    }
+    free(sources);
+}
+
+// the [licenses] sections of all sources take precedence over the entries in front of their first sections,
+// within the same section the first source that contains the license wins, then the first alias of that name
+// (the same order as conp_section_resolve)
+bool find_license(char *license, ConpToken *token)
+{
+    char *sections[] = {LICENSES_SECTION, NULL};
+    for (size_t s=0; s<conp_arr_len(sections); ++s){
+        for (size_t i=0; i<source_count; ++i){
+            if (conp_find_nocase(sources[i].buffer, sources[i].buffer_size, sources[i].name, sections[s], license, token)) return true;
+        }
+        ConpToken alias;
+        char buffer[256];
+        for (size_t i=0; i<source_count; ++i){
+            if (!conp_find_nocase(sources[i].buffer, sources[i].buffer_size, sources[i].name, ALIASES_SECTION, license, &alias)) continue;
+            // only the first alias counts, even if it names no license of this section
+            if (alias.type != ConpToken_String && alias.type != ConpToken_Field) break;
+            // unescaping never makes the value longer, so an alias that does not fit the buffer is extracted to the heap
+            char *target = (alias.len < sizeof(buffer))? buffer:malloc(alias.len+1);
+            assert(target != NULL && "Need more RAM!");
+            (void) conp_extract(&alias, target, alias.len+1);
+            bool found = false;
+            for (size_t j=0; j<source_count && !found; ++j){
+                found = conp_find_nocase(sources[j].buffer, sources[j].buffer_size, sources[j].name, sections[s], target, token);
+            }
+            if (target != buffer) free(target);
+            if (found) return true;
+            break;
+        }
+    }
+    return false;
+}
+
+// write the license whose path is the value of a config entry
+int write_license_entry(ConpToken *token)
+{
+    if (!conp_extract(token, temp_buffer, FILENAME_MAX)) return 1;
+    cwk_path_normalize(temp_buffer, temp_buffer, sizeof(temp_buffer));
+    return write_license(temp_buffer);
+}
+
 int main(int argc, char **argv)
 {
     int result;
+    ConpToken token;
+    ConpEntry *entry;
+    char *program_name = shift_args(&argc, &argv);
+    char *license_input = (argc > 0)? str_to_lower(shift_args(&argc, &argv)):NULL;
+    if (license_input != NULL && strcmp(license_input, "--validate") == 0){
+        return validate_config((argc > 0)? shift_args(&argc, &argv):get_config_file_path());
+    }
+    // built-in licenses are resolved without loading the config at all
+    const char *builtin = (license_input != NULL)? builtin_license_get(license_input):NULL;
+    if (builtin != NULL){
+        char license_path[FILENAME_MAX];
+        cwk_path_join(get_config_path(), builtin, license_path, sizeof(license_path));
+        return write_license(license_path);
+    }
     // create config files
     char *config_path = get_config_path();
     if (!isdir(config_path)){
@@ -195,36 +438,57 @@ int main(int argc, char **argv)
         printf("Created config file at '%s'.\n", config_path);
     }
     
-    char *config_content = read_entire_file(config_path);
+    size_t config_size;
+    char *config_content = map_entire_file(config_path, &config_size);
     if (config_content == NULL){
         fprintf(stderr, "Failed to read config file!\n");
         return 1;
     }
 
-    if (!conp_parse_all(&config, config_content, strlen(config_content), CONFIG_FILE_NAME)){
-        fprintf(stderr, "Failed to parse config!\n");
-        return_defer(1);
+    // config_path points into temp_buffer, which load_sources reuses
+    int64_t config_mtime = file_mtime(config_path);
+    snprintf(cache_path, sizeof(cache_path), "%s"CACHE_FILE_EXT, config_path);
+    if (!load_sources(config_content, config_size)) return_defer(1);
+
+    // use the compiled cache next to the config, or parse the config and rebuild the cache,
+    // the cache only covers licenses.config, so it is not used as long as there are fragments
+    if (source_count > 1 || !conp_cache_open(&cache, cache_path, config_content, config_size, config_mtime)){
+        // with fragments there is no cache to rebuild, so a single license is looked up directly
+        // and the whole config is only parsed if the usage is needed
+        if (source_count > 1 && license_input != NULL && strcmp(license_input, "-h") != 0 && find_license(license_input, &token)){
+            return_defer(write_license_entry(&token));
+        }
+        // a single config is split into chunks, fragments are parsed concurrently and merged in order
+        bool parsed = (source_count == 1)? conp_parse_all_parallel(&config, config_content, config_size, CONFIG_FILE_NAME, 0)
+                                         : conp_parse_sources(&config, sources, source_count, 0);
+        if (!parsed){
+            fprintf(stderr, "Failed to parse config!\n");
+            return_defer(1);
+        }
+        // a cache would hide the errors of the config from later runs, so it is only written for a clean one
+        if (source_count == 1 && !config.sources[0].failed) (void) conp_cache_write(&config, cache_path, config_content, config_size, config_mtime);
+        (void) conp_section_names(&config, LICENSES_SECTION, ALIASES_SECTION);
+        (void) conp_section_names(&config, NULL, ALIASES_SECTION);
     }
-    char *program_name = shift_args(&argc, &argv);
-    if (argc < 1){
+    if (license_input == NULL){
         fprintf(stderr, "[ERROR] No license provided!\n");
         print_usage(program_name);
         return_defer(1);
     }
-    char *license_input = str_to_lower(shift_args(&argc, &argv));
     if (strcmp(license_input, "-h") == 0){
         print_usage(program_name);
         return_defer(0);
     }
-    else if (conp_entries_iskey(&config, license_input)){
-        ConpToken token;
-        if (!conp_entries_get(&config, license_input, &token)){
-            fprintf(stderr, "Config changed during runtime!\n");
-            return_defer(1);
-        }
-        if (!conp_extract(&token, temp_buffer, FILENAME_MAX)) return_defer(1);
-	cwk_path_normalize(temp_buffer, temp_buffer, sizeof(temp_buffer));
-        return write_license(temp_buffer);
+    // the [licenses] section takes precedence over entries in front of the first section,
+    // names are compared ignoring case and the keys of a section over the [aliases] that lead to it
+    else if (conp_cache_section_resolve(&cache, LICENSES_SECTION, ALIASES_SECTION, license_input, &token)
+             || conp_cache_section_resolve(&cache, NULL, ALIASES_SECTION, license_input, &token)){
+        return_defer(write_license_entry(&token));
+    }
+    else if ((entry = conp_section_resolve(&config, LICENSES_SECTION, license_input)) != NULL
+             || (entry = conp_section_resolve(&config, NULL, license_input)) != NULL){
+        token = conp_entry_value(&config, entry);
+        return_defer(write_license_entry(&token));
     }
     else{
         fprintf(stderr, "[ERROR] Unknown license: \"%s\"!\n", license_input);
@@ -232,7 +496,10 @@ int main(int argc, char **argv)
         return_defer(1);
     }
   defer:
-    free(config_content);
-    free(config.items);
+    conp_cache_close(&cache);
+    unload_sources();
+    unmap_file(config_content, config_size);
+    conp_entries_free(&config);
+    conp_arena_free(&arena);
     return result;
 }
@@ -0,0 +1,28 @@
+set -e
+gcc -Wall -Wextra -Werror -g -fsanitize=address,undefined -Iinclude -o tests/test_update tests/test_update.c
+# the parse errors of the invalid edits are expected
+./tests/test_update 2>/dev/null
+gcc -Wall -Wextra -Werror -g -fsanitize=address,undefined -Iinclude -o tests/test_lexer tests/test_lexer.c
+./tests/test_lexer
+# the AVX2 kernels are only compiled in with -mavx2
+if grep -q avx2 /proc/cpuinfo 2>/dev/null; then
+    gcc -Wall -Wextra -Werror -g -mavx2 -fsanitize=address,undefined -Iinclude -o tests/test_lexer_avx2 tests/test_lexer.c
+    ./tests/test_lexer_avx2
+fi
+gcc -Wall -Wextra -Werror -g -fsanitize=address,undefined -Iinclude -o tests/test_stream tests/test_stream.c
+./tests/test_stream 2>/dev/null
+gcc -Wall -Wextra -Werror -g -fsanitize=address,undefined -Iinclude -o tests/test_parse tests/test_parse.c -pthread
+# the parse errors of the invalid configs are expected
+./tests/test_parse 2>/dev/null
+gcc -Wall -Wextra -Werror -g -fsanitize=address,undefined -Iinclude -o tests/test_double tests/test_double.c -lm
+./tests/test_double
+gcc -Wall -Wextra -Werror -g -O1 -fsanitize=thread -Iinclude -o tests/test_shared tests/test_shared.c -pthread
+./tests/test_shared
+# the contexts must not touch the global style, which the main thread keeps switching
+gcc -Wall -Wextra -Werror -g -O1 -fsanitize=thread -Iinclude -o tests/test_cwalk_ctx tests/test_cwalk_ctx.c src/cwalk.c -pthread
+./tests/test_cwalk_ctx
+gcc -Wall -Wextra -Werror -g -fsanitize=address,undefined -Iinclude -o tests/test_cwalk tests/test_cwalk.c src/cwalk.c
+./tests/test_cwalk
+gcc -Wall -Wextra -Werror -g -fsanitize=address,undefined -Iinclude -o tests/test_intern tests/test_intern.c src/cwalk.c
+./tests/test_intern
+sh tests/usage.sh
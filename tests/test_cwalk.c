@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <cwalk.h>
+
+#define PATHS 20000
+#define MAX_PATH_SIZE 4096
+#define MAX_BATCH 16
+
+/*
+    The length returned by cwk_ctx_path_normalize, cwk_ctx_path_join_multiple
+    and cwk_ctx_path_get_absolute must not depend on the size of the buffer,
+    and whatever fits into a short buffer must be the start of the full result.
+    Every path is checked with no buffer at all, with buffers that cut the
+    result at every length and with a buffer that is large enough, in both
+    styles. The paths are copied into buffers of their exact size, so
+    -fsanitize=address reports the separator search reading past their end.
+    cwk_ctx_path_normalize_many and cwk_ctx_path_join_many have to write the
+    same results as the single calls one after another into an arena of the
+    exact size, into a too small one, where the spans and the returned size
+    still have to be those of the full results, and into no arena at all.
+*/
+
+static unsigned long long state = 1;
+
+unsigned rnd(void)
+{
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+// roots, separators, current and back segments of both styles
+static const char *pieces[] = {
+    "a", "bb", ".", "..", "/", "\\", "C:", "x:", "//", "x.y", "\\\\srv\\sh\\", "\\\\?\\", "/", "..",
+    "a_directory_name_longer_than_a_few_vector_blocks_0123456789abcdefghijklmnopq",
+};
+
+void random_path(char *buffer, size_t max_pieces)
+{
+    buffer[0] = '\0';
+    for (size_t n=rnd()%(max_pieces+1); n>0; --n) strcat(buffer, pieces[rnd()%(sizeof(pieces)/sizeof(*pieces))]);
+}
+
+typedef struct{
+    const struct cwk_ctx *ctx;
+    const char *paths[4]; // the second one is the path of cwk_ctx_path_get_absolute
+} Input;
+
+size_t run_normalize(Input *input, char *buffer, size_t buffer_size)
+{
+    return cwk_ctx_path_normalize(input->ctx, input->paths[0], buffer, buffer_size);
+}
+
+size_t run_join(Input *input, char *buffer, size_t buffer_size)
+{
+    return cwk_ctx_path_join_multiple(input->ctx, input->paths, buffer, buffer_size);
+}
+
+size_t run_absolute(Input *input, char *buffer, size_t buffer_size)
+{
+    return cwk_ctx_path_get_absolute(input->ctx, input->paths[0], input->paths[1], buffer, buffer_size);
+}
+
+typedef struct{
+    const char *name;
+    size_t (*run)(Input *input, char *buffer, size_t buffer_size);
+} Function;
+
+static const Function functions[] = {
+    {"normalize", run_normalize},
+    {"join", run_join},
+    {"get_absolute", run_absolute},
+};
+
+bool check_sizes(const Function *function, Input *input)
+{
+    static char full[MAX_PATH_SIZE], cut[MAX_PATH_SIZE];
+    size_t length = function->run(input, full, sizeof(full));
+    if (length >= sizeof(full)) return true;
+    for (size_t size=0; size<=length+1; ++size){
+        memset(cut, '#', sizeof(cut));
+        size_t cut_length = function->run(input, (size > 0)? cut:NULL, size);
+        bool same = cut_length == length;
+        if (size > 0) same = same && memcmp(cut, full, size-1) == 0 && cut[size-1] == ((size > length)? full[size-1]:'\0');
+        if (!same){
+            printf("[FAIL] cwalk: %s in %s style of '%s', '%s', '%s' returned %zu with %zu bytes instead of %zu ('%s')\n",
+                   function->name, (input->ctx->style == CWK_STYLE_WINDOWS)? "windows":"unix", input->paths[0],
+                   (input->paths[1] != NULL)? input->paths[1]:"", (input->paths[1] != NULL && input->paths[2] != NULL)? input->paths[2]:"",
+                   cut_length, size, length, full);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool check_result(const Function *function, Input *input, const char *expected)
+{
+    char buffer[MAX_PATH_SIZE];
+    size_t length = function->run(input, buffer, sizeof(buffer));
+    if (length != strlen(expected) || strcmp(buffer, expected) != 0){
+        printf("[FAIL] cwalk: %s returned '%s' (%zu) instead of '%s'\n", function->name, buffer, length, expected);
+        return false;
+    }
+    return check_sizes(function, input);
+}
+
+// "d0/d1/.../../..", deeper than the sizes kept on the stack while the buffer is too short
+bool check_deep(const struct cwk_ctx *ctx)
+{
+    static char path[MAX_PATH_SIZE];
+    size_t pos = 0;
+    for (size_t i=0; i<200; ++i) pos += sprintf(path+pos, "d%zu/", i);
+    for (size_t i=0; i<150; ++i) pos += sprintf(path+pos, "../");
+    pos += sprintf(path+pos, "e/../f");
+    Input input = {.ctx=ctx, .paths={path, NULL}};
+    return check_sizes(&functions[0], &input);
+}
+
+typedef struct{
+    const struct cwk_ctx *ctx;
+    const char *paths_a[MAX_BATCH];
+    const char *paths_b[MAX_BATCH]; // NULL normalizes paths_a instead of joining
+    size_t count;
+} Batch;
+
+size_t run_many(Batch *batch, char *arena, size_t arena_size, struct cwk_span *spans)
+{
+    if (batch->paths_b[0] == NULL) return cwk_ctx_path_normalize_many(batch->ctx, batch->paths_a, batch->count, arena, arena_size, spans);
+    return cwk_ctx_path_join_many(batch->ctx, batch->paths_a, batch->paths_b, batch->count, arena, arena_size, spans);
+}
+
+bool check_arena(Batch *batch, size_t arena_size, bool null_arena)
+{
+    static char expected[MAX_BATCH][MAX_PATH_SIZE];
+    struct cwk_span spans[MAX_BATCH];
+    size_t total = 0;
+    for (size_t i=0; i<batch->count; ++i){
+        size_t length = (batch->paths_b[0] == NULL)? cwk_ctx_path_normalize(batch->ctx, batch->paths_a[i], expected[i], MAX_PATH_SIZE)
+                                                   : cwk_ctx_path_join(batch->ctx, batch->paths_a[i], batch->paths_b[i], expected[i], MAX_PATH_SIZE);
+        total += length+1;
+    }
+    if (arena_size > total) arena_size = total;
+    // the arena has its exact size, so -fsanitize=address reports any write past its end
+    char *arena = null_arena? NULL:malloc(arena_size > 0? arena_size:1);
+    if (null_arena) arena_size = 0;
+    size_t size = run_many(batch, arena, arena_size, spans);
+    bool same = size == total;
+    size_t offset = 0;
+    for (size_t i=0; i<batch->count && same; ++i){
+        size_t length = strlen(expected[i]);
+        same = spans[i].offset == offset && spans[i].length == length;
+        // the results that end inside the arena are complete, the one that is cut ends with a null-terminating character
+        if (same && offset+length < arena_size) same = memcmp(arena+offset, expected[i], length+1) == 0;
+        else if (same && offset < arena_size) same = memcmp(arena+offset, expected[i], arena_size-offset-1) == 0 && arena[arena_size-1] == '\0';
+        offset += length+1;
+    }
+    if (!same){
+        printf("[FAIL] cwalk: %s_many of %zu paths in %s style with %s arena of %zu bytes returned %zu instead of %zu\n",
+               (batch->paths_b[0] == NULL)? "normalize":"join", batch->count, (batch->ctx->style == CWK_STYLE_WINDOWS)? "windows":"unix",
+               null_arena? "a NULL":"an", arena_size, size, total);
+        for (size_t i=0; i<batch->count; ++i) printf("  '%s' '%s' -> '%s'\n", batch->paths_a[i], (batch->paths_b[0] != NULL)? batch->paths_b[i]:"", expected[i]);
+    }
+    free(arena);
+    return same;
+}
+
+// every batch in an exact, a too small, an empty and no arena
+bool check_many(Batch *batch)
+{
+    size_t total = run_many(batch, NULL, 0, (struct cwk_span[MAX_BATCH]) {0});
+    return check_arena(batch, total, false) && check_arena(batch, (total > 0)? rnd()%total:0, false)
+           && check_arena(batch, 0, false) && check_arena(batch, 0, true);
+}
+
+int main(int argc, char **argv)
+{
+    state = (argc > 1)? strtoull(argv[1], NULL, 10):1;
+    struct cwk_ctx windows = {CWK_STYLE_WINDOWS}, posix = {CWK_STYLE_UNIX};
+    const struct cwk_ctx *styles[] = {&windows, &posix};
+
+    // the roots of later paths used to be counted as segments if the buffer was too short
+    Input absolute = {.ctx=&windows, .paths={"x:bb\\", "bb\\.\\", NULL}};
+    Input joined = {.ctx=&windows, .paths={"///..", "\\\\srv\\sh\\//.\\", "///..", NULL}};
+    if (!check_result(&functions[2], &absolute, "\\bb\\bb")) return 1;
+    if (!check_result(&functions[1], &joined, "\\\\\\..")) return 1;
+    for (size_t s=0; s<2; ++s){
+        if (!check_deep(styles[s])) return 1;
+    }
+
+    // empty paths, results that are only back segments and joins with absolute second paths
+    Batch normalized = {.ctx=&posix, .paths_a={"", "a/../..", "..", "/a/./b/", "", "a//b/../../../c"}, .count=6};
+    Batch joins = {.ctx=&posix, .paths_a={"a", "", "a/b", "/x", "", "a"}, .paths_b={"/b", "", "../../..", "/y/../z", "/abs", ""}, .count=6};
+    Batch windows_joins = {.ctx=&windows, .paths_a={"C:\\a", "a", "\\\\srv\\sh", ""}, .paths_b={"\\b", "C:\\b", "..\\..", ".."}, .count=4};
+    if (!check_many(&normalized) || !check_many(&joins) || !check_many(&windows_joins)) return 1;
+    if (!check_many(&(Batch) {.ctx=&posix, .count=0})) return 1;
+
+    static char paths[3][1024];
+    for (size_t i=0; i<PATHS; ++i){
+        random_path(paths[0], 12);
+        random_path(paths[1], 6);
+        random_path(paths[2], 3);
+        char *copies[3];
+        for (size_t p=0; p<3; ++p){
+            copies[p] = malloc(strlen(paths[p])+1);
+            strcpy(copies[p], paths[p]);
+        }
+        Input input = {.ctx=styles[i%2], .paths={copies[0], copies[1], copies[2], NULL}};
+        for (size_t f=0; f<sizeof(functions)/sizeof(*functions); ++f){
+            if (!check_sizes(&functions[f], &input)) return 1;
+        }
+        for (size_t p=0; p<3; ++p) free(copies[p]);
+    }
+
+    static char batch_paths[2][MAX_BATCH][256];
+    for (size_t i=0; i<PATHS/10; ++i){
+        Batch batch = {.ctx=styles[i%2], .count=rnd()%(MAX_BATCH+1)};
+        bool join = rnd()%2;
+        for (size_t j=0; j<batch.count; ++j){
+            random_path(batch_paths[0][j], 3);
+            random_path(batch_paths[1][j], 3);
+            batch.paths_a[j] = batch_paths[0][j];
+            batch.paths_b[j] = join? batch_paths[1][j]:NULL;
+        }
+        if (!check_many(&batch)) return 1;
+    }
+    printf("[OK] cwalk\n");
+    return 0;
+}
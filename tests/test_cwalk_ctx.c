@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <cwalk.h>
+
+#define THREADS 8
+#define ROUNDS 200
+#define PATHS 64
+#define MAX_PATH_SIZE 512
+
+/*
+    THREADS threads normalize, join and resolve the same PATHS paths at the
+    same time, every other one with a Windows and a Unix context, while the
+    main thread keeps switching the global style with cwk_path_set_style.
+    Every result has to be the one a single thread computed up front with the
+    same context. The cwk_ctx_path_* functions must not touch the global
+    style, so the build with -fsanitize=thread reports any access to it as a
+    race with the main thread.
+*/
+
+static unsigned long long state = 1;
+
+unsigned rnd(void)
+{
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+// roots, separators, current and back segments of both styles
+static const char *pieces[] = {
+    "a", "bb", ".", "..", "/", "\\", "C:", "//", "x.y", "\\\\srv\\sh\\", "/", "..",
+};
+
+static const struct cwk_ctx contexts[] = {{CWK_STYLE_WINDOWS}, {CWK_STYLE_UNIX}};
+static char paths[PATHS][MAX_PATH_SIZE];
+static char expected[2][PATHS][3][MAX_PATH_SIZE];
+static size_t finished;
+static size_t failures[THREADS];
+
+// the normalized path i, joined with the next one and resolved against a base
+void run(const struct cwk_ctx *ctx, size_t i, char results[3][MAX_PATH_SIZE])
+{
+    cwk_ctx_path_normalize(ctx, paths[i], results[0], MAX_PATH_SIZE);
+    cwk_ctx_path_join(ctx, paths[i], paths[(i+1)%PATHS], results[1], MAX_PATH_SIZE);
+    cwk_ctx_path_get_absolute(ctx, "/base/dir", paths[i], results[2], MAX_PATH_SIZE);
+}
+
+void* worker(void *arg)
+{
+    size_t id = (size_t) arg;
+    size_t style = id%2;
+    char results[3][MAX_PATH_SIZE];
+    for (size_t round=0; round<ROUNDS; ++round){
+        for (size_t i=0; i<PATHS; ++i){
+            run(&contexts[style], i, results);
+            for (size_t r=0; r<3; ++r){
+                if (strcmp(results[r], expected[style][i][r]) != 0) failures[id]++;
+            }
+        }
+    }
+    __atomic_add_fetch(&finished, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long long seed = (argc > 1)? strtoull(argv[1], NULL, 10):1;
+    state = seed;
+    for (size_t i=0; i<PATHS; ++i){
+        for (size_t n=1+rnd()%8; n>0; --n) strcat(paths[i], pieces[rnd()%(sizeof(pieces)/sizeof(*pieces))]);
+    }
+    for (size_t style=0; style<2; ++style){
+        for (size_t i=0; i<PATHS; ++i) run(&contexts[style], i, expected[style][i]);
+    }
+
+    pthread_t threads[THREADS];
+    for (size_t i=0; i<THREADS; ++i){
+        if (pthread_create(&threads[i], NULL, worker, (void*) i) != 0){
+            printf("[FAIL] cwalk_ctx: could not start thread %zu\n", i);
+            return 1;
+        }
+    }
+    // the global style is written without any synchronization
+    size_t switches = 0;
+    while (__atomic_load_n(&finished, __ATOMIC_ACQUIRE) < THREADS){
+        cwk_path_set_style((switches++%2)? CWK_STYLE_UNIX:CWK_STYLE_WINDOWS);
+    }
+    for (size_t i=0; i<THREADS; ++i) pthread_join(threads[i], NULL);
+
+    for (size_t i=0; i<THREADS; ++i){
+        if (failures[i] > 0){
+            printf("[FAIL] cwalk_ctx: seed %llu, thread %zu got %zu wrong results\n", seed, i, failures[i]);
+            return 1;
+        }
+    }
+    printf("[OK] cwalk_ctx (%zu style switches)\n", switches);
+    return 0;
+}
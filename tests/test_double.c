@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONP_IMPLEMENTATION
+#include "conp.h"
+
+#define ROUNDS 200000
+
+/*
+    conp__parse_double is compared bit for bit with strtod, which rounds
+    correctly in glibc: fixed edge cases (subnormals, halfway ties, 19 and 20
+    digit mantissas, large exponents and overflow), random doubles printed
+    with every precision and random digit strings with random exponents.
+*/
+
+static unsigned long long state = 1;
+
+unsigned rnd(void)
+{
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+static const char *cases[] = {
+    "0", "-0", "0.0", "-0.0", "+0", ".0", "0.", "0e0", "0e999999999", "-0e-999999999", "000000000000000000000000.000000",
+    "1", "-1", "+1", "1.", ".5", "5.", "1.5", "-1.5", "0.1", "0.2", "0.3", "1e0", "1E1", "1e+1", "1e-1", "123.456e2",
+    // the fast path ends at 1e22 and 2^53
+    "1e22", "1e23", "1e-22", "1e-23", "9007199254740992", "9007199254740993", "9007199254740994", "9007199254740995",
+    "9007199254740992e22", "9007199254740993e-22", "4503599627370497.5",
+    // halfway between two doubles, ties to even, and just beside the halfway point
+    "1.00000000000000011102230246251565404236316680908203125",
+    "1.00000000000000011102230246251565404236316680908203124",
+    "1.00000000000000011102230246251565404236316680908203126",
+    "1.00000000000000033306690738754696212708950042724609375",
+    "9007199254740993.0000000000000000000000000000000000001",
+    "9007199254740992.9999999999999999999999999999999999999",
+    "2.2250738585072011e-308", "2.2250738585072012e-308", "2.2250738585072014e-308",
+    // 19 and 20 digit mantissas around the limits of 64 bits
+    "9223372036854775807", "9223372036854775808", "-9223372036854775808", "18446744073709551615", "18446744073709551616",
+    "12345678901234567890", "99999999999999999999", "1234567890123456789.5", "0.12345678901234567890",
+    "1844674407370955161.5", "10000000000000000000", "10000000000000000001e-20",
+    // subnormals
+    "4.9406564584124654e-324", "5e-324", "4e-324", "3e-324", "2.5e-324",
+    "2.4703282292062327e-324", "2.4703282292062328e-324", "2.47032822920623272088e-324", "2.47032822920623272089e-324",
+    "1e-320", "1.5e-315", "2.2250738585072009e-308", "1e-324", "1e-330", "1e-400", "1e-100000", "1e-999999999999",
+    "0.000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000001e-230",
+    // large exponents and overflow
+    "1e300", "1e308", "1.7976931348623157e308", "1.7976931348623158e308", "1.7976931348623159e308",
+    "1.797693134862315708145274237317043567981e308", "1.797693134862315808145274237317043567981e308", "-1.7976931348623159e308",
+    "1e309", "1e310", "1e400", "-1e400", "1e100000", "1e999999999999", "0.0000000000000000000000000001e330",
+    "100000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000e200",
+};
+
+bool check(const char *s)
+{
+    size_t len = strlen(s);
+    bool overflow;
+    double value = conp__parse_double(s, len, &overflow);
+    char *end;
+    errno = 0;
+    double expected = strtod(s, &end);
+    bool expected_overflow = errno == ERANGE && isinf(expected);
+    assert(end == s+len && "Not a number!");
+    uint64_t a, b;
+    memcpy(&a, &value, sizeof(a));
+    memcpy(&b, &expected, sizeof(b));
+    if (a != b || overflow != expected_overflow){
+        printf("[FAIL] double: '%s' is %a%s instead of %a%s\n", s, value, overflow? " (overflow)":"", expected, expected_overflow? " (overflow)":"");
+        return false;
+    }
+    return true;
+}
+
+// a random double written with a random precision
+void random_printed(char *buffer, size_t buffer_size)
+{
+    uint64_t bits = ((uint64_t) rnd() << 32) ^ rnd();
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    if (isnan(value) || isinf(value)) value = 1.0;
+    const char *formats[] = {"%.*e", "%.*g", "%.*f"};
+    size_t format = rnd()%conp_arr_len(formats);
+    // %f of a large double would not fit
+    if (format == 2 && fabs(value) >= 1e30) format = 0;
+    snprintf(buffer, buffer_size, formats[format], (int) (rnd()%20), value);
+}
+
+// random digits with a random point and exponent, also far more digits than fit into a double
+void random_digits(char *buffer)
+{
+    size_t len = 0;
+    if (rnd()%2) buffer[len++] = (rnd()%2)? '-':'+';
+    size_t count = 1 + ((rnd()%4)? rnd()%25:rnd()%800);
+    size_t point = rnd()%(count+1);
+    for (size_t i=0; i<count; ++i){
+        if (i == point && rnd()%2) buffer[len++] = '.';
+        // runs of nines and zeros end up close to halfway points
+        unsigned kind = rnd()%4;
+        buffer[len++] = (kind == 0)? '9':(kind == 1)? '0':'0'+rnd()%10;
+    }
+    if (rnd()%2) len += sprintf(buffer+len, "e%d", (int) (rnd()%720) - 360 - (int) count/2);
+    buffer[len] = '\0';
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long long seed = (argc > 1)? strtoull(argv[1], NULL, 10):1;
+    state = seed;
+    for (size_t i=0; i<conp_arr_len(cases); ++i){
+        if (!check(cases[i])) return 1;
+    }
+    char buffer[1024];
+    for (size_t round=0; round<ROUNDS; ++round){
+        if (rnd()%2) random_printed(buffer, sizeof(buffer));
+        else random_digits(buffer);
+        if (!check(buffer)){
+            printf("[FAIL] double: seed %llu, round %zu\n", seed, round);
+            return 1;
+        }
+    }
+    printf("[OK] double\n");
+    return 0;
+}
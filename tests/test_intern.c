@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <cwalk.h>
+
+#define PATHS 100000
+#define MAX_PATH_SIZE 256
+
+/*
+    Paths which cwk_path_normalize turns into the same path must get the same
+    id from cwk_intern_add, all others a new one. The groups below are added
+    in both styles, and random paths are compared with their normalized
+    version. The pool has to contain every distinct path exactly once, so its
+    size is the sum of their lengths with one '\0' each.
+*/
+
+static unsigned long long state = 1;
+
+unsigned rnd(void)
+{
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+// roots, separators, current and back segments of both styles
+static const char *pieces[] = {
+    "a", "bb", "A", ".", "..", "/", "\\", "C:", "x:", "//", "x.y", "\\\\srv\\sh\\", "\\\\?\\", "/", "..",
+};
+
+void random_path(char *buffer, size_t max_pieces)
+{
+    buffer[0] = '\0';
+    for (size_t n=rnd()%(max_pieces+1); n>0; --n) strcat(buffer, pieces[rnd()%(sizeof(pieces)/sizeof(*pieces))]);
+}
+
+typedef struct{
+    const char *normalized;
+    const char *paths[5];
+} Group;
+
+static const Group posix_groups[] = {
+    {"a/b", {"a/./b", "a//b", "a/c/../b", "a/b", NULL}},
+    {"/a/b", {"/a/b", "//a/./b", "/x/../a/b", NULL}},
+    {"b/a", {"b/a", "./b//a/.", NULL}},
+    {"A/b", {"A/b", NULL}},
+    {"../a", {"../a", "x/../../a", NULL}},
+};
+
+static const Group windows_groups[] = {
+    {"a\\b", {"a\\.\\b", "a\\\\b", "a\\c\\..\\b", "a/b", NULL}},
+    {"C:\\a\\b", {"C:\\a\\b", "C:/a/./b", "C:\\x\\..\\a\\\\b", NULL}},
+    {"b\\a", {"b\\a", ".\\b\\/a\\.", NULL}},
+    {"\\\\srv\\sh\\a", {"\\\\srv\\sh\\a", "\\\\srv\\sh\\.\\x\\..\\a", NULL}},
+    {"..\\a", {"..\\a", "x\\..\\..\\a", NULL}},
+};
+
+bool check_get(struct cwk_intern *intern, size_t id, const char *expected)
+{
+    size_t length;
+    const char *path = cwk_intern_get(intern, id, &length);
+    if (length != strlen(expected) || strcmp(path, expected) != 0){
+        printf("[FAIL] intern: id %zu is '%s' (%zu) instead of '%s'\n", id, path, length, expected);
+        return false;
+    }
+    return true;
+}
+
+bool check_groups(enum cwk_path_style style, const Group *groups, size_t group_count)
+{
+    struct cwk_intern intern;
+    cwk_intern_init(&intern, style);
+    size_t pool_size = 0;
+    // every group is added twice, the second time must neither add ids nor grow the pool
+    for (size_t round=0; round<2; ++round){
+        for (size_t g=0; g<group_count; ++g){
+            for (size_t p=0; groups[g].paths[p] != NULL; ++p){
+                size_t id, found;
+                if (!cwk_intern_add(&intern, groups[g].paths[p], &id) || !cwk_intern_find(&intern, groups[g].paths[p], &found)){
+                    printf("[FAIL] intern: '%s' could not be added\n", groups[g].paths[p]);
+                    return false;
+                }
+                if (id != g || found != g){
+                    printf("[FAIL] intern: '%s' got id %zu instead of %zu\n", groups[g].paths[p], id, g);
+                    return false;
+                }
+                if (!check_get(&intern, id, groups[g].normalized)) return false;
+            }
+            if (round == 0) pool_size += strlen(groups[g].normalized)+1;
+        }
+    }
+    size_t id;
+    if (cwk_intern_find(&intern, "missing", &id) || intern.count != group_count || intern.pool_size != pool_size){
+        printf("[FAIL] intern: %zu paths in %zu bytes instead of %zu in %zu bytes\n", intern.count, intern.pool_size, group_count, pool_size);
+        return false;
+    }
+    cwk_intern_free(&intern);
+    return true;
+}
+
+int compare_paths(const void *a, const void *b)
+{
+    return strcmp(a, b);
+}
+
+bool check_random(enum cwk_path_style style)
+{
+    struct cwk_ctx ctx = {style};
+    struct cwk_intern intern;
+    cwk_intern_init(&intern, style);
+    static char normalized[PATHS][MAX_PATH_SIZE];
+    size_t count = 0, pool_size = 0;
+    for (size_t i=0; i<PATHS; ++i){
+        char path[MAX_PATH_SIZE], expected[MAX_PATH_SIZE];
+        random_path(path, 8);
+        cwk_ctx_path_normalize(&ctx, path, expected, sizeof(expected));
+        size_t id, found;
+        bool known = cwk_intern_find(&intern, path, &found);
+        if (!cwk_intern_add(&intern, path, &id)){
+            printf("[FAIL] intern: '%s' could not be added\n", path);
+            return false;
+        }
+        // a new id has to be a new path, a known one has to be the same path
+        bool same = (id == count)? !known:(id < count && known && found == id);
+        if (id == count){
+            strcpy(normalized[count++], expected);
+            pool_size += strlen(expected)+1;
+        }
+        if (!same || strcmp(normalized[id], expected) != 0){
+            printf("[FAIL] intern: '%s' (%s) got id %zu of '%s'\n", path, expected, id, normalized[id]);
+            return false;
+        }
+        if (!check_get(&intern, id, expected)) return false;
+    }
+    if (intern.count != count || intern.pool_size != pool_size){
+        printf("[FAIL] intern: %zu paths in %zu bytes instead of %zu in %zu bytes\n", intern.count, intern.pool_size, count, pool_size);
+        return false;
+    }
+    cwk_intern_free(&intern);
+    // no two ids may belong to the same path
+    qsort(normalized, count, sizeof(*normalized), compare_paths);
+    for (size_t i=1; i<count; ++i){
+        if (strcmp(normalized[i-1], normalized[i]) == 0){
+            printf("[FAIL] intern: '%s' got two ids\n", normalized[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    state = (argc > 1)? strtoull(argv[1], NULL, 10):1;
+    if (!check_groups(CWK_STYLE_UNIX, posix_groups, sizeof(posix_groups)/sizeof(*posix_groups))) return 1;
+    if (!check_groups(CWK_STYLE_WINDOWS, windows_groups, sizeof(windows_groups)/sizeof(*windows_groups))) return 1;
+    if (!check_random(CWK_STYLE_UNIX) || !check_random(CWK_STYLE_WINDOWS)) return 1;
+    printf("[OK] intern\n");
+    return 0;
+}
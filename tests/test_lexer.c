@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONP_IMPLEMENTATION
+#include "conp.h"
+
+#define ROUNDS 200000
+#define MAX_LEN 100
+
+/*
+    The scanning kernels are compared with scalar loops on random buffers of
+    every length up to MAX_LEN, so the characters they stop at lie on both
+    sides of every 16 and 32 byte block boundary. Every buffer is allocated
+    with its exact size, so -fsanitize=address catches a kernel that reads
+    past the end. test.sh also builds the test with -mavx2 if the CPU has it.
+    Then conp_validate has to report the expected diagnostics for a few
+    invalid configs, also behind whitespace that ends at a block boundary,
+    and a string that ends in a backslash has to keep it.
+*/
+
+static unsigned long long state = 1;
+
+unsigned rnd(void)
+{
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+// mostly characters no kernel stops at, the rest with a random density
+void fill(char *buffer, size_t len, const char *rare)
+{
+    const char *common = "abcKEY019._-";
+    unsigned density = 1 + rnd()%40;
+    for (size_t i=0; i<len; ++i){
+        buffer[i] = (rnd()%density == 0)? rare[rnd()%strlen(rare)]:common[rnd()%strlen(common)];
+    }
+}
+
+size_t scalar_trim(const char *buffer, size_t len, size_t i)
+{
+    while (i < len && conp_is_whitespace(buffer[i])) i++;
+    return i;
+}
+
+size_t scalar_delimeter(const char *buffer, size_t len, size_t i)
+{
+    while (i < len && !conp__is_delimeter(buffer[i])) i++;
+    return i;
+}
+
+bool scalar_string_end(const char *buffer, size_t len, size_t *i, bool *escaped)
+{
+    while (*i < len){
+        if (buffer[*i] == '"') return true;
+        if (buffer[*i] == '\\') *escaped = true;
+        (*i)++;
+    }
+    return false;
+}
+
+size_t scalar_find_key(const char *buffer, size_t len, size_t from, const char *key, size_t key_len, bool fold)
+{
+    for (size_t i=from; i+key_len<=len; ++i){
+        if (fold? conp__equal_folded(buffer+i, key, key_len):memcmp(buffer+i, key, key_len) == 0) return i;
+    }
+    return len;
+}
+
+bool check_kernels(void)
+{
+    size_t len = rnd()%(MAX_LEN+1);
+    char *buffer = malloc((len > 0)? len:1);
+    assert(buffer != NULL && "Need more RAM!");
+    size_t start = (len > 0)? rnd()%(len+1):0;
+    ConpLexer lexer = conp_init(buffer, len, "test");
+    bool same = true;
+    switch (rnd()%4){
+        case 0:{
+            fill(buffer, len, "x");
+            // long runs of whitespace that end anywhere
+            for (size_t i=0, run=rnd()%(len+1); i<run; ++i) buffer[i] = " \t\n"[rnd()%3];
+            lexer.index = start;
+            conp__trim_left(&lexer);
+            same = lexer.index == scalar_trim(buffer, len, start);
+        } break;
+        case 1:{
+            fill(buffer, len, "= \n\t");
+            lexer.index = start;
+            conp__find_delimeter(&lexer);
+            same = lexer.index == scalar_delimeter(buffer, len, start);
+        } break;
+        case 2:{
+            fill(buffer, len, "\"\\");
+            size_t index = start;
+            bool escaped = false;
+            bool found = scalar_string_end(buffer, len, &index, &escaped);
+            lexer.index = start;
+            same = conp__find_string_end(&lexer) == found && lexer.index == index && lexer.escaped == escaped;
+        } break;
+        default:{
+            fill(buffer, len, "kKyY=\"");
+            char key[4];
+            size_t key_len = 1 + rnd()%conp_arr_len(key);
+            for (size_t i=0; i<key_len; ++i) key[i] = "kKeEyY"[rnd()%6];
+            bool fold = rnd()%2;
+            same = conp__find_key(buffer, start, len, key, key_len, fold) == scalar_find_key(buffer, len, start, key, key_len, fold);
+        } break;
+    }
+    if (!same) printf("[FAIL] lexer: a kernel differs on '%.*s' from %zu\n", (int) len, buffer, start);
+    free(buffer);
+    return same;
+}
+
+typedef struct{
+    char *config;
+    char *expected; // the printed diagnostics
+} Case;
+
+bool check_diagnostics(Case *c)
+{
+    size_t len = strlen(c->config);
+    char *buffer = malloc(len);
+    assert(buffer != NULL && "Need more RAM!");
+    memcpy(buffer, c->config, len);
+    ConpDiagnostics diagnostics = {0};
+    bool result = conp_validate(buffer, len, "test", &diagnostics);
+    char printed[1024] = "";
+    FILE *file = fmemopen(printed, sizeof(printed), "w");
+    assert(file != NULL);
+    conp_diagnostics_print(&diagnostics, file);
+    fclose(file);
+    bool same = result == (c->expected[0] == '\0') && strcmp(printed, c->expected) == 0;
+    if (!same) printf("[FAIL] lexer: the diagnostics of '%s' are\n%sinstead of\n%s", c->config, printed, c->expected);
+    conp_diagnostics_free(&diagnostics);
+    free(buffer);
+    return same;
+}
+
+// a backslash only marks a string as escaped, it does not escape the closing quote
+bool check_extract(char *config, char *expected)
+{
+    ConpLexer lexer = conp_init(config, strlen(config), "test");
+    ConpToken token;
+    char buffer[64];
+    bool same = conp_next(&lexer, &token) && conp_next(&lexer, &token) && conp_next(&lexer, &token)
+                && token.type == ConpToken_String && token.escaped && conp_extract(&token, buffer, sizeof(buffer)) && strcmp(buffer, expected) == 0;
+    if (!same) printf("[FAIL] lexer: the value of '%s' is not '%s'\n", config, expected);
+    return same;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long long seed = (argc > 1)? strtoull(argv[1], NULL, 10):1;
+    state = seed;
+    for (size_t round=0; round<ROUNDS; ++round){
+        if (!check_kernels()){
+            printf("[FAIL] lexer: seed %llu, round %zu\n", seed, round);
+            return 1;
+        }
+    }
+    Case cases[] = {
+        {"k = 1\n[s]\nk = \"v\"\n", ""},
+        {"k = \"abc", "[ERROR] test:1:5: Missing closing delimeter for '\"'!\n"},
+        {"[s\nk = 1\n", "[ERROR] test:1:1: Missing closing delimeter for '['!\n"},
+        {"k 1\n", "[ERROR] test:1:3: Expected token of type [Sep], but got Int!\n"},
+        {"k =\n", "[ERROR] test:2:1: Expected token of type [Field, Int, Float, String, Bool, Bool], but got End!\n"},
+        // parsing continues at the next line after every error
+        {"a = 1\nb 2\nc = 3\n[d\ne = \"f\nk 1.5\n",
+         "[ERROR] test:2:3: Expected token of type [Sep], but got Int!\n"
+         "[ERROR] test:4:1: Missing closing delimeter for '['!\n"
+         "[ERROR] test:5:5: Missing closing delimeter for '\"'!\n"
+         "[ERROR] test:6:3: Expected token of type [Sep], but got Float!\n"},
+        // a backslash does not escape the closing quote, so a Windows path may end in one
+        {"k = \"C:\\licenses\\\"\nn = 1\n", ""},
+        {"k = \"C:\\licenses\\\\\"\nn = 1\n", ""},
+        {"k = \"a\\\" b = 1\n", ""},
+    };
+    for (size_t i=0; i<conp_arr_len(cases); ++i){
+        if (!check_diagnostics(&cases[i])) return 1;
+    }
+    if (!check_extract("k = \"C:\\licenses\\\"\n", "C:\\licenses\\") || !check_extract("k = \"C:\\licenses\\\\\"\n", "C:\\licenses\\")) return 1;
+    // the errors lie right behind whitespace, keys and strings that end around a block boundary
+    for (int n=12; n<=36; ++n){
+        char config[128], expected[128];
+        snprintf(config, sizeof(config), "%*sk 1\n", n, "");
+        snprintf(expected, sizeof(expected), "[ERROR] test:1:%d: Expected token of type [Sep], but got Int!\n", n+3);
+        if (!check_diagnostics(&(Case) {config, expected})) return 1;
+        snprintf(config, sizeof(config), "k = 1\n%.*s 1.5\n", n, "keykeykeykeykeykeykeykeykeykeykeykeykeykey");
+        snprintf(expected, sizeof(expected), "[ERROR] test:2:%d: Expected token of type [Sep], but got Float!\n", n+2);
+        if (!check_diagnostics(&(Case) {config, expected})) return 1;
+        snprintf(config, sizeof(config), "k = \"%.*s\" x y\n", n, "valuevaluevaluevaluevaluevaluevaluevalue");
+        snprintf(expected, sizeof(expected), "[ERROR] test:1:%d: Expected token of type [Sep], but got Field!\n", n+10);
+        if (!check_diagnostics(&(Case) {config, expected})) return 1;
+    }
+    printf("[OK] lexer\n");
+    return 0;
+}
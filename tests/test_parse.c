@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// split even the small configs of the test into chunks
+#define CONP_PARALLEL_MIN_CHUNK 1
+// the random configs have at most 100 headers, so only check_limits reaches the limits
+#define CONP_MAX_SECTIONS 256
+#define CONP_MAX_SOURCES 256
+#define CONP_WITH_THREADS
+#define CONP_IMPLEMENTATION
+#include "conp.h"
+
+#define ROUNDS 3000
+#define KEYS 20
+#define MAX_THREADS 16
+
+/*
+    Random configs are parsed by conp_parse_all and by conp_parse_all_parallel
+    with a random number of chunks, which has to give the same items in the
+    same order, the same sections and the same result. The configs are made
+    of strings over several lines that contain whole entries and section
+    headers, so the chunks often start inside a string. On the same configs
+    conp_find and conp_find_nocase have to find the same entry as a scan over
+    the entries of conp_parse_all: the first one in the section, even if the
+    key also occurs inside strings and values, as a prefix of other keys or
+    in another case. A header past the limit of sections stops parsing and
+    updating like an error, and sources past their limits are refused.
+*/
+
+static unsigned long long state = 1;
+
+unsigned rnd(void)
+{
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+// complete entries and section headers, also entries and headers hidden inside strings
+static const char *valid_pieces[] = {
+    "k%u = \"v%u\"\n", "K%u = %u\n", "k%u = k%u\n", "k%u = true\n", "k%u=%u.5\n", "\"k%u\" = \"v%u\"\n",
+    "[s%u]\n", "[S%u]\n", "[]\n",
+    "k%u = \"\nk%u = 1\n\"\n",
+    "k%u = \"line\n[s%u]\nk1 = \\\\x\\\\\n\n\n\"\n",
+    "k%u = \"C:\\\\a\\\"\nk%u = \"\\\\b\"\n",
+    "v%u = \"\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\nk%u = 2\n\"\n",
+};
+
+// anything, also parts of entries that turn the config invalid
+static const char *pieces[] = {
+    "\"", "=", "\n", "[", "]", "x", " ", "\\", "k%u", "%u", "[s%u", "k%u = \"%u\n",
+};
+
+size_t write_piece(char *buffer, bool valid)
+{
+    const char *piece = valid? valid_pieces[rnd()%conp_arr_len(valid_pieces)]:pieces[rnd()%conp_arr_len(pieces)];
+    return sprintf(buffer, piece, rnd()%KEYS, rnd()%KEYS);
+}
+
+const char* section_name(ConpEntries *entries, size_t section)
+{
+    return (entries->sections[section].name != NULL)? entries->sections[section].name:"";
+}
+
+bool compare(ConpEntries *a, ConpEntries *b)
+{
+    if (a->count != b->count){
+        printf("%zu entries instead of %zu\n", a->count, b->count);
+        return false;
+    }
+    for (size_t i=0; i<a->count; ++i){
+        ConpEntry *x = &a->items[i];
+        ConpEntry *y = &b->items[i];
+        if (x->key.offset != y->key.offset || x->key.len != y->key.len || x->value.offset != y->value.offset || x->value.len != y->value.len
+            || x->type != y->type || x->escaped != y->escaped || x->section != y->section){
+            printf("entry %zu differs\n", i);
+            return false;
+        }
+    }
+    if (a->section_count != b->section_count){
+        printf("%zu sections instead of %zu\n", a->section_count, b->section_count);
+        return false;
+    }
+    for (size_t s=0; s<a->section_count; ++s){
+        if (strcmp(section_name(a, s), section_name(b, s)) != 0 || a->sections[s].count != b->sections[s].count){
+            printf("section %zu differs\n", s);
+            return false;
+        }
+    }
+    char key[32];
+    for (size_t s=0; s<a->section_count; ++s){
+        for (unsigned k=0; k<KEYS; ++k){
+            snprintf(key, sizeof(key), "k%u", k);
+            ConpEntry *x = conp_section_find(a, a->sections[s].name, key);
+            ConpEntry *y = conp_section_find(b, a->sections[s].name, key);
+            if ((x != NULL? x-a->items:-1) != (y != NULL? y-b->items:-1)){
+                printf("conp_section_find of '%s' in [%s] differs\n", key, section_name(a, s));
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// the first entry with the key in the section, NULL is the root section
+ConpEntry* scan(ConpEntries *entries, char *section, char *key, bool fold)
+{
+    size_t key_len = strlen(key);
+    for (size_t i=0; i<entries->count; ++i){
+        ConpEntry *entry = &entries->items[i];
+        char *name = entries->sections[entry->section].name;
+        if ((section == NULL)? name != NULL:(name == NULL || strcmp(name, section) != 0)) continue;
+        if (entry->key.len != key_len) continue;
+        char *p = conp_span_ptr(entries, entry, entry->key);
+        if (fold? conp__equal_folded(p, key, key_len):memcmp(p, key, key_len) == 0) return entry;
+    }
+    return NULL;
+}
+
+bool compare_find(ConpEntries *parsed, char *buffer, size_t size)
+{
+    char *sections[] = {NULL, "s0", "s1", "s2", "S1", "", "missing"};
+    char *names[] = {"k%u", "K%u", "v%u", "s%u"};
+    char key[32];
+    for (size_t s=0; s<conp_arr_len(sections); ++s){
+        for (size_t n=0; n<conp_arr_len(names); ++n){
+            for (unsigned k=0; k<KEYS; ++k){
+                // a third of the keys is enough to keep the test fast
+                if (rnd()%3 != 0) continue;
+                snprintf(key, sizeof(key), names[n], k);
+                for (int fold=0; fold<2; ++fold){
+                    ConpToken token;
+                    bool found = fold? conp_find_nocase(buffer, size, "test", sections[s], key, &token):conp_find(buffer, size, "test", sections[s], key, &token);
+                    ConpEntry *entry = scan(parsed, sections[s], key, fold);
+                    bool same = found == (entry != NULL);
+                    if (same && found){
+                        same = token.start == conp_span_ptr(parsed, entry, entry->value) && token.len == entry->value.len
+                               && token.type == entry->type && token.escaped == entry->escaped;
+                    }
+                    if (!same){
+                        printf("%s of '%s' in [%s] differs\n", fold? "conp_find_nocase":"conp_find", key, (sections[s] != NULL)? sections[s]:"");
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool check_limits(void)
+{
+    // one header more than fits, the root section counts as well
+    char *buffer = malloc((CONP_MAX_SECTIONS+1)*32);
+    assert(buffer != NULL && "Need more RAM!");
+    size_t fits = 0, size = 0;
+    for (size_t i=0; i<CONP_MAX_SECTIONS; ++i){
+        if (i == CONP_MAX_SECTIONS-1) fits = size;
+        size += sprintf(buffer+size, "[s%zu]\nk = %zu\n", i, i);
+    }
+    ConpEntries parsed = {0};
+    ConpEntries parallel = {0};
+    ConpEntries updated = {0};
+    bool result = !conp_parse_all(&parsed, buffer, size, "test") && parsed.sources[0].failed;
+    result = result && parsed.section_count == CONP_MAX_SECTIONS && parsed.count == CONP_MAX_SECTIONS-1;
+    result = result && !conp_parse_all_parallel(&parallel, buffer, size, "test", 4) && parallel.sources[0].failed && compare(&parallel, &parsed);
+    // the edit adds the header that does not fit
+    result = result && conp_parse_all(&updated, buffer, fits, "test") && !updated.sources[0].failed;
+    result = result && !conp_entries_reload(&updated, 0, buffer, size) && updated.sources[0].failed && compare(&updated, &parsed);
+    if (!result) printf("[FAIL] parse: the header past the limit of sections was not refused\n");
+
+    ConpEntries sources = {0};
+    size_t source = 0;
+    for (size_t i=0; i<CONP_MAX_SOURCES && result; ++i){
+        result = conp_entries_add_source(&sources, buffer, size, "test", &source) && source == i;
+    }
+    result = result && !conp_entries_add_source(&sources, buffer, size, "test", &source) && sources.source_count == CONP_MAX_SOURCES;
+    result = result && !conp_entries_add_source(&parallel, buffer, (size_t) UINT32_MAX+1, "test", &source);
+    if (!result) printf("[FAIL] parse: a source past the limits was not refused\n");
+    conp_entries_free(&parsed);
+    conp_entries_free(&parallel);
+    conp_entries_free(&updated);
+    conp_entries_free(&sources);
+    free(buffer);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long long seed = (argc > 1)? strtoull(argv[1], NULL, 10):1;
+    state = seed;
+    if (!check_limits()) return 1;
+    char *buffer = malloc(1 << 16);
+    assert(buffer != NULL && "Need more RAM!");
+    for (size_t round=0; round<ROUNDS; ++round){
+        size_t size = 0;
+        bool valid = rnd()%4 != 0;
+        for (size_t n=rnd()%100; n>0; --n) size += write_piece(buffer+size, valid || rnd()%8 != 0);
+        size_t threads = 2 + rnd()%(MAX_THREADS-1);
+
+        ConpEntries parsed = {0};
+        ConpEntries parallel = {0};
+        bool parsed_result = conp_parse_all(&parsed, buffer, size, "test");
+        bool parallel_result = conp_parse_all_parallel(&parallel, buffer, size, "test", threads);
+        bool same = parsed_result == parallel_result && parsed.sources[0].failed == parallel.sources[0].failed && compare(&parallel, &parsed) && compare_find(&parsed, buffer, size);
+        conp_entries_free(&parsed);
+        conp_entries_free(&parallel);
+        if (!same){
+            printf("[FAIL] parse: seed %llu, round %zu, %zu threads:\n%.*s\n", seed, round, threads, (int) size, buffer);
+            return 1;
+        }
+    }
+    free(buffer);
+    printf("[OK] parse\n");
+    return 0;
+}
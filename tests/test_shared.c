@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define CONP_WITH_THREADS
+#define CONP_IMPLEMENTATION
+#include "conp.h"
+
+#define READERS 8
+#define SNAPSHOTS 3000
+
+/*
+    READERS threads look keys up while the writer publishes SNAPSHOTS
+    snapshots, each with the generation in both of its keys. A reader has to
+    see both keys of the same generation and the generations must never go
+    back. Released buffers are overwritten before they are freed, so a reader
+    that is still inside a reclaimed snapshot reads garbage, and the build with
+    -fsanitize=thread reports the race with the writer.
+*/
+
+static ConpShared shared;
+static bool done;
+static size_t released;
+static size_t failures[READERS];
+static size_t reads[READERS];
+
+void release(char *buffer, size_t buffer_size)
+{
+    memset(buffer, 'X', buffer_size);
+    free(buffer);
+    __atomic_add_fetch(&released, 1, __ATOMIC_RELAXED);
+}
+
+long read_generation(ConpEntries *entries, char *key)
+{
+    ConpToken token;
+    char value[32];
+    if (!conp_entries_get(entries, key, &token) || !conp_extract(&token, value, sizeof(value))) return -1;
+    return strtol(value, NULL, 10);
+}
+
+void* reader(void *arg)
+{
+    size_t id = (size_t) arg;
+    ConpReader *r = conp_shared_join(&shared);
+    if (r == NULL){
+        failures[id]++;
+        return NULL;
+    }
+    long last = -1;
+    while (!__atomic_load_n(&done, __ATOMIC_ACQUIRE)){
+        ConpSnapshot *snapshot = conp_shared_enter(&shared, r);
+        if (snapshot != NULL){
+            long a = read_generation(&snapshot->entries, "a");
+            long b = read_generation(&snapshot->entries, "b");
+            if (a < 0 || a != b || a < last) failures[id]++;
+            last = a;
+        }
+        conp_shared_leave(&shared, r);
+        char value[32];
+        if (conp_shared_get(&shared, r, NULL, "a", value, sizeof(value))){
+            long a = strtol(value, NULL, 10);
+            if (a < last) failures[id]++;
+            last = a;
+        }
+        reads[id]++;
+    }
+    conp_shared_part(&shared, r);
+    return NULL;
+}
+
+int main(void)
+{
+    conp_shared_init(&shared);
+    pthread_t threads[READERS];
+    for (size_t i=0; i<READERS; ++i){
+        if (pthread_create(&threads[i], NULL, reader, (void*) i) != 0){
+            printf("[FAIL] shared: could not start reader %zu\n", i);
+            return 1;
+        }
+    }
+    for (long generation=0; generation<SNAPSHOTS; ++generation){
+        char *buffer = malloc(64);
+        assert(buffer != NULL && "Need more RAM!");
+        int len = sprintf(buffer, "a = \"%ld\"\nb = \"%ld\"\n", generation, generation);
+        ConpSnapshot *snapshot = conp_snapshot_parse(buffer, len, "generation", release);
+        if (snapshot == NULL){
+            printf("[FAIL] shared: snapshot %ld could not be parsed\n", generation);
+            return 1;
+        }
+        conp_shared_publish(&shared, snapshot);
+    }
+    __atomic_store_n(&done, true, __ATOMIC_RELEASE);
+    size_t failed = 0, total = 0;
+    for (size_t i=0; i<READERS; ++i){
+        pthread_join(threads[i], NULL);
+        failed += failures[i];
+        total += reads[i];
+    }
+    // without readers every replaced snapshot can be freed, only the current one is left
+    size_t left = conp_shared_reclaim(&shared);
+    size_t freed = __atomic_load_n(&released, __ATOMIC_RELAXED);
+    conp_shared_free(&shared);
+    if (failed > 0 || left != 0 || freed != SNAPSHOTS-1 || released != SNAPSHOTS){
+        printf("[FAIL] shared: %zu of %zu reads failed, %zu snapshots left, %zu of %d released\n", failed, total, left, freed, SNAPSHOTS-1);
+        return 1;
+    }
+    printf("[OK] shared (%zu reads)\n", total);
+    return 0;
+}
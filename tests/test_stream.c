@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONP_IMPLEMENTATION
+#include "conp.h"
+
+#define ROUNDS 3000
+#define KEYS 10
+
+/*
+    Random configs are fed to a ConpStream in two parts, split at every
+    offset, and in random parts down to single bytes. The entries of the
+    stream have to be those of conp_parse_all, with the same section, and an
+    invalid config has to fail with the first error at the same location, so
+    every token is paused and resumed at every possible position.
+*/
+
+static unsigned long long state = 1;
+
+unsigned rnd(void)
+{
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+// every kind of token, also strings with escapes and over several lines
+static const char *valid_pieces[] = {
+    "k%u = \"v%u\"\n", "K%u = %u\n", "k%u = k%u\n", "k%u = true\n", "k%u\t=\tfalse\n", "k%u=-%u.5e3\n", "k%u = +.%u\n",
+    "\"k%u\" = \"C:\\\\a\\\\%u\\\"\n", "k%u = \"a\\nb\\\\%u\"\n", "k%u = \"line\nline%u\"\n", "[s%u]\n", "[]\n", "\n\n", "  \t",
+};
+
+// anything, also parts of entries that turn the config invalid
+static const char *pieces[] = {
+    "\"", "=", "\n", "[", "]", "x", " ", "\\", "k%u", "%u", "[s%u", "k%u = \"%u", "k%u = = %u\n", "k%u %u\n",
+};
+
+size_t write_piece(char *buffer, bool valid)
+{
+    const char *piece = valid? valid_pieces[rnd()%conp_arr_len(valid_pieces)]:pieces[rnd()%conp_arr_len(pieces)];
+    return sprintf(buffer, piece, rnd()%KEYS, rnd()%100);
+}
+
+typedef struct{
+    char *buffer;
+    size_t size;
+    ConpEntries parsed;
+    bool parsed_result;
+    ConpLoc error; // location of the first error of an invalid config
+    ConpStream stream;
+    ConpDiagnostics diagnostics;
+    bool located;
+    size_t next; // the entry of conp_parse_all the stream has to return next
+    char *section; // the section of the entries the stream returns
+    char section_buffer[64];
+} Test;
+
+bool same_token(ConpToken *token, char *expected, size_t len, ConpTokenType type, bool escaped)
+{
+    return token->len == len && memcmp(token->start, expected, len) == 0 && token->type == type && token->escaped == escaped;
+}
+
+// fetch all entries the stream has so far, false if one differs
+bool drain(Test *test)
+{
+    ConpToken key, value;
+    while (conp_stream_next(&test->stream, &key, &value)){
+        if (value.type == ConpToken_Section){
+            snprintf(test->section_buffer, sizeof(test->section_buffer), "%.*s", (int) key.len, key.start);
+            test->section = test->section_buffer;
+            continue;
+        }
+        if (test->next >= test->parsed.count){
+            printf("the stream returned more entries\n");
+            return false;
+        }
+        ConpEntries *parsed = &test->parsed;
+        ConpEntry *entry = &parsed->items[test->next++];
+        char *name = parsed->sections[entry->section].name;
+        if (!same_token(&key, conp_span_ptr(parsed, entry, entry->key), entry->key.len, ConpToken_Field, false)
+            || !same_token(&value, conp_span_ptr(parsed, entry, entry->value), entry->value.len, entry->type, entry->escaped)
+            || ((name == NULL)? test->section != NULL:(test->section == NULL || strcmp(name, test->section) != 0))){
+            printf("entry %zu differs\n", test->next-1);
+            return false;
+        }
+    }
+    if (test->stream.failed && !test->located){
+        // the location is resolved while the stream still holds the input of the error
+        conp__diagnostics_locate(&test->diagnostics, &test->stream.lexer);
+        test->located = true;
+    }
+    return true;
+}
+
+// feed the config in parts that end at the given offsets
+bool run(Test *test, size_t *splits, size_t split_count)
+{
+    test->stream = conp_stream_init("test");
+    test->stream.lexer.diagnostics = &test->diagnostics;
+    test->next = 0;
+    test->section = NULL;
+    test->located = false;
+    bool result = true;
+    size_t from = 0;
+    for (size_t i=0; i<=split_count && result; ++i){
+        size_t to = (i < split_count)? splits[i]:test->size;
+        conp_stream_feed(&test->stream, test->buffer+from, to-from);
+        from = to;
+        result = drain(test);
+    }
+    conp_stream_finish(&test->stream);
+    if (result) result = drain(test);
+    if (result && test->next != test->parsed.count){
+        printf("the stream returned %zu entries instead of %zu\n", test->next, test->parsed.count);
+        result = false;
+    }
+    if (result && test->stream.failed == test->parsed_result){
+        printf("the stream %s\n", test->parsed_result? "failed":"did not fail");
+        result = false;
+    }
+    if (result && !test->parsed_result){
+        ConpLoc loc = test->diagnostics.items[0].loc;
+        if (loc.row != test->error.row || loc.column != test->error.column){
+            printf("the error is reported at %zu:%zu instead of %zu:%zu\n", loc.row, loc.column, test->error.row, test->error.column);
+            result = false;
+        }
+    }
+    conp_stream_free(&test->stream);
+    conp_diagnostics_free(&test->diagnostics);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long long seed = (argc > 1)? strtoull(argv[1], NULL, 10):1;
+    state = seed;
+    char buffer[4096];
+    size_t splits[512];
+    for (size_t round=0; round<ROUNDS; ++round){
+        Test test = {.buffer=buffer};
+        bool valid = rnd()%3 != 0;
+        for (size_t n=rnd()%16; n>0; --n) test.size += write_piece(buffer+test.size, valid || rnd()%4 != 0);
+        // parsing is best-effort, the source records whether it stopped at an error
+        test.parsed_result = conp_parse_all(&test.parsed, buffer, test.size, "test") && !test.parsed.sources[0].failed;
+        if (!test.parsed_result){
+            // the first error of the config, conp_validate locates it like the stream does
+            ConpDiagnostics diagnostics = {0};
+            (void) conp_validate(buffer, test.size, "test", &diagnostics);
+            assert(diagnostics.count > 0);
+            test.error = diagnostics.items[0].loc;
+            conp_diagnostics_free(&diagnostics);
+        }
+        bool same = true;
+        // in two parts, split at every offset
+        for (size_t split=0; split<=test.size && same; ++split){
+            same = run(&test, &split, 1);
+        }
+        // in random parts, a third of the rounds byte by byte
+        size_t split_count = 0;
+        bool bytes = rnd()%3 == 0;
+        for (size_t offset=0; offset<test.size && same; ){
+            offset += bytes? 1:1 + rnd()%8;
+            if (offset < test.size && split_count < conp_arr_len(splits)) splits[split_count++] = offset;
+        }
+        if (same) same = run(&test, splits, split_count);
+        conp_entries_free(&test.parsed);
+        if (!same){
+            printf("[FAIL] stream: seed %llu, round %zu:\n%.*s\n", seed, round, (int) test.size, buffer);
+            return 1;
+        }
+    }
+    printf("[OK] stream\n");
+    return 0;
+}
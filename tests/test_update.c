@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONP_IMPLEMENTATION
+#include "conp.h"
+
+#define ROUNDS 2000
+#define EDITS 20
+#define KEYS 40
+#define ALIASES_SECTION "aliases"
+
+/*
+    Two sources are edited at random and after every edit the entries that
+    conp_entries_update (or conp_entries_reload) patched are compared with the
+    entries conp_parse_all reads from the edited buffers: the same items in the
+    same order, the same section counts and the same results for every lookup.
+    The keys repeat, also in other cases, so the lookups have to find the first
+    of several entries with the same key. Entries that are allocated from an
+    arena must not grow it anymore once they were updated back and forth.
+*/
+
+static unsigned long long state = 1;
+
+unsigned rnd(void)
+{
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+// complete entries and section headers
+static const char *valid_pieces[] = {
+    "k%u = \"v%u\"\n",
+    "K%u = %u\n",
+    "[s%u]\n",
+    "["ALIASES_SECTION"]\na%u = \"k%u\"\n",
+};
+
+// anything, also parts of entries that turn the source invalid
+static const char *pieces[] = {
+    "k%u = \"v%u\"\n", "k%u=%u\n", "[s%u]\n", "k%u = \"multi\nline%u\"\n", "\"", "=", "\n", "x", " ", "%u",
+    "k%u = true\n", "\"q%u\" = %u.5\n", "a%u = \"K%u\"\n",
+};
+
+size_t write_piece(char *buffer, bool valid)
+{
+    const char *piece = valid? valid_pieces[rnd()%conp_arr_len(valid_pieces)]:pieces[rnd()%conp_arr_len(pieces)];
+    unsigned key = rnd()%KEYS;
+    return sprintf(buffer, piece, key, rnd()%100);
+}
+
+const char* section_name(ConpEntries *entries, size_t section)
+{
+    return (entries->sections[section].name != NULL)? entries->sections[section].name:"";
+}
+
+long item_index(ConpEntries *entries, ConpEntry *entry)
+{
+    return (entry != NULL)? entry-entries->items:-1;
+}
+
+bool compare(ConpEntries *updated, ConpEntries *parsed)
+{
+    if (updated->count != parsed->count){
+        printf("%zu entries instead of %zu\n", updated->count, parsed->count);
+        return false;
+    }
+    for (size_t i=0; i<updated->count; ++i){
+        ConpEntry *a = &updated->items[i];
+        ConpEntry *b = &parsed->items[i];
+        if (a->key.offset != b->key.offset || a->key.len != b->key.len || a->value.offset != b->value.offset || a->value.len != b->value.len
+            || a->type != b->type || a->escaped != b->escaped || a->source != b->source
+            || strcmp(section_name(updated, a->section), section_name(parsed, b->section)) != 0){
+            printf("entry %zu differs\n", i);
+            return false;
+        }
+    }
+    for (size_t s=0; s<updated->section_count; ++s){
+        ConpSection *section = conp_entries_section(parsed, updated->sections[s].name);
+        size_t count = (section != NULL)? section->count:0;
+        if (updated->sections[s].count != count){
+            printf("[%s] has %zu entries instead of %zu\n", section_name(updated, s), updated->sections[s].count, count);
+            return false;
+        }
+    }
+    char *sections[] = {NULL, "s0", "s1", "s2", ALIASES_SECTION};
+    char key[32];
+    for (size_t s=0; s<conp_arr_len(sections); ++s){
+        for (unsigned k=0; k<KEYS; ++k){
+            snprintf(key, sizeof(key), "k%u", k);
+            if (item_index(updated, conp_section_find(updated, sections[s], key)) != item_index(parsed, conp_section_find(parsed, sections[s], key))){
+                printf("conp_section_find of '%s' in [%s] differs\n", key, (sections[s] != NULL)? sections[s]:"");
+                return false;
+            }
+        }
+    }
+    // the case-insensitive index of the root section, with its aliases
+    char *names[] = {"k%u", "K%u", "a%u", "A%u"};
+    for (size_t n=0; n<conp_arr_len(names); ++n){
+        for (unsigned k=0; k<KEYS; ++k){
+            snprintf(key, sizeof(key), names[n], k);
+            if (item_index(updated, conp_section_resolve(updated, NULL, key)) != item_index(parsed, conp_section_resolve(parsed, NULL, key))){
+                printf("conp_section_resolve of '%s' differs\n", key);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// the used bytes of all blocks of an arena
+size_t arena_used(ConpArena *arena)
+{
+    size_t used = 0;
+    for (ConpArenaBlock *block=arena->head; block != NULL; block=block->next) used += block->used;
+    return used;
+}
+
+bool check_arena(void)
+{
+    char *buffers[] = {"k1 = \"v\"\nk2 = 2\n[s1]\nk1 = 3\n[aliases]\na1 = \"k1\"\n", "k1 = \"w\"\n[s1]\nk1 = 3\nk3 = 4\n[aliases]\na1 = \"k1\"\n"};
+    ConpArena arena = {0};
+    ConpEntries entries = {.arena=&arena};
+    bool result = conp_parse_all(&entries, buffers[0], strlen(buffers[0]), "test");
+    conp_section_names(&entries, NULL, ALIASES_SECTION);
+    size_t used = 0;
+    for (size_t i=0; i<1000 && result; ++i){
+        result = conp_entries_reload(&entries, 0, buffers[(i+1)%2], strlen(buffers[(i+1)%2]));
+        // the line table is built on demand and rebuilt after every update
+        (void) conp_entries_loc(&entries, 0, 1);
+        if (i == 1) used = arena_used(&arena);
+        if (i > 1 && arena_used(&arena) != used){
+            printf("[FAIL] update: the arena grew from %zu to %zu bytes after %zu updates\n", used, arena_used(&arena), i+1);
+            result = false;
+        }
+    }
+    conp_entries_free(&entries);
+    conp_arena_free(&arena);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    if (!check_arena()) return 1;
+    unsigned long long seed = (argc > 1)? strtoull(argv[1], NULL, 10):1;
+    state = seed;
+    for (size_t round=0; round<ROUNDS; ++round){
+        char *buffers[2];
+        size_t sizes[2];
+        ConpEntries updated = {0};
+        for (size_t s=0; s<conp_arr_len(buffers); ++s){
+            buffers[s] = malloc(1 << 16);
+            assert(buffers[s] != NULL && "Need more RAM!");
+            // the aliases section exists from the start, so both index the same aliases
+            sizes[s] = (s == 1)? (size_t) sprintf(buffers[s], "["ALIASES_SECTION"]\na1 = \"k1\"\n"):0;
+            for (size_t n=rnd()%60; n>0; --n) sizes[s] += write_piece(buffers[s]+sizes[s], true);
+            if (!conp_parse_all(&updated, buffers[s], sizes[s], "test") || updated.sources[s].failed){
+                printf("[FAIL] update: a valid source could not be parsed\n");
+                return 1;
+            }
+        }
+        conp_section_names(&updated, NULL, ALIASES_SECTION);
+        for (size_t edit=0; edit<EDITS; ++edit){
+            size_t s = rnd()%2;
+            size_t start = rnd()%(sizes[s]+1);
+            size_t rest = sizes[s]-start;
+            size_t old_len = rnd()%(((rest < 30)? rest:30)+1);
+            char inserted[256];
+            size_t new_len = 0;
+            bool valid = rnd()%4 != 0;
+            for (size_t n=rnd()%3; n>0; --n) new_len += write_piece(inserted+new_len, valid);
+            size_t size = sizes[s]-old_len+new_len;
+            char *buffer = malloc(size+1);
+            assert(buffer != NULL && "Need more RAM!");
+            memcpy(buffer, buffers[s], start);
+            memcpy(buffer+start, inserted, new_len);
+            memcpy(buffer+start+new_len, buffers[s]+start+old_len, rest-old_len);
+            bool updated_result = (rnd()%2)? conp_entries_reload(&updated, s, buffer, size)
+                                            : conp_entries_update(&updated, s, buffer, size, start, old_len, new_len);
+            free(buffers[s]);
+            buffers[s] = buffer;
+            sizes[s] = size;
+
+            ConpEntries parsed = {0};
+            bool parsed_result = true;
+            for (size_t t=0; t<conp_arr_len(buffers); ++t){
+                bool result = conp_parse_all(&parsed, buffers[t], sizes[t], "test");
+                if (t == s) parsed_result = result && !parsed.sources[t].failed;
+            }
+            // the index is built like it was for the updated entries, over the same aliases section if it still exists
+            ConpSection *root = &updated.sections[0];
+            conp_section_names(&parsed, NULL, (root->aliases != 0)? updated.sections[root->aliases-1].name:NULL);
+            bool same = updated_result == parsed_result && compare(&updated, &parsed);
+            conp_entries_free(&parsed);
+            if (!same){
+                printf("[FAIL] update: seed %llu, round %zu, edit %zu, source %zu is now:\n%.*s\n", seed, round, edit, s, (int) sizes[s], buffers[s]);
+                return 1;
+            }
+        }
+        conp_entries_free(&updated);
+        free(buffers[0]);
+        free(buffers[1]);
+    }
+    printf("[OK] update\n");
+    return 0;
+}
@@ -0,0 +1,63 @@
+# `license -h` lists the same licenses whether the config was parsed or read from the cache,
+# and any run after the config changed rebuilds the cache; licenses in fragments and in front of
+# an error are found, and the errors are reported once
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cp license "$dir/license"
+mkdir "$dir/licenses"
+printf 'foo = "foo.txt"\nFoo = "Foo.txt"\n[licenses]\nbar = "bar.txt"\nBAR = "BAR.txt"\n' > "$dir/licenses/licenses.config"
+"$dir/license" -h > "$dir/cold.txt"
+test -f "$dir/licenses/licenses.config.cache"
+"$dir/license" -h > "$dir/warm.txt"
+if ! diff -u "$dir/cold.txt" "$dir/warm.txt"; then
+    echo "[FAIL] usage: the cached list differs"
+    exit 1
+fi
+for name in foo bar; do
+    if [ "$(grep -ic -- "- $name\$" "$dir/warm.txt")" != 1 ]; then
+        echo "[FAIL] usage: '$name' is not listed exactly once"
+        exit 1
+    fi
+done
+# a license found after the config changed rebuilds the cache as well
+rm "$dir/licenses/licenses.config.cache"
+printf 'foo\n' > "$dir/foo.txt"
+(cd "$dir" && ./license foo > /dev/null)
+if ! test -f "$dir/licenses/licenses.config.cache"; then
+    echo "[FAIL] usage: looking up a license did not rebuild the cache"
+    exit 1
+fi
+# with fragments a license is looked up without a full parse, the errors of a fragment are reported once,
+# by the full parse and not by the lookups in front of it
+mkdir "$dir/licenses/licenses.d"
+printf 'missing\n' > "$dir/licenses/licenses.d/20-broken.config"
+(cd "$dir" && ./license missing > /dev/null 2> "$dir/errors.txt") || true
+if [ "$(grep -c "20-broken.config:" "$dir/errors.txt")" != 1 ]; then
+    echo "[FAIL] usage: the error of a fragment is not reported exactly once"
+    cat "$dir/errors.txt"
+    exit 1
+fi
+# an alias of any length is followed without the full parse
+long=$(printf 'l%.0s' $(seq 300))
+printf '[licenses]\n%s = "foo.txt"\n[aliases]\nlong = "%s"\n' "$long" "$long" > "$dir/licenses/licenses.d/10-long.config"
+rm -f "$dir/LICENSE"
+if ! (cd "$dir" && ./license long > /dev/null) || ! test -f "$dir/LICENSE"; then
+    echo "[FAIL] usage: an alias of 300 characters in a fragment was not followed"
+    exit 1
+fi
+# parsing is best-effort, the licenses in front of an error are still found, and no cache is written
+# for a broken config, so the error is reported again by the next run
+rm -rf "$dir/licenses/licenses.d" "$dir/licenses/licenses.config.cache" "$dir/LICENSE"
+printf 'foo = "foo.txt"\nbroken\n' > "$dir/licenses/licenses.config"
+for run in 1 2; do
+    if ! (cd "$dir" && ./license foo > /dev/null 2> "$dir/errors.txt") || ! test -f "$dir/LICENSE"; then
+        echo "[FAIL] usage: a license in front of an error was not found"
+        exit 1
+    fi
+    if ! grep -q "licenses.config:" "$dir/errors.txt" || test -f "$dir/licenses/licenses.config.cache"; then
+        echo "[FAIL] usage: the error of a broken config was hidden by a cache"
+        exit 1
+    fi
+done
+echo "[OK] usage"